@@ -69,7 +69,7 @@ __aft_release(CMPIArgs * args)
     ClArgsFree((ClArgs *) a->args.hdl);
     memUnlinkEncObj(a->mem_state);
     a->mem_state = MEM_RELEASED;
-    free(args);
+    memFree(args);
     CMReturn(CMPI_RC_OK);
   }
 
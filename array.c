@@ -68,7 +68,7 @@ __aft_release(CMPIArray *array)
     a->mem_state = MEM_RELEASED;
     if (a->data)
       free(a->data);
-    free(array);
+    memFree(array);
     CMReturn(CMPI_RC_OK);
   }
 
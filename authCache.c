@@ -0,0 +1,296 @@
+/*
+ * authCache.c
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Cache of basic authentication results in shared memory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "authCache.h"
+#include "msgqueue.h"
+#include "control.h"
+#include "mlog.h"
+#include "trace.h"
+
+#define AUTH_CACHE_WAYS 4
+#define AUTH_CACHE_ROLE 64      /* roles that do not fit are not cached */
+
+typedef struct authCacheEntry {
+  uint64_t        tag[2];
+  time_t          expires;
+  uint32_t        gen;          /* valid while equal to the header's */
+  int             rc;
+  char            role[AUTH_CACHE_ROLE];
+} AuthCacheEntry;
+
+typedef struct authCacheHdr {
+  volatile uint32_t gen;
+  uint32_t        sets;
+  AuthCacheEntry  ents[];
+} AuthCacheHdr;
+
+static AuthCacheHdr *cache = NULL;
+static size_t   cacheSize;
+static int      authCacheSem = -1;
+static uint64_t secret[4];
+static long     passTTL,
+                failTTL;
+static char     roleBuf[AUTH_CACHE_ROLE];
+
+/*
+ * SipHash-2-4; keyed, so nobody without the secret can pick credentials
+ * that collide with cached ones
+ */
+
+#define ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+#define SIPROUND \
+  do { \
+    v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+    v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+  } while (0)
+
+static          uint64_t
+sipHash(const uint64_t * k, const unsigned char *m, size_t len)
+{
+  uint64_t        v0 = k[0] ^ 0x736f6d6570736575ULL,
+      v1 = k[1] ^ 0x646f72616e646f6dULL,
+      v2 = k[0] ^ 0x6c7967656e657261ULL,
+      v3 = k[1] ^ 0x7465646279746573ULL,
+      b = ((uint64_t) len) << 56,
+      w;
+  size_t          i,
+                  j;
+
+  for (i = 0; i + 8 <= len; i += 8) {
+    for (w = 0, j = 0; j < 8; j++)
+      w |= ((uint64_t) m[i + j]) << (8 * j);
+    v3 ^= w;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= w;
+  }
+  for (j = 0; i + j < len; j++)
+    b |= ((uint64_t) m[i + j]) << (8 * j);
+  v3 ^= b;
+  SIPROUND;
+  SIPROUND;
+  v0 ^= b;
+  v2 ^= 0xff;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+static void
+makeTag(const char *user, const char *pw, const char *host, uint64_t * tag)
+{
+  size_t          ul = strlen(user) + 1,
+      pl = pw ? strlen(pw) + 1 : 0,
+      hl = host ? strlen(host) + 1 : 0;
+  unsigned char  *m = malloc(ul + pl + hl + 1);
+
+  /* the terminating zeros keep "a" "bc" apart from "ab" "c" */
+  memcpy(m, user, ul);
+  if (pw)
+    memcpy(m + ul, pw, pl);
+  if (host)
+    memcpy(m + ul + pl, host, hl);
+  m[ul + pl + hl] = (pw ? 1 : 0) | (host ? 2 : 0);
+  tag[0] = sipHash(secret, m, ul + pl + hl + 1);
+  tag[1] = sipHash(secret + 2, m, ul + pl + hl + 1);
+  memset(m, 0, ul + pl + hl + 1);
+  free(m);
+}
+
+static void
+makeSecret(void)
+{
+  int             fd = open("/dev/urandom", O_RDONLY);
+
+  if (fd < 0 || read(fd, secret, sizeof(secret)) != sizeof(secret)) {
+    mlogf(M_INFO, M_SHOW,
+          "--- /dev/urandom not readable, authentication cache keyed by time\n");
+    secret[0] = (uint64_t) time(NULL) ^ ((uint64_t) getpid() << 32);
+    secret[1] = (uint64_t) (uintptr_t) & fd ^ (uint64_t) clock();
+    secret[2] = ROTL(secret[0], 17) ^ 0x9e3779b97f4a7c15ULL;
+    secret[3] = ROTL(secret[1], 29) ^ 0xc2b2ae3d27d4eb4fULL;
+  }
+  if (fd >= 0)
+    close(fd);
+}
+
+void
+initAuthCache(void)
+{
+  union semun     sun;
+  long            entries;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "initAuthCache");
+
+  if (getControlNum("authCacheEntries", &entries))
+    entries = 256;
+  if (getControlNum("authCachePassTTL", &passTTL))
+    passTTL = 60;
+  if (getControlNum("authCacheFailTTL", &failTTL))
+    failTTL = 10;
+  if (entries <= 0 || (passTTL <= 0 && failTTL <= 0))
+    _SFCB_EXIT();
+
+  /*
+   * one cache per HTTP daemon, found by its request handlers through
+   * fork() like the mapping, so nothing is shared by key
+   */
+  if ((authCacheSem = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600)) == -1) {
+    mlogf(M_ERROR, M_SHOW,
+          "--- Authentication cache semaphore create failed: %s\n",
+          strerror(errno));
+    _SFCB_EXIT();
+  }
+  sun.val = 1;
+  semctl(authCacheSem, 0, SETVAL, sun);
+
+  cacheSize = sizeof(AuthCacheHdr) +
+      ((entries + AUTH_CACHE_WAYS - 1) / AUTH_CACHE_WAYS) *
+      AUTH_CACHE_WAYS * sizeof(AuthCacheEntry);
+  cache = mmap(NULL, cacheSize, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (cache == MAP_FAILED) {
+    mlogf(M_ERROR, M_SHOW, "--- Unable to map authentication cache: %s\n",
+          strerror(errno));
+    cache = NULL;
+    removeAuthCache();
+    _SFCB_EXIT();
+  }
+  /* fresh anonymous pages are zero, and gen 0 matches no entry */
+  cache->gen = 1;
+  cache->sets = (entries + AUTH_CACHE_WAYS - 1) / AUTH_CACHE_WAYS;
+  makeSecret();
+
+  _SFCB_TRACE(1, ("--- authentication cache of %u entries, ttl %ld/%ld",
+                  cache->sets * AUTH_CACHE_WAYS, passTTL, failTTL));
+  _SFCB_EXIT();
+}
+
+void
+removeAuthCache(void)
+{
+  union semun     sun;
+
+  if (authCacheSem != -1)
+    semctl(authCacheSem, 0, IPC_RMID, sun);
+  authCacheSem = -1;
+}
+
+int
+getAuthCache(const char *user, const char *pw, const char *host, int *rc,
+             const char **role)
+{
+  AuthCacheEntry *e;
+  uint64_t        tag[2];
+  time_t          now;
+  int             i,
+                  hit = 0;
+
+  if (cache == NULL)
+    return 0;
+
+  makeTag(user, pw, host, tag);
+  e = cache->ents + (tag[0] % cache->sets) * AUTH_CACHE_WAYS;
+  now = time(NULL);
+
+  if (semAcquireUnDo(authCacheSem, 0))
+    return 0;
+  for (i = 0; i < AUTH_CACHE_WAYS; i++, e++) {
+    if (e->tag[0] == tag[0] && e->tag[1] == tag[1] &&
+        e->gen == cache->gen && e->expires > now) {
+      *rc = e->rc;
+      memcpy(roleBuf, e->role, sizeof(roleBuf));
+      *role = *roleBuf ? roleBuf : NULL;
+      hit = 1;
+      break;
+    }
+  }
+  semReleaseUnDo(authCacheSem, 0);
+
+  return hit;
+}
+
+void
+putAuthCache(const char *user, const char *pw, const char *host, int rc,
+             const char *role, int passed)
+{
+  AuthCacheEntry *e,
+                 *v = NULL;
+  uint64_t        tag[2];
+  long            ttl = passed ? passTTL : failTTL;
+  time_t          now;
+  int             i;
+
+  if (cache == NULL || ttl <= 0 || (role && strlen(role) >= AUTH_CACHE_ROLE))
+    return;
+
+  makeTag(user, pw, host, tag);
+  e = cache->ents + (tag[0] % cache->sets) * AUTH_CACHE_WAYS;
+  now = time(NULL);
+
+  if (semAcquireUnDo(authCacheSem, 0))
+    return;
+  /* the same credentials, else a free or stale entry, else the oldest */
+  for (i = 0; i < AUTH_CACHE_WAYS; i++) {
+    if (e[i].tag[0] == tag[0] && e[i].tag[1] == tag[1]) {
+      v = e + i;
+      break;
+    }
+    if (e[i].gen != cache->gen || e[i].expires <= now)
+      v = e + i;
+    else if (v == NULL || (v->gen == cache->gen && v->expires > now &&
+                           e[i].expires < v->expires))
+      v = e + i;
+  }
+  v->tag[0] = tag[0];
+  v->tag[1] = tag[1];
+  v->expires = now + ttl;
+  v->gen = cache->gen;
+  v->rc = rc;
+  memset(v->role, 0, sizeof(v->role));
+  if (role)
+    strcpy(v->role, role);
+  semReleaseUnDo(authCacheSem, 0);
+}
+
+void
+flushAuthCache(void)
+{
+  if (cache)
+    __sync_fetch_and_add(&cache->gen, 1);
+}
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
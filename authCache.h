@@ -0,0 +1,60 @@
+/*
+ * authCache.h
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Basic authentication results shared by the HTTP request handlers
+ * (authCache).
+ *
+ * The HTTP daemon maps the cache before it forks any request handler, so
+ * that a client sending the same credentials again is answered without
+ * asking the authentication library. Entries are found by a hash of
+ * user, password and client address, keyed with a secret chosen at
+ * startup; neither user nor password is kept. Passed and failed checks
+ * expire after their own time to live.
+ *
+ */
+
+#ifndef AUTHCACHE_H
+#define AUTHCACHE_H
+
+/*
+ * called by the HTTP daemon; leaves the cache off unless authCacheEntries
+ * and one of the TTLs are non-zero
+ */
+extern void     initAuthCache(void);
+extern void     removeAuthCache(void);
+
+/*
+ * returns 1 and sets rc and role (NULL or valid until the next call) if
+ * the credentials were checked recently; host may be NULL
+ */
+extern int      getAuthCache(const char *user, const char *pw,
+                             const char *host, int *rc, const char **role);
+/*
+ * passed selects the TTL; role may be NULL
+ */
+extern void     putAuthCache(const char *user, const char *pw,
+                             const char *host, int rc, const char *role,
+                             int passed);
+/*
+ * drops all entries; safe to call from a signal handler
+ */
+extern void     flushAuthCache(void);
+
+#endif
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
@@ -23,6 +23,7 @@
 #include "native.h"
 #include "trace.h"
 #include "constClass.h"
+#include "classTree.h"
 #include <sfcCommon/utilft.h>
 
 extern const char *opGetClassNameChars(const CMPIObjectPath * cop);
@@ -144,6 +145,12 @@ __beft_classPathIsA(const CMPIBroker * broker,
     _SFCB_RETURN(0);
 
   ns = (char *) opGetNameSpaceChars(cop);
+  switch (classTreeIsA(ns, (char *) clsn->hdl, type)) {
+  case 0:
+    _SFCB_RETURN(0);
+  case 1:
+    _SFCB_RETURN(1);
+  }
   cc = (CMPIConstClass *) getConstClass(ns, opGetClassNameChars(cop));
 
   if (cc && type)
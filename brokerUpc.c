@@ -20,6 +20,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
 #include <error.h>
 
 #include "support.h"
@@ -47,6 +50,7 @@ extern void     memLinkObjectPath(CMPIObjectPath * op);
 extern ProviderInfo *activProvs;
 #ifdef SFCB_INCL_INDICATION_SUPPORT
 extern NativeSelectExp *activFilters;
+extern unsigned long activFiltersGen;
 #endif
 extern CMPIObjectPath *TrackedCMPIObjectPath(const char *nameSpace,
                                              const char *className,
@@ -55,6 +59,7 @@ extern void     setStatus(CMPIStatus *st, CMPIrc rc, char *msg);
 
 extern int      initProvider(ProviderInfo * info, unsigned int sessionId,
                              char **errorStr);
+extern void     upcallBlocking(int blocking);
 
 void            closeProviderContext(BinRequestContext * ctx);
 
@@ -79,6 +84,8 @@ lockUpCall(const CMPIBroker * mb)
     mtx = mb->xft->newMutex(0);
     atexit(freeUpCallMtx);
   }
+  /* waiting for the lock or the upcall, the thread is not a worker */
+  upcallBlocking(1);
   mb->xft->lockMutex(mtx);
 }
 
@@ -86,6 +93,7 @@ void
 unlockUpCall(const CMPIBroker * mb)
 {
   mb->xft->unlockMutex(mtx);
+  upcallBlocking(0);
 }
 
 static CMPIContext *
@@ -114,6 +122,110 @@ detachThread(const CMPIBroker * mb, const CMPIContext *ctx)
   _SFCB_RETURN(st);
 }
 
+#ifdef SFCB_INCL_INDICATION_SUPPORT
+/*
+ * the active filters whose FROM class an indication class is, or is a
+ * subclass of; found once per namespace and class, as the class
+ * hierarchy is that of the namespace, and kept until activFilters changes 
+ */
+typedef struct indFilterIndex {
+  struct indFilterIndex *next;
+  char           *nameSpace,
+                 *className;
+  int             count;
+  NativeSelectExp **filters;
+} IndFilterIndex;
+
+static IndFilterIndex *filterIndex = NULL;
+static unsigned long filterIndexGen = 0;
+static pthread_mutex_t filterIndexMtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+flushFilterIndex()
+{
+  IndFilterIndex *fi;
+
+  while ((fi = filterIndex) != NULL) {
+    filterIndex = fi->next;
+    free(fi->nameSpace);
+    free(fi->className);
+    free(fi->filters);
+    free(fi);
+  }
+}
+
+static IndFilterIndex *
+indexFilters(const CMPIBroker * mb, CMPIObjectPath * indop,
+             const char *ns, const char *cn)
+{
+  IndFilterIndex *fi = calloc(1, sizeof(*fi));
+  NativeSelectExp *se;
+  CMPIStatus      st;
+  int             x,
+                  n = 0;
+
+  for (se = activFilters; se; se = se->next)
+    n++;
+  fi->filters = malloc((n ? n : 1) * sizeof(*fi->filters));
+  fi->nameSpace = strdup(ns);
+  fi->className = strdup(cn);
+
+  for (se = activFilters; se; se = se->next) {
+    CMPIGcStat     *hc = (void *) (mb->mft->mark(mb, &st));
+    /* Check for matching FROM class */
+    for (x = 0; x < se->qs->fcNext; x++) {
+      if (CMClassPathIsA(mb, indop, se->qs->fClasses[x], &st)) {
+        fi->filters[fi->count++] = se;
+        break;
+      }
+    }
+    mb->mft->release(mb, hc);
+  }
+
+  fi->next = filterIndex;
+  filterIndex = fi;
+  return fi;
+}
+
+/*
+ * returns a copy of the candidate filters for the class of indop 
+ */
+static NativeSelectExp **
+candidateFilters(const CMPIBroker * mb, CMPIObjectPath * indop, int *count)
+{
+  IndFilterIndex *fi;
+  NativeSelectExp **filters;
+  CMPIString     *cn = CMGetClassName(indop, NULL),
+                 *ns = CMGetNameSpace(indop, NULL);
+  const char     *cns = CMGetCharPtr(cn),
+                 *nss = ns ? CMGetCharPtr(ns) : NULL;
+
+  if (nss == NULL)
+    nss = "";
+
+  pthread_mutex_lock(&filterIndexMtx);
+  if (filterIndexGen != activFiltersGen) {
+    flushFilterIndex();
+    filterIndexGen = activFiltersGen;
+  }
+  for (fi = filterIndex; fi; fi = fi->next)
+    if (strcasecmp(fi->className, cns) == 0 &&
+        strcasecmp(fi->nameSpace, nss) == 0)
+      break;
+  if (fi == NULL)
+    fi = indexFilters(mb, indop, nss, cns);
+
+  *count = fi->count;
+  filters = malloc((fi->count ? fi->count : 1) * sizeof(*filters));
+  memcpy(filters, fi->filters, fi->count * sizeof(*filters));
+  pthread_mutex_unlock(&filterIndexMtx);
+  CMRelease(cn);
+  if (ns)
+    CMRelease(ns);
+  return filters;
+}
+#endif
+
 static CMPIStatus
 deliverIndication(const CMPIBroker * mb, const CMPIContext *ctx,
                   const char *ns, const CMPIInstance *ind)
@@ -124,23 +236,17 @@ deliverIndication(const CMPIBroker * mb, const CMPIContext *ctx,
   CMPIArgs       *in = NULL;
   CMPIObjectPath *op = NULL;
   CMPIObjectPath *indop = CMGetObjectPath(ind, &st);
-  int x, classMatch = 0;
+  NativeSelectExp **filters;
+  int x, count;
 
   _SFCB_ENTER(TRACE_INDPROVIDER | TRACE_UPCALLS, "deliverIndication");
 
-  NativeSelectExp *se = activFilters;
+  filters = candidateFilters(mb, indop, &count);
+  _SFCB_TRACE(1, ("--- %d candidate filters", count));
 
-  while (se) {
-    CMPIGcStat *hc = (void *)(mb->mft->mark(mb, &st));
-    /* Check for matching FROM class */
-    for (x=0; x<se->qs->fcNext; x++) {
-      if (CMClassPathIsA(mb, indop, se->qs->fClasses[x], &st)) {
-        classMatch = 1;
-        break;
-      }
-    }
-    mb->mft->release(mb, hc);
-    if (classMatch && se->exp.ft->evaluate(&se->exp, ind, &st)) {
+  for (x = 0; x < count; x++) {
+    NativeSelectExp *se = filters[x];
+    if (se->exp.ft->evaluate(&se->exp, ind, &st)) {
       /*
        * apply a propertyfilter in case the query is not "SELECT * FROM
        * ..." 
@@ -170,9 +276,8 @@ deliverIndication(const CMPIBroker * mb, const CMPIContext *ctx,
       CMRelease(op);
       CMRelease(in);
     }
-    classMatch = 0; /* 3483200 */
-    se = se->next;
   }
+  free(filters);
   CMRelease(indop); /* 3588557 */
 
   _SFCB_RETURN(st);
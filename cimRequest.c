@@ -20,7 +20,18 @@
  *
  */
 
+#define _GNU_SOURCE             /* struct ucred */
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 
 #include "cmpi/cmpidt.h"
 #include "cimXmlGen.h"
@@ -110,8 +121,20 @@ static char    *cimMsg[] = {
   "The query language is not recognized or supported",
   "The query is not valid for the specified query language",
   "The extrinsic Method could not be executed",
-  "The specified extrinsic Method does not exist"
+  "The specified extrinsic Method does not exist",
+  "The namespace is not empty",
+  "The enumeration context is invalid",
+  "The operation timeout is not supported",
+  "The pull operation has been abandoned",
+  "The attempt to abandon a pull operation has failed",
+  NULL,
+  NULL,
+  "Filtered enumeration is not supported",
+  "Continuation on error is not supported",
+  "The server limits have been exceeded",
+  "The server is shutting down"
 };
+#define CIM_MSG_COUNT (int) (sizeof(cimMsg) / sizeof(char *))
 /*
  * static char *cimMsgId[] = { "", "CIM_ERR_FAILED",
  * "CIM_ERR_ACCESS_DENIED", "CIM_ERR_INVALID_NAMESPACE",
@@ -258,7 +281,7 @@ getErrSegment(int rc, char *m)
     msg = sfcb_snprintf("<ERROR CODE=\"%d\" DESCRIPTION=\"%s\"/>\n",
                         rc, escapedMsg);
     free(escapedMsg);
-  } else if (rc > 0 && rc < 18) {
+  } else if (rc > 0 && rc < CIM_MSG_COUNT && cimMsg[rc]) {
     msg = sfcb_snprintf("<ERROR CODE=\"%d\" DESCRIPTION=\"%s\"/>\n",
                         rc, cimMsg[rc]);
   } else {
@@ -278,7 +301,7 @@ getErrTrailer(int rc, char *m)
 
   if (m && *m)
     msg = sfcb_snprintf("CIMStatusCodeDescription: %s\r\n", m);
-  else if (rc > 0 && rc < 18)
+  else if (rc > 0 && rc < CIM_MSG_COUNT && cimMsg[rc])
     msg = sfcb_snprintf("CIMStatusCodeDescription: %s\r\n", cimMsg[rc]);
   else
     msg = strdup("CIMStatusCodeDescription: *Unknown*\r\n");
@@ -651,6 +674,22 @@ genFirstChunkErrorResponse(BinRequestContext * binCtx, int rc, char *msg)
   _SFCB_RETURN(iMethodErrResponse(binCtx->rHdr, getErrSegment(rc, msg)));
 }
 
+/*
+ * Provider sockets come with every provider context; close them so
+ * long-lived request processors do not run out of descriptors.
+ */
+static void
+releaseProviderContext(BinRequestContext * binCtx)
+{
+  unsigned long   i;
+
+  if (!localMode)
+    for (i = 0; i < binCtx->pCount; i++)
+      if (binCtx->pAs[i].socket >= 0)
+        close(binCtx->pAs[i].socket);
+  closeProviderContext(binCtx);
+}
+
 static          RespSegments
 getClass(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
 {
@@ -668,7 +707,7 @@ getClass(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       cls = relocateSerializedConstClass(resp->object[0].data);
@@ -690,7 +729,7 @@ getClass(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     _SFCB_RETURN(rs);
   }
   free(hdr->binCtx->bHdr);
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
 
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -710,7 +749,7 @@ deleteClass(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       if (resp) {
@@ -728,7 +767,7 @@ deleteClass(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -747,7 +786,7 @@ createClass(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
 // TODO: How will we free this, now that it's getting
 // built somewhere else?
@@ -772,7 +811,7 @@ createClass(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -799,7 +838,7 @@ enumClassNames(CimRequestContext * ctx, RequestHdr * hdr)
     _SFCB_TRACE(1, ("--- Calling Providers"));
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Provider"));
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     if (err == 0) {
       rs = genResponses(hdr->binCtx, resp, l);
     } else {
@@ -812,7 +851,7 @@ enumClassNames(CimRequestContext * ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -847,7 +886,7 @@ enumClasses(CimRequestContext * ctx, RequestHdr * hdr)
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Provider"));
 
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
 
     if (ctx->teTrailers == 0) {
       if (err == 0) {
@@ -871,7 +910,7 @@ enumClasses(CimRequestContext * ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -891,7 +930,7 @@ getInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
 
   if (irc == MSG_X_PROVIDER) {
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       inst = relocateSerializedInstance(resp->object[0].data);
@@ -914,7 +953,7 @@ getInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     _SFCB_RETURN(rs);
   }
   free(hdr->binCtx->bHdr);
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
 
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -932,7 +971,7 @@ deleteInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       if (resp) {
@@ -950,7 +989,7 @@ deleteInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -970,7 +1009,7 @@ createInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       path = relocateSerializedObjectPath(resp->object[0].data);
@@ -991,7 +1030,7 @@ createInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1017,7 +1056,7 @@ modifyInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     free(hdr->binCtx->bHdr);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
@@ -1034,7 +1073,7 @@ modifyInstance(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr
     }
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
 
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
@@ -1060,7 +1099,7 @@ enumInstanceNames(CimRequestContext * ctx, RequestHdr * hdr)
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Provider"));
 
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     if (err == 0) {
       rs = genResponses(hdr->binCtx, resp, l);
     } else {
@@ -1073,7 +1112,7 @@ enumInstanceNames(CimRequestContext * ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1109,7 +1148,7 @@ enumInstances(CimRequestContext * ctx, RequestHdr * hdr)
     _SFCB_TRACE(1, ("--- Calling Providers"));
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Providers"));
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
 
     if (ctx->teTrailers == 0) {
       if (err == 0) {
@@ -1131,7 +1170,7 @@ enumInstances(CimRequestContext * ctx, RequestHdr * hdr)
     rs.errMsg = NULL;
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1167,7 +1206,7 @@ execQuery(CimRequestContext * ctx, RequestHdr * hdr)
     _SFCB_TRACE(1, ("--- Calling Provider"));
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Provider"));
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
 
     if (ctx->teTrailers == 0) {
       if (err == 0) {
@@ -1189,7 +1228,7 @@ execQuery(CimRequestContext * ctx, RequestHdr * hdr)
     rs.errMsg = NULL;
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
 
@@ -1217,7 +1256,7 @@ associatorNames(CimRequestContext * ctx, RequestHdr * hdr)
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Providers"));
 
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     if (err == 0) {
       rs = genResponses(hdr->binCtx, resp, l);
     } else {
@@ -1231,7 +1270,7 @@ associatorNames(CimRequestContext * ctx, RequestHdr * hdr)
     _SFCB_RETURN(rs);
   }
   free(hdr->binCtx->bHdr);
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
 
@@ -1266,7 +1305,7 @@ associators(CimRequestContext * ctx, RequestHdr * hdr)
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Provider"));
 
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
 
     if (ctx->teTrailers == 0) {
       if (err == 0) {
@@ -1290,7 +1329,7 @@ associators(CimRequestContext * ctx, RequestHdr * hdr)
     _SFCB_RETURN(rs);
   }
   free(hdr->binCtx->bHdr);
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
 
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1317,7 +1356,7 @@ referenceNames(CimRequestContext * ctx, RequestHdr * hdr)
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Providers"));
 
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     if (err == 0) {
       rs = genResponses(hdr->binCtx, resp, l);
     } else {
@@ -1330,7 +1369,7 @@ referenceNames(CimRequestContext * ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1365,7 +1404,7 @@ references(CimRequestContext * ctx, RequestHdr * hdr)
     _SFCB_TRACE(1, ("--- Calling Provider"));
     resp = invokeProviders(hdr->binCtx, &err, &l);
     _SFCB_TRACE(1, ("--- Back from Provider"));
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
 
     if (ctx->teTrailers == 0) {
       if (err == 0) {
@@ -1387,7 +1426,7 @@ references(CimRequestContext * ctx, RequestHdr * hdr)
     rs.errMsg = NULL;
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
 
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
@@ -1413,7 +1452,7 @@ invokeMethod(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     if(*method_name == '_') {
       RespSegments  rs;
       rs = methodErrResponse(hdr, getErrSegment(CMPI_RC_ERR_ACCESS_DENIED, NULL));
-      closeProviderContext(hdr->binCtx);
+      releaseProviderContext(hdr->binCtx);
       _SFCB_RETURN(rs);
     } else {
       irc = MSG_X_PROVIDER;
@@ -1423,7 +1462,7 @@ invokeMethod(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       sb = UtilFactory->newStrinBuffer(1024);
@@ -1460,7 +1499,7 @@ invokeMethod(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 1));
 }
@@ -1484,7 +1523,7 @@ getProperty(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       inst = relocateSerializedInstance(resp->object[0].data);
@@ -1508,7 +1547,7 @@ getProperty(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     _SFCB_RETURN(rs);
   }
   free(hdr->binCtx->bHdr);
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
 
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1528,7 +1567,7 @@ setProperty(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       if (resp) {
@@ -1546,7 +1585,7 @@ setProperty(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1571,7 +1610,7 @@ enumQualifiers(CimRequestContext * ctx, RequestHdr * hdr)
     _SFCB_TRACE(1, ("--- Calling Providers"));
     resp = invokeProvider(hdr->binCtx);
     _SFCB_TRACE(1, ("--- Back from Provider"));
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       rs = genQualifierResponses(hdr->binCtx, resp);
@@ -1586,7 +1625,7 @@ enumQualifiers(CimRequestContext * ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1608,7 +1647,7 @@ getQualifier(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       qual = relocateSerializedQualifier(resp->object[0].data);
@@ -1630,7 +1669,7 @@ getQualifier(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1649,7 +1688,7 @@ deleteQualifier(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hd
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
       if (resp) {
@@ -1667,7 +1706,7 @@ deleteQualifier(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hd
     free(hdr->binCtx->bHdr);
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   free(hdr->binCtx->bHdr);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
@@ -1690,7 +1729,7 @@ setQualifier(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
   if (irc == MSG_X_PROVIDER) {
     RespSegments    rs;
     resp = invokeProvider(hdr->binCtx);
-    closeProviderContext(hdr->binCtx);
+    releaseProviderContext(hdr->binCtx);
     qual->ft->release(qual);
     resp->rc--;
     if (resp->rc == CMPI_RC_OK) {
@@ -1710,12 +1749,970 @@ setQualifier(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
     }
     _SFCB_RETURN(rs);
   }
-  closeProviderContext(hdr->binCtx);
+  releaseProviderContext(hdr->binCtx);
   qual->ft->release(qual);
   _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
 }
 #endif
 
+/*
+ * Pull operations
+ *
+ * An Open* request gets its provider context in chunked mode and hands it
+ * to an enumeration context holder, a process forked off the request
+ * handler so that the context outlives the HTTP request. The holder
+ * listens on an abstract unix socket named after the context id and reads
+ * provider chunks only as far as needed to fill the batches asked for by
+ * the Open* and Pull* requests; what is not needed yet stays in the
+ * provider socket. The context ends with EndOfSequence, CloseEnumeration,
+ * an error, or when no request arrives within the operation timeout.
+ *
+ * The HTTP daemon keeps the pids of the holders its request handlers
+ * started in shared memory, at most pullMaxEnumerationContexts of them,
+ * and kills them when it stops.
+ */
+
+#define CIM_ERR_INVALID_ENUMERATION_CONTEXT 19
+#define CIM_ERR_INVALID_OPERATION_TIMEOUT 20
+#define CIM_ERR_FILTERED_ENUMERATION_NOT_SUPPORTED 25
+#define CIM_ERR_CONTINUATION_ON_ERROR_NOT_SUPPORTED 26
+#define CIM_ERR_SERVER_LIMITS_EXCEEDED 27
+
+extern CMPIValue queryGetValue(QLPropertySource * src, char *name,
+                               QLOpd * type);
+extern int      spSendAck(int to);
+
+typedef struct enumOpenParms {
+  unsigned int    flags;
+  char           *filterQuery,
+                 *filterQueryLang;
+  uint32_t        operationTimeout;
+  uint32_t        maxObjectCount;
+} EnumOpenParms;
+
+typedef struct enumCtxReq {
+  int             op;           /* Open*, Pull*, CloseEnumeration,
+                                 * EnumerationCount */
+  unsigned long   maxObjectCount;
+  unsigned long   principalLength;
+} EnumCtxReq;
+
+typedef struct enumCtxRsp {
+  int             rc;
+  int             endOfSequence;
+  int             countKnown;
+  unsigned long   count;
+  unsigned long   xmlLength;
+  unsigned long   msgLength;
+} EnumCtxRsp;
+
+/*
+ * a slot holds 0 if free, the pid of a holder, or minus the pid of the
+ * request handler starting one
+ */
+typedef struct enumCtxHolders {
+  volatile int    stopping;
+  long            max;
+  volatile pid_t  pid[];
+} EnumCtxHolders;
+
+static EnumCtxHolders *holders = NULL;
+
+/* listen sockets of the HTTP daemon, closed by holders */
+static int      holderCloses[4];
+static int      holderCloseCount = 0;
+
+/*
+ * chunks a holder reads ahead of the client; the provider worker sending
+ * them is free once it has sent its last chunk
+ */
+#define ENUM_CTX_AHEAD 16
+
+typedef struct enumCtx {
+  uint64_t        id;
+  long            slot;         /* in holders */
+  int             fd;           /* listening socket of the holder */
+  long            timeout;
+  char           *principal;
+  int             xmlAs;
+  QLStatement    *filter;
+  BinRequestContext *binCtx;
+  ComSockets      sockets;      /* provider result socket pair */
+  int             ok;
+  unsigned long   prov;         /* provider read from or called next */
+  int             active;       /* prov has more chunks to send */
+  int             ackOwed;      /* the last chunk received is not acked */
+  BinResponseHdr *queue[ENUM_CTX_AHEAD];        /* chunks received */
+  int             first,        /* chunk being returned */
+                  queued;
+  unsigned long   next;         /* next object in the first chunk */
+} EnumCtx;
+
+#define OPEN_PARMS(t) { \
+    t *o = (t *) oHdr; \
+    p->flags = o->flags; \
+    p->filterQuery = o->filterQuery; \
+    p->filterQueryLang = o->filterQueryLang; \
+    p->operationTimeout = o->operationTimeout; \
+    p->maxObjectCount = o->maxObjectCount; \
+  }
+
+static void
+getOpenParms(OperationHdr * oHdr, EnumOpenParms * p)
+{
+  switch (oHdr->type) {
+  case OPS_OpenEnumerateInstancePaths:
+    OPEN_PARMS(XtokOpenEnumInstancePaths);
+    break;
+  case OPS_OpenEnumerateInstances:
+    OPEN_PARMS(XtokOpenEnumInstances);
+    break;
+  case OPS_OpenAssociatorInstancePaths:
+    OPEN_PARMS(XtokOpenAssociatorInstancePaths);
+    break;
+  case OPS_OpenAssociatorInstances:
+    OPEN_PARMS(XtokOpenAssociatorInstances);
+    break;
+  case OPS_OpenReferenceInstancePaths:
+    OPEN_PARMS(XtokOpenReferenceInstancePaths);
+    break;
+  case OPS_OpenReferenceInstances:
+    OPEN_PARMS(XtokOpenReferenceInstances);
+    break;
+  case OPS_OpenQueryInstances:
+    OPEN_PARMS(XtokOpenQueryInstances);
+    /* the filter is the query itself, it goes to the providers */
+    p->filterQuery = NULL;
+    break;
+  default:
+    memset(p, 0, sizeof(*p));
+  }
+}
+
+static int
+isPathsOpen(int op)
+{
+  return op == OPS_OpenEnumerateInstancePaths ||
+      op == OPS_OpenAssociatorInstancePaths ||
+      op == OPS_OpenReferenceInstancePaths;
+}
+
+/*
+ * the Pull operation that may continue an enumeration opened by open
+ */
+static int
+pullMatchesOpen(int pull, int open)
+{
+  if (pull == OPS_PullInstancePaths)
+    return isPathsOpen(open);
+  if (pull == OPS_PullInstances)
+    return open == OPS_OpenQueryInstances;
+  if (pull == OPS_PullInstancesWithPath)
+    return !isPathsOpen(open) && open != OPS_OpenQueryInstances;
+  return pull == open;
+}
+
+static unsigned long
+pullObjectCount(unsigned long count)
+{
+  long            max;
+
+  if (getControlNum("pullMaxObjectCount", &max))
+    max = 10000;
+  if (max > 0 && count > (unsigned long) max)
+    count = max;
+  return count;
+}
+
+static int
+enumIo(int fd, void *buf, unsigned long len, int wr)
+{
+  char           *p = buf;
+  ssize_t         n;
+
+  while (len) {
+    if (wr)
+      n = send(fd, p, len, MSG_NOSIGNAL);
+    else
+      n = recv(fd, p, len, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/*
+ * called by the HTTP daemon before it starts any request handler, with
+ * its listen sockets (-1 for those not in use)
+ */
+void
+initEnumCtxHolders(int *listenFds, int n)
+{
+  long            max;
+  int             i;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "initEnumCtxHolders");
+
+  for (i = 0; i < n; i++)
+    if (listenFds[i] >= 0 &&
+        holderCloseCount < (int) (sizeof(holderCloses) / sizeof(int)))
+      holderCloses[holderCloseCount++] = listenFds[i];
+
+  if (getControlNum("pullMaxEnumerationContexts", &max))
+    max = 64;
+  if (max < 1)
+    max = 1;
+  holders = mmap(NULL, sizeof(EnumCtxHolders) + max * sizeof(pid_t),
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (holders == MAP_FAILED) {
+    mlogf(M_ERROR, M_SHOW,
+          "--- Unable to map enumeration context table: %s\n",
+          strerror(errno));
+    holders = NULL;
+    _SFCB_EXIT();
+  }
+  holders->max = max;
+  _SFCB_EXIT();
+}
+
+/*
+ * called by the HTTP daemon when it stops, holders starting after this
+ * see stopping and leave by themselves
+ */
+void
+stopEnumCtxHolders()
+{
+  long            i;
+  pid_t           p;
+
+  if (holders == NULL)
+    return;
+  holders->stopping = 1;
+  __sync_synchronize();
+  for (i = 0; i < holders->max; i++)
+    if ((p = holders->pid[i]) > 0)
+      kill(p, SIGTERM);
+}
+
+/*
+ * returns a free slot, or -1 if there are max holders already; slots of
+ * processes that died without freeing them are taken over
+ */
+static long
+claimHolderSlot()
+{
+  pid_t           me = -getpid(),
+                  p;
+  long            i;
+
+  if (holders == NULL || holders->stopping)
+    return -1;
+  for (i = 0; i < holders->max; i++)
+    if (__sync_bool_compare_and_swap(&holders->pid[i], 0, me))
+      return i;
+  for (i = 0; i < holders->max; i++) {
+    p = holders->pid[i];
+    if (p && p != me && kill(p > 0 ? p : -p, 0) && errno == ESRCH &&
+        __sync_bool_compare_and_swap(&holders->pid[i], p, me))
+      return i;
+  }
+  return -1;
+}
+
+static void
+freeHolderSlot(long slot)
+{
+  holders->pid[slot] = 0;
+}
+
+static          socklen_t
+enumCtxAddr(uint64_t id, struct sockaddr_un *sun)
+{
+  int             l;
+
+  memset(sun, 0, sizeof(*sun));
+  sun->sun_family = AF_UNIX;
+  /* abstract name, nothing is left behind in the file system */
+  l = snprintf(sun->sun_path + 1, sizeof(sun->sun_path) - 1,
+               "sfcbEnum.%llu", (unsigned long long) id);
+  return offsetof(struct sockaddr_un, sun_path) + 1 + l;
+}
+
+static          uint64_t
+newEnumCtxId()
+{
+  uint64_t        id = 0;
+  struct timeval  tv;
+  int             fd = open("/dev/urandom", O_RDONLY);
+
+  if (fd >= 0) {
+    if (read(fd, &id, sizeof(id)) != sizeof(id))
+      id = 0;
+    close(fd);
+  }
+  if (id == 0) {
+    gettimeofday(&tv, NULL);
+    id = ((uint64_t) tv.tv_sec << 32) ^ ((uint64_t) tv.tv_usec << 12) ^
+        ((uint64_t) random() << 20) ^ getpid();
+  }
+  /* 0 is what the parser returns for a malformed context */
+  return id ? id : 1;
+}
+
+/*
+ * send req to the holder of enumeration context id and wait for its
+ * response, returns -1 if there is no such context
+ */
+static int
+enumCtxRequest(uint64_t id, EnumCtxReq * req, char *principal,
+               EnumCtxRsp * rsp, char **xml, char **msg)
+{
+  struct sockaddr_un sun;
+  socklen_t       sl = enumCtxAddr(id, &sun);
+  int             fd,
+                  rc = -1;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "enumCtxRequest");
+
+  *xml = *msg = NULL;
+  req->principalLength = strlen(principal);
+  if ((fd = socket(PF_UNIX, SOCK_STREAM, 0)) < 0)
+    _SFCB_RETURN(-1);
+
+  if (connect(fd, (struct sockaddr *) &sun, sl) == 0 &&
+      enumIo(fd, req, sizeof(*req), 1) == 0 &&
+      enumIo(fd, principal, req->principalLength, 1) == 0 &&
+      enumIo(fd, rsp, sizeof(*rsp), 0) == 0) {
+    *xml = malloc(rsp->xmlLength + 1);
+    *msg = malloc(rsp->msgLength + 1);
+    if (enumIo(fd, *xml, rsp->xmlLength, 0) == 0 &&
+        enumIo(fd, *msg, rsp->msgLength, 0) == 0) {
+      (*xml)[rsp->xmlLength] = 0;
+      (*msg)[rsp->msgLength] = 0;
+      rc = 0;
+    } else {
+      free(*xml);
+      free(*msg);
+      *xml = *msg = NULL;
+    }
+  }
+  close(fd);
+  _SFCB_TRACE(1, ("--- context %llu op %d rc %d", (unsigned long long) id,
+                  req->op, rc));
+  _SFCB_RETURN(rc);
+}
+
+/*
+ * return up to max objects of the current chunk as XML, objects dropped by
+ * the filter query do not count
+ */
+static unsigned long
+enumCtxEmit(EnumCtx * ec, unsigned long max, UtilStringBuffer * sb)
+{
+  BinRequestContext *binCtx = ec->binCtx;
+  BinResponseHdr *chunk = ec->queue[ec->first];
+  void           *hc = markHeap();
+  void          **objs = malloc(sizeof(void *) * (chunk->count + 1));
+  void           *object;
+  unsigned long   n = 0,
+                  i;
+  CMPIArray      *ar;
+  CMPIEnumeration *enm;
+
+  for (; ec->next < chunk->count && n < max; ec->next++) {
+    if (binCtx->type == CMPI_ref)
+      object = relocateSerializedObjectPath(chunk->object[ec->next].data);
+    else
+      object = relocateSerializedInstance(chunk->object[ec->next].data);
+    if (ec->filter && ec->filter->where) {
+      ec->filter->propSrc.data = object;
+      if (ec->filter->where->ft->evaluate(ec->filter->where,
+                                          &ec->filter->propSrc) != 1)
+        continue;
+    }
+    objs[n++] = object;
+  }
+
+  if (n) {
+    ar = TrackedCMPIArray(n, binCtx->type, NULL);
+    for (i = 0; i < n; i++)
+      arraySetElementNotTrackedAt(ar, i, (CMPIValue *) & objs[i],
+                                  binCtx->type);
+    enm = sfcb_native_new_CMPIEnumeration(ar, NULL);
+    enum2xml(enm, sb, binCtx->type, ec->xmlAs, binCtx->bHdr->flags,
+             binCtx->httpHost);
+  }
+  free(objs);
+  releaseHeap(hc);
+  return n;
+}
+
+/*
+ * receive the next chunk of the current provider; it is acknowledged at
+ * once while there is room for the one after it, else when the first
+ * chunk has been returned
+ */
+static void
+enumCtxReceive(EnumCtx * ec)
+{
+  BinResponseHdr *chunk = recvProviderChunk(ec->sockets, &ec->ok);
+
+  ec->queue[(ec->first + ec->queued++) % ENUM_CTX_AHEAD] = chunk;
+  if (chunk->rc != 1 || !chunk->moreChunks)
+    ec->active = 0;
+  else if (ec->queued < ENUM_CTX_AHEAD)
+    spSendAck(ec->sockets.receive);
+  else
+    ec->ackOwed = 1;
+}
+
+/*
+ * a chunk to read ahead is on its way
+ */
+static int
+enumCtxAhead(EnumCtx * ec)
+{
+  return ec->active && !ec->ackOwed;
+}
+
+static void
+enumCtxDrop(EnumCtx * ec)
+{
+  BinResponseHdr *chunk = ec->queue[ec->first];
+
+  if (!chunk->moreChunks)
+    ec->prov++;
+  free(chunk);
+  ec->first = (ec->first + 1) % ENUM_CTX_AHEAD;
+  ec->queued--;
+  ec->next = 0;
+  if (ec->ackOwed) {
+    spSendAck(ec->sockets.receive);
+    ec->ackOwed = 0;
+  }
+}
+
+/*
+ * fill a batch of up to max objects, calling the providers one after the
+ * other
+ */
+static int
+enumCtxFill(EnumCtx * ec, unsigned long max, UtilStringBuffer * sb,
+            char **msg)
+{
+  BinRequestContext *binCtx = ec->binCtx;
+  BinResponseHdr *chunk;
+  unsigned long   n = 0;
+  int             rc;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "enumCtxFill");
+
+  while (n < max) {
+    if (ec->queued == 0) {
+      if (ec->active)
+        enumCtxReceive(ec);
+      else if (ec->prov < binCtx->pCount) {
+        binCtx->provA = binCtx->pAs[ec->prov];
+        sendProviderRequest(binCtx, ec->sockets);
+        ec->active = 1;
+        continue;
+      } else
+        break;
+    }
+    chunk = ec->queue[ec->first];
+    if (chunk->rc != 1) {
+      rc = chunk->rc - 1;
+      if (chunk->count)
+        *msg = strdup((char *) chunk->object[0].data);
+      _SFCB_RETURN(rc);
+    }
+    n += enumCtxEmit(ec, max - n, sb);
+    if (ec->next == chunk->count)
+      enumCtxDrop(ec);
+  }
+  _SFCB_TRACE(1, ("--- %lu objects, provider %lu of %lu, %d chunks ahead",
+                  n, ec->prov, binCtx->pCount, ec->queued));
+  _SFCB_RETURN(0);
+}
+
+static int
+enumCtxAtEnd(EnumCtx * ec)
+{
+  return ec->queued == 0 && !ec->active &&
+      ec->prov >= ec->binCtx->pCount;
+}
+
+/*
+ * the number of objects left, or -1 if it is not known yet: it is once
+ * the last provider has sent its last chunk, unless there is a filter
+ */
+static long
+enumCtxLeft(EnumCtx * ec)
+{
+  long            count;
+  int             i;
+
+  if (enumCtxAtEnd(ec))
+    return 0;
+  if (ec->active || ec->queued == 0 || ec->filter ||
+      ec->prov + 1 != ec->binCtx->pCount)
+    return -1;
+  for (count = -ec->next, i = 0; i < ec->queued; i++) {
+    if (ec->queue[(ec->first + i) % ENUM_CTX_AHEAD]->rc != 1)
+      return -1;
+    count += ec->queue[(ec->first + i) % ENUM_CTX_AHEAD]->count;
+  }
+  return count;
+}
+
+/*
+ * serve one request to the holder, returns 0 if it did not come from the
+ * principal that opened the context
+ */
+static int
+enumCtxServe(EnumCtx * ec, int fd, int *done)
+{
+  EnumCtxReq      req;
+  EnumCtxRsp      rsp;
+  struct ucred    cr;
+  socklen_t       cl = sizeof(cr);
+  char           *principal,
+                 *msg = NULL;
+  UtilStringBuffer *sb = NULL;
+  int             owner = 0;
+  long            left;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "enumCtxServe");
+
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &cl) ||
+      cr.uid != geteuid() ||
+      enumIo(fd, &req, sizeof(req), 0) || req.principalLength > 4096)
+    _SFCB_RETURN(0);
+  principal = malloc(req.principalLength + 1);
+  if (enumIo(fd, principal, req.principalLength, 0)) {
+    free(principal);
+    _SFCB_RETURN(0);
+  }
+  principal[req.principalLength] = 0;
+
+  memset(&rsp, 0, sizeof(rsp));
+  if (strcmp(principal, ec->principal)) {
+    rsp.rc = CIM_ERR_INVALID_ENUMERATION_CONTEXT;
+  } else {
+    owner = 1;
+    switch (req.op) {
+    case OPS_CloseEnumeration:
+      *done = 1;
+      break;
+    case OPS_EnumerationCount:
+      if ((left = enumCtxLeft(ec)) >= 0) {
+        rsp.countKnown = 1;
+        rsp.count = left;
+      }
+      break;
+    default:
+      if (!pullMatchesOpen(req.op, ec->binCtx->oHdr->type)) {
+        rsp.rc = CIM_ERR_INVALID_ENUMERATION_CONTEXT;
+        msg = strdup("Pull operation does not match the open operation");
+        *done = 1;
+        break;
+      }
+      sb = UtilFactory->newStrinBuffer(4096);
+      rsp.rc = enumCtxFill(ec, req.maxObjectCount, sb, &msg);
+      rsp.endOfSequence = enumCtxAtEnd(ec);
+      if (rsp.rc || rsp.endOfSequence)
+        *done = 1;
+    }
+  }
+
+  rsp.xmlLength = sb ? sb->ft->getSize(sb) : 0;
+  rsp.msgLength = msg ? strlen(msg) : 0;
+  if (enumIo(fd, &rsp, sizeof(rsp), 1) == 0 &&
+      enumIo(fd, sb ? (void *) sb->ft->getCharPtr(sb) : NULL,
+             rsp.xmlLength, 1) == 0)
+    enumIo(fd, msg, rsp.msgLength, 1);
+
+  if (sb)
+    sb->ft->release(sb);
+  if (msg)
+    free(msg);
+  free(principal);
+  _SFCB_RETURN(owner);
+}
+
+/*
+ * the enumeration context holder process, never returns
+ */
+static void
+enumCtxHolder(EnumCtx * ec)
+{
+  struct pollfd   pfd[2];
+  time_t          deadline;
+  long            left;
+  int             done = 0,
+                  fd,
+                  rc;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "enumCtxHolder");
+
+  signal(SIGCHLD, SIG_DFL);
+  signal(SIGPIPE, SIG_IGN);
+  /* the HTTP daemon ignores it, but kills us with it when stopping */
+  signal(SIGTERM, SIG_DFL);
+
+  holders->pid[ec->slot] = getpid();
+  __sync_synchronize();
+  if (holders->stopping) {
+    freeHolderSlot(ec->slot);
+    _exit(0);
+  }
+
+  /* the providers stay in use until the context is gone */
+  holdProviderContext(ec->binCtx);
+  ec->sockets = getSocketPair("enumCtxHolder");
+  ec->ok = 1;
+
+  /*
+   * between requests, read ahead what the provider sends, so that its
+   * worker is not held up by a client that pulls slowly
+   */
+  deadline = time(NULL) + ec->timeout;
+  while (!done && (left = deadline - time(NULL)) > 0) {
+    pfd[0].fd = ec->fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = ec->sockets.receive;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+    rc = poll(pfd, enumCtxAhead(ec) ? 2 : 1, left * 1000);
+    if (rc < 0 && errno == EINTR)
+      continue;
+    if (rc <= 0)
+      break;
+    if (pfd[1].revents)
+      enumCtxReceive(ec);
+    if (!(pfd[0].revents & POLLIN) || (fd = accept(ec->fd, NULL, NULL)) < 0)
+      continue;
+    if (enumCtxServe(ec, fd, &done))
+      deadline = time(NULL) + ec->timeout;
+    close(fd);
+  }
+  _SFCB_TRACE(1, ("--- context %llu %s", (unsigned long long) ec->id,
+                  done ? "done" : "timed out"));
+
+  close(ec->fd);
+  /* a provider may still be sending, never pool this pair */
+  closeSocket(&ec->sockets, cAll, "enumCtxHolder");
+  releaseProviderContext(ec->binCtx);
+  freeHolderSlot(ec->slot);
+  _exit(0);
+}
+
+static          RespSegments
+enumCtxResponse(RequestHdr * hdr, uint64_t id, EnumCtxRsp * rsp, char *xml,
+                char *msg)
+{
+  RespSegments    rs;
+  UtilStringBuffer *sb;
+  char            ctxId[32];
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "enumCtxResponse");
+
+  if (rsp->rc) {
+    rs = iMethodErrResponse(hdr, getErrSegment(rsp->rc, msg));
+    free(xml);
+    free(msg);
+    _SFCB_RETURN(rs);
+  }
+
+  sb = UtilFactory->newStrinBuffer(rsp->xmlLength + 512);
+  sb->ft->appendChars(sb, xml);
+  SFCB_APPENDCHARS_BLOCK(sb, "</IRETURNVALUE>\n");
+  if (rsp->endOfSequence)
+    SFCB_APPENDCHARS_BLOCK(sb,
+                           "<PARAMVALUE NAME=\"EnumerationContext\" PARAMTYPE=\"string\"/>\n"
+                           "<PARAMVALUE NAME=\"EndOfSequence\" PARAMTYPE=\"boolean\">\n"
+                           "<VALUE>TRUE</VALUE>\n</PARAMVALUE>\n");
+  else {
+    snprintf(ctxId, sizeof(ctxId), "%llu", (unsigned long long) id);
+    SFCB_APPENDCHARS_BLOCK(sb,
+                           "<PARAMVALUE NAME=\"EnumerationContext\" PARAMTYPE=\"string\">\n"
+                           "<VALUE>");
+    sb->ft->appendChars(sb, ctxId);
+    SFCB_APPENDCHARS_BLOCK(sb,
+                           "</VALUE>\n</PARAMVALUE>\n"
+                           "<PARAMVALUE NAME=\"EndOfSequence\" PARAMTYPE=\"boolean\">\n"
+                           "<VALUE>FALSE</VALUE>\n</PARAMVALUE>\n");
+  }
+  free(xml);
+  free(msg);
+
+  rs = iMethodResponse(hdr, sb);
+  /* IRETURNVALUE has been closed ahead of the output parameters */
+  rs.segments[6].txt = iResponseTrailer1Error;
+  _SFCB_RETURN(rs);
+}
+
+static          RespSegments
+openEnumeration(CimRequestContext * ctx, RequestHdr * hdr)
+{
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "openEnumeration");
+  BinRequestContext *binCtx = hdr->binCtx;
+  int             type = binCtx->oHdr->type,
+                  irc,
+                  err = 0,
+                  i;
+  char           *errMsg = NULL,
+                 *xml,
+                 *msg;
+  long            maxTimeout;
+  EnumOpenParms   p;
+  EnumCtx         ec;
+  EnumCtxReq      req;
+  EnumCtxRsp      rsp;
+  struct sockaddr_un sun;
+  socklen_t       sl;
+  pid_t           pid;
+  RespSegments    rs;
+
+  memset(&ec, 0, sizeof(ec));
+  getOpenParms(binCtx->oHdr, &p);
+
+  if (getControlNum("pullOperationTimeout", &ec.timeout))
+    ec.timeout = 60;
+  if (getControlNum("pullMaxOperationTimeout", &maxTimeout))
+    maxTimeout = 600;
+  /* 0 can not be told apart from a missing OperationTimeout */
+  if (p.operationTimeout)
+    ec.timeout = p.operationTimeout;
+
+  if (p.flags & FL_continueOnError)
+    err = CIM_ERR_CONTINUATION_ON_ERROR_NOT_SUPPORTED;
+  else if (p.flags & FL_returnQueryResultClass &&
+           type == OPS_OpenQueryInstances) {
+    err = CMPI_RC_ERR_NOT_SUPPORTED;
+    errMsg = "ReturnQueryResultClass is not supported";
+  } else if (ec.timeout > maxTimeout)
+    err = CIM_ERR_INVALID_OPERATION_TIMEOUT;
+  else if (p.filterQuery) {
+    if (isPathsOpen(type))
+      err = CIM_ERR_FILTERED_ENUMERATION_NOT_SUPPORTED;
+    else if (p.filterQueryLang == NULL ||
+             (strcasecmp(p.filterQueryLang, "wql") &&
+              strcasecmp(p.filterQueryLang, "cql") &&
+              strcasecmp(p.filterQueryLang, "dmtf:cql")))
+      err = CMPI_RC_ERR_QUERY_LANGUAGE_NOT_SUPPORTED;
+    else {
+      ec.filter = parseQuery(MEM_NOT_TRACKED, p.filterQuery,
+                             p.filterQueryLang, NULL, NULL, &irc);
+      if (irc)
+        err = CMPI_RC_ERR_INVALID_QUERY;
+      else {
+        ec.filter->propSrc.getValue = queryGetValue;
+        ec.filter->propSrc.sns = ec.filter->sns;
+      }
+    }
+  }
+  if (err) {
+    if (ec.filter)
+      ec.filter->ft->release(ec.filter);
+    free(binCtx->bHdr);
+    _SFCB_RETURN(iMethodErrResponse(hdr, getErrSegment(err, errMsg)));
+  }
+
+  /* providers hand over their results chunk by chunk */
+  binCtx->bHdr->flags |= FL_chunked;
+  binCtx->chunkedMode = 1;
+  hdr->chunkedMode = 0;
+  binCtx->commHndl = ctx->commHndl;
+  binCtx->chunkFncs = ctx->chunkFncs;
+  binCtx->httpHost = ctx->host;
+  ec.binCtx = binCtx;
+  ec.principal = ctx->principal ? ctx->principal : "";
+  ec.xmlAs = isPathsOpen(type) ? XML_asInstPath :
+      type == OPS_OpenQueryInstances ? XML_asInst : XML_asInstWithPath;
+
+  _SFCB_TRACE(1, ("--- Getting Provider context"));
+  irc = getProviderContext(binCtx);
+  _SFCB_TRACE(1, ("--- Provider context gotten irc: %d", irc));
+  if (irc != MSG_X_PROVIDER) {
+    releaseProviderContext(binCtx);
+    free(binCtx->bHdr);
+    if (ec.filter)
+      ec.filter->ft->release(ec.filter);
+    _SFCB_RETURN(ctxErrResponse(hdr, binCtx, 0));
+  }
+
+  if ((ec.slot = claimHolderSlot()) < 0) {
+    releaseProviderContext(binCtx);
+    free(binCtx->bHdr);
+    if (ec.filter)
+      ec.filter->ft->release(ec.filter);
+    _SFCB_RETURN(iMethodErrResponse(hdr,
+                                    getErrSegment(CIM_ERR_SERVER_LIMITS_EXCEEDED,
+                                                  "Too many open enumeration contexts")));
+  }
+
+  ec.fd = socket(PF_UNIX, SOCK_STREAM, 0);
+  for (i = 0; ec.fd >= 0 && i < 8; i++) {
+    ec.id = newEnumCtxId();
+    sl = enumCtxAddr(ec.id, &sun);
+    if (bind(ec.fd, (struct sockaddr *) &sun, sl) == 0)
+      break;
+  }
+  pid = -1;
+  if (ec.fd >= 0 && i < 8 && listen(ec.fd, 8) == 0)
+    pid = fork();
+
+  if (pid == 0) {
+    /* let the client connection go with the request handler */
+    if (ctx->commHndl)
+      close(ctx->commHndl->socket);
+    /* and the listen sockets with the HTTP daemon */
+    for (i = 0; i < holderCloseCount; i++)
+      close(holderCloses[i]);
+    /* double fork, the request handler only waits for the first one */
+    if ((pid = fork()) == 0)
+      enumCtxHolder(&ec);
+    if (pid < 0)
+      freeHolderSlot(ec.slot);
+    _exit(0);
+  }
+  if (ec.fd >= 0)
+    close(ec.fd);
+  if (pid > 0)
+    waitpid(pid, NULL, 0);
+  else
+    freeHolderSlot(ec.slot);
+
+  req.op = type;
+  req.maxObjectCount = pullObjectCount(p.maxObjectCount);
+  if (pid < 0 || enumCtxRequest(ec.id, &req, ec.principal, &rsp, &xml,
+                                &msg)) {
+    mlogf(M_ERROR, M_SHOW, "--- unable to start enumeration context: %s\n",
+          strerror(errno));
+    rs = iMethodErrResponse(hdr, getErrSegment(CMPI_RC_ERR_FAILED,
+                                               "Unable to create enumeration context"));
+  } else
+    rs = enumCtxResponse(hdr, ec.id, &rsp, xml, msg);
+
+  /* the holder has its own hold on the providers by now */
+  releaseProviderContext(binCtx);
+  free(binCtx->bHdr);
+  if (ec.filter)
+    ec.filter->ft->release(ec.filter);
+  _SFCB_RETURN(rs);
+}
+
+static          RespSegments
+pullEnumeration(CimRequestContext * ctx, RequestHdr * hdr)
+{
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "pullEnumeration");
+  XtokPullInstances *pull = (XtokPullInstances *) hdr->binCtx->oHdr;
+  EnumCtxReq      req;
+  EnumCtxRsp      rsp;
+  char           *xml,
+                 *msg;
+  RespSegments    rs;
+
+  /* all Pull* requests share the XtokPullInstances layout */
+  req.op = pull->op.type;
+  req.maxObjectCount = pullObjectCount(pull->maxObjectCount);
+  if (pull->enumerationContext == 0 ||
+      enumCtxRequest(pull->enumerationContext, &req,
+                     ctx->principal ? ctx->principal : "", &rsp, &xml,
+                     &msg))
+    rs = iMethodErrResponse(hdr,
+                            getErrSegment
+                            (CIM_ERR_INVALID_ENUMERATION_CONTEXT, NULL));
+  else
+    rs = enumCtxResponse(hdr, pull->enumerationContext, &rsp, xml, msg);
+
+  free(hdr->binCtx->bHdr);
+  _SFCB_RETURN(rs);
+}
+
+static          RespSegments
+closeEnumeration(CimRequestContext * ctx, RequestHdr * hdr)
+{
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "closeEnumeration");
+  XtokCloseEnumeration *cls = (XtokCloseEnumeration *) hdr->binCtx->oHdr;
+  EnumCtxReq      req = { OPS_CloseEnumeration, 0, 0 };
+  EnumCtxRsp      rsp;
+  char           *xml,
+                 *msg;
+  RespSegments    rs = { NULL, 0, 0, NULL,
+    {{0, iResponseIntro1},
+     {0, hdr->id},
+     {0, iResponseIntro2},
+     {0, hdr->iMethod},
+     {0, iResponseIntro3Error},
+     {0, NULL},
+     {0, iResponseTrailer1Error}}
+  };
+
+  if (cls->enumerationContext == 0 ||
+      enumCtxRequest(cls->enumerationContext, &req,
+                     ctx->principal ? ctx->principal : "", &rsp, &xml,
+                     &msg))
+    rs = iMethodErrResponse(hdr,
+                            getErrSegment
+                            (CIM_ERR_INVALID_ENUMERATION_CONTEXT, NULL));
+  else {
+    if (rsp.rc)
+      rs = iMethodErrResponse(hdr, getErrSegment(rsp.rc, msg));
+    free(xml);
+    free(msg);
+  }
+
+  free(hdr->binCtx->bHdr);
+  _SFCB_RETURN(rs);
+}
+
+static          RespSegments
+enumerationCount(CimRequestContext * ctx, RequestHdr * hdr)
+{
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "enumerationCount");
+  XtokEnumerationCount *count = (XtokEnumerationCount *) hdr->binCtx->oHdr;
+  EnumCtxReq      req = { OPS_EnumerationCount, 0, 0 };
+  EnumCtxRsp      rsp;
+  char           *xml,
+                 *msg,
+                  n[32];
+  UtilStringBuffer *sb;
+  RespSegments    rs;
+
+  if (count->enumerationContext == 0 ||
+      enumCtxRequest(count->enumerationContext, &req,
+                     ctx->principal ? ctx->principal : "", &rsp, &xml,
+                     &msg))
+    rs = iMethodErrResponse(hdr,
+                            getErrSegment
+                            (CIM_ERR_INVALID_ENUMERATION_CONTEXT, NULL));
+  else if (rsp.rc)
+    rs = iMethodErrResponse(hdr, getErrSegment(rsp.rc, msg));
+  else {
+    sb = UtilFactory->newStrinBuffer(64);
+    if (rsp.countKnown) {
+      snprintf(n, sizeof(n), "%lu", rsp.count);
+      SFCB_APPENDCHARS_BLOCK(sb, "<VALUE>");
+      sb->ft->appendChars(sb, n);
+      SFCB_APPENDCHARS_BLOCK(sb, "</VALUE>\n");
+    }
+    rs = iMethodResponse(hdr, sb);
+  }
+  if (xml)
+    free(xml);
+  if (msg)
+    free(msg);
+
+  free(hdr->binCtx->bHdr);
+  _SFCB_RETURN(rs);
+}
+
 static          RespSegments
 notSupported(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
 {
@@ -1763,32 +2760,18 @@ static Handler  handlers[] = {
   {NULL}, 
   {NULL}, 
   {NULL}, 
-  // TODO Create handlers for new OPS codes...
-//{openEnumerateInstancePaths}, // OPS_OpenEnumerateInstancePaths 32
-//{openEnumerateInstances},     // OPS_OpenEnumerateInstances 33
-//{openAssociatorInstancePaths},// OPS_OpenAssociatorInstancePaths 34
-//{openAssociatorInstances},    // OPS_OpenAssociatorInstances 36
-//{openReferenceInstancePaths}, // OPS_OpenReferenceInstancePaths 36
-//{openReferenceInstances},     // OPS_OpenReferenceInstances 37
-//{openQueryInstances},         // OPS_OpenQueryInstances 38
-//{pullInstances},              // OPS_PullInstances 39
-//{pullInstancesWithPath},      // OPS_PullInstancesWithPath 40
-//{pullInstancePaths},          // OPS_PullInstancePaths 41
-//{closeEnumeration},           // OPS_CloseEnumeration 42
-//{enumerationCount},           // OPS_EnumerationCount 43
-  // In the meantime set to notSupported or hack to call the legacy OP...
-  {enumInstanceNames},          // OPS_OpenEnumerateInstancePaths 32
-  {enumInstances},              // OPS_OpenEnumerateInstances 33
-  {associatorNames},            // OPS_OpenAssociatorInstancePaths 34
-  {associators},                // OPS_OpenAssociatorInstances 36
-  {referenceNames},             // OPS_OpenReferenceInstancePaths 36
-  {references},                 // OPS_OpenReferenceInstances 37
-  {execQuery},                  // OPS_OpenQueryInstances 38
-  {notSupported},               // OPS_PullInstances 39
-  {notSupported},               // OPS_PullInstancesWithPath 40
-  {notSupported},               // OPS_PullInstancePaths 41
-  {notSupported},               // OPS_CloseEnumeration 42
-  {notSupported}                // OPS_EnumerationCount 43
+  {openEnumeration},            // OPS_OpenEnumerateInstancePaths 32
+  {openEnumeration},            // OPS_OpenEnumerateInstances 33
+  {openEnumeration},            // OPS_OpenAssociatorInstancePaths 34
+  {openEnumeration},            // OPS_OpenAssociatorInstances 35
+  {openEnumeration},            // OPS_OpenReferenceInstancePaths 36
+  {openEnumeration},            // OPS_OpenReferenceInstances 37
+  {openEnumeration},            // OPS_OpenQueryInstances 38
+  {pullEnumeration},            // OPS_PullInstances 39
+  {pullEnumeration},            // OPS_PullInstancesWithPath 40
+  {pullEnumeration},            // OPS_PullInstancePaths 41
+  {closeEnumeration},           // OPS_CloseEnumeration 42
+  {enumerationCount}            // OPS_EnumerationCount 43
 };
 
 RespSegments sendHdrToHandler(RequestHdr* hdr, CimRequestContext* ctx) {
@@ -1930,7 +2913,7 @@ int
 cleanupCimXmlRequest(RespSegments * rs)
 {
   XmlBuffer *xmb = (XmlBuffer *)rs->buffer;
-  free(xmb->base);
+  /* xmb->base is the request buffer, owned by the caller */
   free(xmb);
   return 0;
 }
@@ -89,6 +89,8 @@ typedef struct requestHdr {
 
 extern RespSegments handleCimRequest(CimRequestContext * ctx, int flags, char *more);
 extern int      cleanupCimXmlRequest(RespSegments * rs);
+extern void     initEnumCtxHolders(int *listenFds, int n);
+extern void     stopEnumCtxHolders();
 
 #ifdef ALLOW_UPDATE_EXPIRED_PW
   #define HCR_EXPIRED_PW 1  /* flag: expired user tries to auth */
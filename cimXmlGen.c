@@ -66,6 +66,88 @@ const char     *opGetClassNameChars(CMPIObjectPath * cop);
   data2xml((data),(name),(refname),(btag),sizeof(btag)-1,(etag), \
 	   sizeof(etag)-1,(sb),(qsb),(inst),(param),0)
 
+/*
+ * characters escaped in XML text, and their replacement 
+ */
+static const struct xmlEscape {
+  const char     *rep;
+  int             len;
+} xmlEscapes[256] = {
+  ['>'] = {"&gt;", 4},
+  ['<'] = {"&lt;", 4},
+  ['&'] = {"&amp;", 5},
+  ['"'] = {"&quot;", 6},
+  ['\''] = {"&apos;", 6},
+};
+
+static const char xmlSpecials[] = "<>&\"'";
+
+/*
+ * length of the CDATA section at p, which is copied unescaped, or 0 
+ */
+static int
+cdataLength(const char *p)
+{
+  const char     *end;
+
+  if (p[1] == '!' && strnlen(p, 12) > 11 && strncmp(p, "<![CDATA[", 9) == 0
+      && (end = strstr(p, "]]>")))
+    return (end - p) + 3;
+  return 0;
+}
+
+/*
+ * escapes in into out or sb, or just counts if both are NULL; runs of
+ * plain characters are found with strcspn() and copied in one go 
+ */
+static int
+escapeXML(const char *in, char *out, UtilStringBuffer * sb)
+{
+  const char     *rep;
+  int             o = 0,
+      n;
+
+  for (;;) {
+    n = strcspn(in, xmlSpecials);
+    if (n) {
+      if (out)
+        memcpy(out + o, in, n);
+      else if (sb)
+        sb->ft->appendBlock(sb, (char *) in, n);
+      o += n;
+      in += n;
+    }
+    if (*in == 0)
+      break;
+
+    if (*in == '<' && (n = cdataLength(in)) != 0) {
+      rep = in;
+      in += n;
+    } else {
+      rep = xmlEscapes[(unsigned char) *in].rep;
+      n = xmlEscapes[(unsigned char) *in].len;
+      in++;
+    }
+    if (out)
+      memcpy(out + o, rep, n);
+    else if (sb)
+      sb->ft->appendBlock(sb, (char *) rep, n);
+    o += n;
+  }
+  return o;
+}
+
+/*
+ * appends in to sb escaped, without an intermediate copy 
+ */
+int
+string2xml(const char *in, UtilStringBuffer * sb)
+{
+  if (in == NULL)
+    return 0;
+  return escapeXML(in, NULL, sb);
+}
+
 static int add_escaped_instance(UtilStringBuffer *sb, CMPIInstance *inst)
 {
   UtilStringBuffer *instance;
@@ -77,9 +159,7 @@ static int add_escaped_instance(UtilStringBuffer *sb, CMPIInstance *inst)
     _SFCB_RETURN(1);
 
   instance2xml(inst, instance, 0);
-  char *escaped = XMLEscape((char *) instance->ft->getCharPtr(instance), NULL);
-  sb->ft->appendChars(sb, escaped);
-  free(escaped);
+  string2xml(instance->ft->getCharPtr(instance), sb);
   instance->ft->release(instance);
   _SFCB_RETURN(0);
 }
@@ -87,68 +167,16 @@ static int add_escaped_instance(UtilStringBuffer *sb, CMPIInstance *inst)
 char           *
 XMLEscape(char *in, int *outlen)
 {
-  int             i,
-                  l,
-                  o,
-                  n;
-  char           *out, *end;
-  char           *rep;
+  char           *out;
+  int             o;
 
   _SFCB_ENTER(TRACE_CIMXMLPROC, "XMLEscape");
 
   if (in == NULL)
     return (NULL);
-  l = strlen(in);
-  out = malloc((l * 6) + 1);
-  o = 0;
-
-  for (i = 0; i < l; i++) {
-    char            ch = in[i];
-    switch (ch) {
-    case '>':
-      n = 4;
-      rep = "&gt;";
-      break;
-    case '<':
-
-      /* skip escaping if this is a CDATA section */
-      if ((in[i+1] == '!') && ((l-i) > 11)) {   /* do minimum check, then check if enough chars to compare */
-        rep = &in[i];
-        if (!strncmp(rep, "<![CDATA[", 9)) {   /* now look for the cdata start marker */
-          if ((end = strstr(rep, "]]>"))) {   /* valid cdata should have end marker */
-            n = ((end-rep)+3);
-            i += (n - 1);
-            break;
-          } /* else, bad format */
-        }
-      }
-
-      n = 4;
-      rep = "&lt;";
-      break;
-    case '&':
-      n = 5;
-      rep = "&amp;";
-      break;
-    case '"':
-      n = 6;
-      rep = "&quot;";
-      break;
-    case '\'':
-      n = 6;
-      rep = "&apos;";
-      break;
-    default:
-      /*
-       * avoid memcopy 
-       */
-      out[o] = ch;
-      o += 1;
-      continue;
-    }
-    memcpy(out + o, rep, n);
-    o += n;
-  }
+  o = escapeXML(in, NULL, NULL);
+  out = malloc(o + 1);
+  escapeXML(in, out, NULL);
   out[o] = '\0';
   if (outlen)
     *outlen = o;
@@ -533,7 +561,6 @@ value2xml(CMPIData d, UtilStringBuffer * sb, int wv)
   char            str[256];
   char           *sp = str;
   int             splen = 0;
-  int             freesp = 0;
 
   if (d.type & CMPI_ARRAY) {
     sb->ft->appendChars(sb, "**[]**");
@@ -595,13 +622,11 @@ value2xml(CMPIData d, UtilStringBuffer * sb, int wv)
       /* To support wide charset/unicode charset, review this line */
       splen = sprintf(str, "%c", (CMPIChar16)d.value.char16);
     else if (d.type == CMPI_chars) {
-      sp = XMLEscape(d.value.chars, &splen);
-      if (sp)
-        freesp = 1;
+      string2xml(d.value.chars, sb);
+      splen = 0;
     } else if (d.type == CMPI_string) {
-      sp = XMLEscape((char *) d.value.string->hdl, &splen);
-      if (sp)
-        freesp = 1;
+      string2xml((char *) d.value.string->hdl, sb);
+      splen = 0;
     } else if (d.type == CMPI_dateTime) {
       if (d.value.dateTime) {
         CMPIString     *sdf = CMGetStringFormat(d.value.dateTime, NULL);
@@ -627,8 +652,6 @@ value2xml(CMPIData d, UtilStringBuffer * sb, int wv)
     if (wv)
       SFCB_APPENDCHARS_BLOCK(sb, "</VALUE>\n");
   }
-  if (freesp)
-    free(sp);
   return 0;
 }
 
@@ -1076,15 +1099,169 @@ cls2xml(CMPIConstClass * cls, UtilStringBuffer * sb, unsigned int flags)
   _SFCB_RETURN(0);
 }
 
-int
-instance2xml(CMPIInstance *ci, UtilStringBuffer * sb, unsigned int flags)
+/*
+ * PROPERTY start tags kept across the instances of an enumeration, by
+ * property position; an entry is reused if name and type still match
+ */
+typedef struct propertyTag {
+  char           *name;
+  CMPIType        type;
+  char           *tag;
+  int             len;
+} PropertyTag;
+
+typedef struct instXmlCache {
+  int             max;
+  PropertyTag    *tags;
+} InstXmlCache;
+
+static void
+releaseInstXmlCache(InstXmlCache * cache)
+{
+  int             i;
+
+  for (i = 0; i < cache->max; i++) {
+    free(cache->tags[i].name);
+    free(cache->tags[i].tag);
+  }
+  free(cache->tags);
+}
+
+/*
+ * properties written straight from the ClInstance: scalars and arrays
+ * of strings, numbers, booleans and char16 
+ */
+static int
+isPlainProperty(CMPIType type)
+{
+  switch (type & ~CMPI_ARRAY) {
+  case CMPI_chars:
+  case CMPI_boolean:
+  case CMPI_char16:
+  case CMPI_real32:
+  case CMPI_real64:
+  case CMPI_uint8:
+  case CMPI_sint8:
+  case CMPI_uint16:
+  case CMPI_sint16:
+  case CMPI_uint32:
+  case CMPI_sint32:
+  case CMPI_uint64:
+  case CMPI_sint64:
+    return 1;
+  case CMPI_string:
+    return (type & CMPI_ARRAY) != 0;
+  }
+  return 0;
+}
+
+static void
+propertyTag2xml(const char *name, CMPIType type, int i,
+                UtilStringBuffer * sb, InstXmlCache * cache)
+{
+  PropertyTag    *t;
+  UtilStringBuffer *tsb;
+
+  if (cache && i < cache->max) {
+    t = cache->tags + i;
+    if (t->tag && t->type == type && strcmp(t->name, name) == 0) {
+      sb->ft->appendBlock(sb, t->tag, t->len);
+      return;
+    }
+  }
+
+  tsb = cache ? UtilFactory->newStrinBuffer(64) : sb;
+  if (type & CMPI_ARRAY)
+    SFCB_APPENDCHARS_BLOCK(tsb, "<PROPERTY.ARRAY NAME=\"");
+  else
+    SFCB_APPENDCHARS_BLOCK(tsb, "<PROPERTY NAME=\"");
+  tsb->ft->appendChars(tsb, name);
+  SFCB_APPENDCHARS_BLOCK(tsb, "\" TYPE=\"");
+  tsb->ft->appendChars(tsb, dataType(type));
+  SFCB_APPENDCHARS_BLOCK(tsb, "\">\n");
+  if (cache == NULL)
+    return;
+
+  if (i >= cache->max) {
+    int             max = cache->max ? cache->max : 16;
+    for (; max <= i; max *= 2);
+    cache->tags = realloc(cache->tags, max * sizeof(*cache->tags));
+    memset(cache->tags + cache->max, 0,
+           (max - cache->max) * sizeof(*cache->tags));
+    cache->max = max;
+  }
+  t = cache->tags + i;
+  free(t->name);
+  free(t->tag);
+  t->name = strdup(name);
+  t->type = type;
+  t->len = tsb->ft->getSize(tsb);
+  t->tag = strdup(tsb->ft->getCharPtr(tsb));
+  tsb->ft->release(tsb);
+  sb->ft->appendBlock(sb, t->tag, t->len);
+}
+
+/*
+ * writes a plain property reading the ClInstance in place, without
+ * creating CMPIString or CMPIArray objects; same output as data2xml() 
+ */
+static void
+plainProperty2xml(ClInstance * inst, ClProperty * p, int i,
+                  UtilStringBuffer * sb, InstXmlCache * cache)
+{
+  CMPIData        d = p->data,
+      e;
+  const CMPIData *av;
+  int             j,
+                  ac;
+
+  propertyTag2xml(ClObjectGetClString(&inst->hdr, &p->id), d.type, i, sb,
+                  cache);
+
+  if (d.state == 0) {
+    if (d.type & CMPI_ARRAY) {
+      av = ClObjectGetClArray(&inst->hdr, (ClArray *) & d.value.array);
+      ac = av ? av->value.sint32 : 0;
+      SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.ARRAY>\n");
+      for (j = 0; j < ac; j++) {
+        e = av[j + 1];
+        if (e.state == CMPI_nullValue)
+          continue;
+        if (e.type == CMPI_string || e.type == CMPI_chars) {
+          e.value.chars = (char *) ClObjectGetClString(&inst->hdr,
+                                                       (ClString *) &
+                                                       e.value.chars);
+          e.type = CMPI_chars;
+        }
+        e.state = 0;
+        value2xml(e, sb, 1);
+      }
+      SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.ARRAY>\n");
+    } else {
+      if (d.type == CMPI_chars)
+        d.value.chars = (char *) ClObjectGetClString(&inst->hdr,
+                                                     (ClString *) &
+                                                     d.value.chars);
+      value2xml(d, sb, 1);
+    }
+  }
+
+  if (d.type & CMPI_ARRAY)
+    SFCB_APPENDCHARS_BLOCK(sb, "</PROPERTY.ARRAY>\n");
+  else
+    SFCB_APPENDCHARS_BLOCK(sb, "</PROPERTY>\n");
+}
+
+static int
+cachedInstance2xml(CMPIInstance *ci, UtilStringBuffer * sb,
+                   unsigned int flags, InstXmlCache * cache)
 {
   ClInstance     *inst = (ClInstance *) ci->hdl;
+  ClProperty     *props;
   int             i,
                   m = ClInstanceGetPropertyCount(inst),
                   embInst = 0;
   char           *type;
-  UtilStringBuffer *qsb = UtilFactory->newStrinBuffer(1024);
   unsigned long   quals;
 
   _SFCB_ENTER(TRACE_CIMXMLPROC, "instance2xml");
@@ -1096,13 +1273,17 @@ instance2xml(CMPIInstance *ci, UtilStringBuffer * sb, unsigned int flags)
   if (flags & FL_includeQualifiers)
     quals2xml(inst->quals, sb);
 
+  props = (ClProperty *) ClObjectGetClSection(&inst->hdr, &inst->properties);
   for (i = 0; i < m; i++) {
     CMPIString      name;
     CMPIData        data;
-    qsb->ft->reset(qsb);
     if (ClInstanceIsPropertyAtFiltered(inst, i)) {
       continue;
     }
+    if (isPlainProperty(props[i].data.type)) {
+      plainProperty2xml(inst, props + i, i, sb, cache);
+      continue;
+    }
     data =
       __ift_internal_getPropertyAt(ci, i, (char **) &name.hdl, NULL, 1, &quals);
 
@@ -1112,12 +1293,12 @@ instance2xml(CMPIInstance *ci, UtilStringBuffer * sb, unsigned int flags)
 
     if (data.type & CMPI_ARRAY) {
       EMBDATA2XML(&data,&name,NULL,"<PROPERTY.ARRAY NAME=\"", "</PROPERTY.ARRAY>\n",
-                  sb, qsb, 1, 0, embInst);
+                  sb, NULL, 1, 0, embInst);
     } else {
       type = dataType(data.type);
       if (*type == '*')  EMBDATA2XML(&data,&name,NULL,"<PROPERTY.REFERENCE NAME=\"",
-                                     "</PROPERTY.REFERENCE>\n", sb, qsb, 1,0, embInst);
-      else EMBDATA2XML(&data,&name,NULL,"<PROPERTY NAME=\"", "</PROPERTY>\n", sb, qsb, 1,0, embInst);
+                                     "</PROPERTY.REFERENCE>\n", sb, NULL, 1,0, embInst);
+      else EMBDATA2XML(&data,&name,NULL,"<PROPERTY NAME=\"", "</PROPERTY>\n", sb, NULL, 1,0, embInst);
     }
 
     if (data.type & (CMPI_ENC | CMPI_ARRAY)) {  // don't get confused
@@ -1129,11 +1310,15 @@ instance2xml(CMPIInstance *ci, UtilStringBuffer * sb, unsigned int flags)
   }
   SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCE>\n");
 
-  qsb->ft->release(qsb);
-
   _SFCB_RETURN(0);
 }
 
+int
+instance2xml(CMPIInstance *ci, UtilStringBuffer * sb, unsigned int flags)
+{
+  return cachedInstance2xml(ci, sb, flags, NULL);
+}
+
 int
 args2xml(CMPIArgs * args, UtilStringBuffer * sb)
 {
@@ -1214,6 +1399,7 @@ enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb, CMPIType type,
   CMPIObjectPath *cop;
   CMPIInstance   *ci;
   CMPIConstClass *cl;
+  InstXmlCache    cache = { 0, NULL };
 
   _SFCB_ENTER(TRACE_CIMXMLPROC, "enum2xml");
 
@@ -1229,6 +1415,11 @@ enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb, CMPIType type,
         instanceName2xml(cop, sb);
         SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
         SFCB_APPENDCHARS_BLOCK(sb, "</OBJECTPATH>\n");
+      } else if (xmlAs == XML_asInstPath) {
+        SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
+        nsPath2xml(cop, sb, httpHost);
+        instanceName2xml(cop, sb);
+        SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
       } else
         instanceName2xml(cop, sb);
     } else if (type == CMPI_class) {
@@ -1236,7 +1427,22 @@ enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb, CMPIType type,
       cls2xml(cl, sb, flags);
     } else if (type == CMPI_instance) {
       ci = CMGetNext(enm, NULL).value.inst;
+      if (xmlAs == XML_asInst) {
+        cachedInstance2xml(ci, sb, flags, &cache);
+        continue;
+      }
       cop = CMGetObjectPath(ci, NULL);
+      if (xmlAs == XML_asInstWithPath) {
+        SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.INSTANCEWITHPATH>\n");
+        SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
+        nsPath2xml(cop, sb, httpHost);
+        instanceName2xml(cop, sb);
+        SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
+        cachedInstance2xml(ci, sb, flags, &cache);
+        SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.INSTANCEWITHPATH>\n");
+        cop->ft->release(cop);
+        continue;
+      }
       if (xmlAs == XML_asObj) {
         SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.OBJECTWITHPATH>\n");
         SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
@@ -1246,7 +1452,7 @@ enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb, CMPIType type,
       instanceName2xml(cop, sb);
       if (xmlAs == XML_asObj)
         SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
-      instance2xml(ci, sb, flags);
+      cachedInstance2xml(ci, sb, flags, &cache);
       if (xmlAs == XML_asObj)
         SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.OBJECTWITHPATH>\n");
       else
@@ -1255,6 +1461,8 @@ enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb, CMPIType type,
     }
   }
 
+  releaseInstXmlCache(&cache);
+
   _SFCB_RETURN(0);
 }
 
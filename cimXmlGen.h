@@ -58,6 +58,7 @@ extern CMPIValue union2CMPIValue(CMPIType type, char *val,
 extern int      qualifierDeclaration2xml(CMPIQualifierDecl * q,
                                          UtilStringBuffer * sb);
 extern char    *XMLEscape(char *in, int *outlen);
+extern int      string2xml(const char *in, UtilStringBuffer * sb);
 extern void     data2xml(CMPIData *data, CMPIString *name,
                          CMPIString *refName, char *bTag, int bTagLen,
                          char *eTag, int eTagLen, UtilStringBuffer * sb,
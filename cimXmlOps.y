@@ -877,6 +877,12 @@ buildExecQueryRequest(void *parm)
   XtokExecQuery  *req = (XtokExecQuery *) hdr->cimRequest;
   hdr->className = req->op.className.data;
 
+  if (req->op.query.data == NULL || req->op.queryLang.data == NULL) {
+    hdr->rc = CMPI_RC_ERR_INVALID_PARAMETER;
+    hdr->errMsg = strdup("query and query language are required.");
+    return;
+  }
+
   qs = parseQuery(MEM_TRACKED, (char *) req->op.query.data,
                   (char *) req->op.queryLang.data, NULL, NULL, &irc);
 
@@ -4673,6 +4679,11 @@ openEnumInstancePaths
        $$.op.className=setCharsMsgSegment(NULL);
        $$.flags=0;
 
+       $$.operationTimeout = 0;
+       $$.maxObjectCount = 0;
+       $$.filterQuery = NULL;
+       $$.filterQueryLang = NULL;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildEnumInstanceNamesRequest(parm);   // TODO
     }
@@ -4786,6 +4797,11 @@ openEnumInstances
        $$.propertyList.values = NULL;
        $$.properties=0;
 
+       $$.operationTimeout = 0;
+       $$.maxObjectCount = 0;
+       $$.filterQuery = NULL;
+       $$.filterQueryLang = NULL;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildOpenEnumInstanceRequest(parm);
     }
@@ -4963,6 +4979,12 @@ openAssociatorInstancePaths
        // TODO what initialization needs to be done here?
        //$$.flags = FL_localOnly | FL_deepInheritance;
 
+       $$.flags = 0;
+       $$.operationTimeout = 0;
+       $$.maxObjectCount = 0;
+       $$.filterQuery = NULL;
+       $$.filterQueryLang = NULL;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildAssociatorNamesRequest(parm);  // TODO
     }
@@ -5138,6 +5160,11 @@ openAssociatorInstances
        $$.propertyList.values = 0;
        $$.properties=0;
 
+       $$.operationTimeout = 0;
+       $$.maxObjectCount = 0;
+       $$.filterQuery = NULL;
+       $$.filterQueryLang = NULL;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildAssociatorsRequest(parm);  // TODO
     }
@@ -5350,6 +5377,12 @@ openReferenceInstancePaths
        // TODO what initialization needs to be done here?
        //$$.flags = FL_localOnly | FL_deepInheritance;
 
+       $$.flags = 0;
+       $$.operationTimeout = 0;
+       $$.maxObjectCount = 0;
+       $$.filterQuery = NULL;
+       $$.filterQueryLang = NULL;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildReferenceNamesRequest(parm);  // TODO
     }
@@ -5499,6 +5532,11 @@ openReferenceInstances
        $$.propertyList.values = 0;
        $$.properties=0;
 
+       $$.operationTimeout = 0;
+       $$.maxObjectCount = 0;
+       $$.filterQuery = NULL;
+       $$.filterQueryLang = NULL;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildReferencesRequest(parm);  // TODO
     }
@@ -5682,6 +5720,14 @@ openQueryInstances
        $$.op.nameSpace=setCharsMsgSegment($1);
        $$.op.className=setCharsMsgSegment(NULL);
 
+       $$.flags = 0;
+       $$.operationTimeout = 0;
+       $$.maxObjectCount = 0;
+       $$.filterQuery = NULL;
+       $$.filterQueryLang = NULL;
+       $$.op.query=setCharsMsgSegment(NULL);
+       $$.op.queryLang=setCharsMsgSegment(NULL);
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildExecQueryRequest(parm);  // TODO
     }
@@ -5796,6 +5842,9 @@ pullInstances
        $$.op.nameSpace=setCharsMsgSegment($1);
        $$.op.className=setCharsMsgSegment(NULL);
 
+       $$.maxObjectCount = 0;
+       $$.enumerationContext = 0;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
        buildPullInstancesRequest(parm);
     }
@@ -5860,6 +5909,9 @@ pullInstancesWithPath
        $$.op.nameSpace=setCharsMsgSegment($1);
        $$.op.className=setCharsMsgSegment(NULL);
 
+       $$.maxObjectCount = 0;
+       $$.enumerationContext = 0;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
 //     buildPullInstancePathsRequest(parm);
        buildPullInstancesRequest(parm); // TODO  Or maybe this is acceptable...
@@ -5922,10 +5974,13 @@ pullInstancePaths
     : localNameSpacePath
     {
        $$.op.count = EI_REQ_REG_SEGMENTS;  // TODO
-       $$.op.type = OPS_PullInstances;
+       $$.op.type = OPS_PullInstancePaths;
        $$.op.nameSpace=setCharsMsgSegment($1);
        $$.op.className=setCharsMsgSegment(NULL);
 
+       $$.maxObjectCount = 0;
+       $$.enumerationContext = 0;
+
        setRequest(parm,&$$,sizeof($$),$$.op.type);
 //     buildPullInstancePathsRequest(parm);
        buildPullInstancesRequest(parm); // TODO  Or maybe this is acceptable...
@@ -5933,7 +5988,7 @@ pullInstancePaths
     | localNameSpacePath pullInstancePathsParmsList
     {
        $$.op.count = EI_REQ_REG_SEGMENTS;
-       $$.op.type = OPS_PullInstances;
+       $$.op.type = OPS_PullInstancePaths;
        $$.op.nameSpace=setCharsMsgSegment($1);
        $$.op.className=setCharsMsgSegment(NULL);
        $$.maxObjectCount=$2.maxObjectCount;
@@ -6019,7 +6074,10 @@ enumerationCount
 enumerationContext
     : XTOK_VALUE ZTOK_VALUE
     {
-    $$=atol($1.value); // TODO need some checking here
+    char *end;
+    $$=strtoull($1.value,&end,10);
+    if (end==$1.value || *end)
+      $$=0;      /* never handed out, rejected as invalid context */
     }
 ;
 
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <cmpi/cmpidt.h>
 
 #include "cimXmlParser.h"
@@ -51,11 +52,15 @@ Throw(XmlBuffer __attribute__ ((unused)) *xb, char *msg)
   exit(1);
 }
 
+/*
+ * the request is parsed in place, the tokens point into it; s has to
+ * stay around until the request is cleaned up
+ */
 static XmlBuffer *
 newXmlBuffer(char *s)
 {
   XmlBuffer      *xb = malloc(sizeof(*xb));
-  xb->base = xb->cur = (char *) strdup(s);
+  xb->base = xb->cur = s;
   xb->last = xb->cur + strlen(xb->cur);
   xb->nulledChar = 0;
   xb->eTagFound = 0;
@@ -109,30 +114,14 @@ nextTag(XmlBuffer * xb)
   return NULL;
 }
 
-/*
- * compares two strings return 1: n begins with t and following char is
- * alphanumeric return 0: otherwise 
- */
-static int
-nextEquals(const char *n, const char *t)
-{
-  int             l = strlen(t);
-  if (strncmp(n, t, l) == 0) {
-    if (!isalnum(*(n + l))) {
-      return 1;
-    }
-  }
-  return 0;
-}
-
 /*
  * scan until we find the end of the tag ('>') 
  */
 static char
 skipTag(XmlBuffer * xb)
 {
-  while (*xb->cur != '>' && xb->last > xb->cur)
-    xb->cur++;
+  char           *gt = memchr(xb->cur, '>', xb->last - xb->cur);
+  xb->cur = gt ? gt : xb->last;
   xb->cur++;
   return *xb->cur;
 }
@@ -420,9 +409,11 @@ getContent(XmlBuffer * xb)
     return NULL;
 
   /*
-   * scan through until we hit an '<' or end of buffer
+   * scan through until we hit an '<' or end of buffer; memchr() looks at
+   * a word or vector at a time, which pays off for long values
    */
-  for (; *xb->cur != '<' && xb->cur < xb->last; xb->cur++);
+  help = memchr(xb->cur, '<', xb->last - xb->cur);
+  xb->cur = help ? help : xb->last;
 
   /*
    * store the char we found, set it to null to use as a marker in the
@@ -454,10 +445,8 @@ getContent(XmlBuffer * xb)
    * unescape 
    */
   help = start;
-  while (help < end) {
-    if (*help == '&') {
-      end -= xmlUnescape(help, end);
-    }
+  while (help < end && (help = memchr(help, '&', end - help)) != NULL) {
+    end -= xmlUnescape(help, end);
     help += 1;
   }
   return start;
@@ -1634,13 +1623,64 @@ static Tags     tags[] = {
   {"", procCdata, ZTOK_CDATA},
 };
 
+/*
+ * tags[] chained by first character, in table order, so that a tag is
+ * compared only against the few entries that can match; built once on
+ * first use
+ */
+static signed char tagFirst[256];
+static signed char tagChain[sizeof(tags) / sizeof(Tags)];
+static unsigned char tagLen[sizeof(tags) / sizeof(Tags)];
+static Tags    *cdataTag;
+static pthread_once_t tagIndexOnce = PTHREAD_ONCE_INIT;
+
+static void
+buildTagIndex(void)
+{
+  int             i,
+                  m = sizeof(tags) / sizeof(Tags);
+  signed char    *last[256];
+
+  for (i = 0; i < 256; i++) {
+    tagFirst[i] = -1;
+    last[i] = tagFirst + i;
+  }
+  for (i = 0; i < m; i++) {
+    unsigned char   c = *tags[i].tag;
+    if (c == 0) {
+      cdataTag = tags + i;
+      continue;
+    }
+    tagLen[i] = strlen(tags[i].tag);
+    tagChain[i] = -1;
+    *last[c] = i;
+    last[c] = tagChain + i;
+  }
+}
+
+/*
+ * returns the first tags[] entry next begins with, followed by a
+ * non-alphanumeric character, or NULL
+ */
+static Tags    *
+findTag(const char *next)
+{
+  int             i;
+
+  pthread_once(&tagIndexOnce, buildTagIndex);
+  for (i = tagFirst[(unsigned char) *next]; i >= 0; i = tagChain[i])
+    if (strncmp(next, tags[i].tag, tagLen[i]) == 0 &&
+        !isalnum(next[tagLen[i]]))
+      return tags + i;
+  return isalnum(*next) ? NULL : cdataTag;
+}
+
 int
 yylex(YYSTYPE * lvalp, ParserControl * parm)
 {
-  int             i,
-                  m,
-                  rc;
+  int             rc;
   char           *next;
+  Tags           *t;
 
   _SFCB_ENTER(TRACE_XMLPARSING, "yylex");
 
@@ -1665,11 +1705,9 @@ yylex(YYSTYPE * lvalp, ParserControl * parm)
      * matching opening tag 
      */
     if (*next == '/') {
-      for (i = 0, m = sizeof(tags) / sizeof(Tags); i < m; i++) {
-        if (nextEquals(next + 1, tags[i].tag) == 1) {
-          skipTag(parm->xmb);
-          _SFCB_RETURN(tags[i].etag);
-        }
+      if ((t = findTag(next + 1)) != NULL) {
+        skipTag(parm->xmb);
+        _SFCB_RETURN(t->etag);
       }
     }
 
@@ -1681,14 +1719,12 @@ yylex(YYSTYPE * lvalp, ParserControl * parm)
         parm->xmb->cur = strstr(parm->xmb->cur, "-->") + 3;
         continue;
       }
-      for (i = 0, m = sizeof(tags) / sizeof(Tags); i < m; i++) {
-        if (nextEquals(next, tags[i].tag) == 1) {
+      if ((t = findTag(next)) != NULL) {
 
-          // fprintf(stderr, " yylex| processing for: %.10s\n", next);
-          rc = tags[i].process(lvalp, parm);    /* call a procXXX fn based 
-                                                 * on tag name */
-          _SFCB_RETURN(rc);
-        }
+        // fprintf(stderr, " yylex| processing for: %.10s\n", next);
+        rc = t->process(lvalp, parm);   /* call a procXXX fn based on tag
+                                         * name */
+        _SFCB_RETURN(rc);
       }
     }
     break;
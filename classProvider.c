@@ -19,6 +19,7 @@
  */
 
 #include "classProviderCommon.h"
+#include "classTree.h"
 
 #define LOCALCLASSNAME "ClassProvider"
 
@@ -55,6 +56,7 @@ struct _Class_Register_FT {
 };
 
 extern Class_Register_FT *ClassRegisterFT;
+extern void     bumpProvGeneration();
 
 static CMPIConstClass *getClass(ClassRegister * cr, const char *clsName);
 int             traverseChildren(ClassRegister * cReg, const char *parent,
@@ -91,6 +93,38 @@ buildInheritanceTable(ClassRegister * cr)
   }
 }
 
+/*
+ * lets every process answer ISA questions for this namespace locally
+ */
+static void
+publishClassTree(ClassRegister * cr)
+{
+  ClassBase      *cb = (ClassBase *) cr->hdl;
+  UtilHashTable  *ct = cb->ht;
+  HashTableIterator *i;
+  ClTreeWriter   *w;
+  char           *cn,
+                 *dir,
+                 *p;
+  CMPIConstClass *cc;
+
+  dir = strdup(cr->fn);
+  p = strrchr(dir, '/');
+  if (p == NULL) {
+    free(dir);
+    return;
+  }
+  *p = 0;
+
+  w = newClassTree();
+  for (i = ct->ft->getFirst(ct, (void **) &cn, (void **) &cc); i;
+       i = ct->ft->getNext(ct, i, (void **) &cn, (void **) &cc))
+    addClassTree(w, cc->ft->getCharClassName(cc),
+                 cc->ft->getCharSuperClassName(cc));
+  writeClassTree(w, dir);
+  free(dir);
+}
+
 static void
 release(ClassRegister * cr)
 {
@@ -308,6 +342,7 @@ newClassRegister(char *fname)
           total);
 
   buildInheritanceTable(cr);
+  publishClassTree(cr);
 
   return cr;
 }
@@ -949,9 +984,14 @@ ClassProviderCreateClass(CMPIClassMI * mi,
   cReg->ft->wLock(cReg);
 
   st = addClass(cReg, (CMPIConstClass*)cc, cn, pn);
+  if (st.rc == CMPI_RC_OK)
+    publishClassTree(cReg);
 
   cReg->ft->wUnLock(cReg);
 
+  if (st.rc == CMPI_RC_OK)
+    bumpProvGeneration();
+
   _SFCB_RETURN(st);
 }
 
@@ -1008,9 +1048,12 @@ ClassProviderDeleteClass(CMPIClassMI * mi,
   if (pn)
     removeChild(cReg, pn, cn);
   removeClass(cReg, cn);
+  publishClassTree(cReg);
 
   cReg->ft->wUnLock(cReg);
 
+  bumpProvGeneration();
+
   _SFCB_RETURN(st);
 }
 
@@ -21,10 +21,14 @@
 
 #include "classProviderCommon.h"
 #include <zlib.h>
+#include "classSchemaBlock.h"
+#include "classSchemaImage.h"
+#include "classTree.h"
 
 #define LOCALCLASSNAME "ClassProvider"
 
 static unsigned int cacheLimit = 10;
+static int      useImage = 0;
 
 typedef struct _Class_Register_FT Class_Register_FT;
 struct _ClassRegister {
@@ -35,6 +39,8 @@ struct _ClassRegister {
                   topAssocs;
   char           *fn;
   gzFile          f;
+  ClBlockFile    *bf;
+  ClImage        *img;
 };
 typedef struct _ClassRegister ClassRegister;
 
@@ -47,8 +53,22 @@ typedef struct _ClassRecord {
   CMPIConstClass *cachedCls;
   unsigned int    flags;
 #define CREC_isAssociation 1
+#define CREC_isMapped 2
 } ClassRecord;
 
+/*
+ * read a class record, from its block if the file is block compressed 
+ */
+static void
+readClassRecord(ClassRegister * cr, ClassRecord * crec, char *buf)
+{
+  if (cr->bf == NULL ||
+      readBlockRecord(cr->bf, crec->position, buf, crec->length)) {
+    gzseek(cr->f, crec->position, SEEK_SET);
+    gzread(cr->f, buf, crec->length);
+  }
+}
+
 typedef struct _ClassBase {
   UtilHashTable  *ht;
   UtilHashTable  *it;
@@ -116,11 +136,30 @@ buildInheritanceTable(ClassRegister * cr)
   }
 }
 
+/*
+ * lets every process answer ISA questions for this namespace locally
+ */
+static void
+publishClassTree(ClassRegister * cr, const char *dir)
+{
+  ClTreeWriter   *w = newClassTree();
+  Iterator        i;
+  char           *cn;
+  ClassRecord    *crec;
+
+  for (i = cr->ft->getFirstClassRecord(cr, &cn, &crec); i;
+       i = cr->ft->getNextClassRecord(cr, i, &cn, &crec))
+    addClassTree(w, cn, crec->parent);
+  writeClassTree(w, dir);
+}
+
 static void
 release(ClassRegister * cr)
 {
   ClassBase      *cb = (ClassBase *) cr->hdl;
   free(cr->fn);
+  closeBlockFile(cr->bf);
+  closeClassImage(cr->img);
   cb->ht->ft->release(cb->ht);
   free(cr);
 }
@@ -189,10 +228,8 @@ getFirstClass(ClassRegister * cr, char **cn, CMPIConstClass ** cls,
   }
   *id = NULL;
 
-  gzseek(cr->f, crec->position, SEEK_SET);
-
   buf = malloc(crec->length);
-  gzread(cr->f, buf, crec->length);
+  readClassRecord(cr, crec, buf);
 
   cc = NEW(CMPIConstClass);
   cc->hdl = buf;
@@ -223,10 +260,8 @@ getNextClass(ClassRegister * cr, Iterator ip, char **cn,
   }
   *id = NULL;
 
-  gzseek(cr->f, crec->position, SEEK_SET);
-
   buf = malloc(crec->length);
-  gzread(cr->f, buf, crec->length);
+  readClassRecord(cr, crec, buf);
 
   cc = NEW(CMPIConstClass);
   cc->hdl = buf;
@@ -275,6 +310,78 @@ pruneCache(ClassRegister * cr)
   }
 }
 
+/*
+ * let the class records use the classes of the image, they are never
+ * read, cached or released otherwise 
+ */
+static int
+attachClassImage(ClassRegister * cr, ClImage * img)
+{
+  ClassBase      *cb = (ClassBase *) cr->hdl;
+  ClassRecord    *crec;
+  ClImageEntry   *e;
+  CMPIConstClass *cc;
+  uint32_t        i;
+
+  if (img->count != (uint32_t) cb->ht->ft->size(cb->ht))
+    return 0;
+  for (i = 0, e = img->ents; i < img->count; i++, e++)
+    if (cb->ht->ft->get(cb->ht, getClassImageName(img, e)) == NULL)
+      return 0;
+
+  for (i = 0, e = img->ents; i < img->count; i++, e++) {
+    crec = cb->ht->ft->get(cb->ht, getClassImageName(img, e));
+    cc = NEW(CMPIConstClass);
+    cc->hdl = getClassImageClass(img, e, 0);
+    cc->ft = CMPIConstClassFT;
+    crec->cachedCls = cc;
+    crec->flags |= CREC_isMapped;
+  }
+  cr->img = img;
+  return 1;
+}
+
+static int
+buildClassImage(ClassRegister * cr, const char *fn)
+{
+  ClImageWriter  *w = newClassImage();
+  Iterator        it;
+  char           *cn;
+  CMPIConstClass *cls;
+  void           *cid;
+
+  for (it = cr->ft->getFirstClass(cr, &cn, &cls, &cid); it && cls;
+       it = cr->ft->getNextClass(cr, it, &cn, &cls, &cid)) {
+    addClassImage(w, cn, (ClClass *) cls->hdl, NULL);
+    if (cid == NULL)
+      CMRelease(cls);
+  }
+  return writeClassImage(w, fn, cr->fn);
+}
+
+static void
+mapClassImage(ClassRegister * cr, const char *dir)
+{
+  char           *fn = alloca(strlen(dir) + sizeof(CL_IMAGE_NAME) + 2);
+  ClImage        *img;
+
+  sprintf(fn, "%s/%s", dir, CL_IMAGE_NAME);
+  img = openClassImage(fn, cr->fn);
+  if (img && attachClassImage(cr, img))
+    return;
+  closeClassImage(img);
+
+  if (buildClassImage(cr, fn) == 0) {
+    img = openClassImage(fn, cr->fn);
+    if (img && attachClassImage(cr, img)) {
+      mlogf(M_INFO, M_SHOW, "--- Built class image %s\n", fn);
+      return;
+    }
+    closeClassImage(img);
+  }
+  mlogf(M_INFO, M_SHOW, "--- Using %s without class image\n", cr->fn);
+}
+
 static ClassRegister *
 newClassRegister(char *fname)
 {
@@ -317,6 +424,7 @@ newClassRegister(char *fname)
     return cr;
 
   cr->fn = strdup(fin);
+  cr->bf = openBlockFile(fin);
   cr->vr = NULL;
   pos = gztell(cr->f);
 
@@ -430,6 +538,9 @@ newClassRegister(char *fname)
           fin, total);
 
   buildInheritanceTable(cr);
+  publishClassTree(cr, fname);
+  if (useImage)
+    mapClassImage(cr, fname);
 
   return cr;
 }
@@ -489,6 +600,7 @@ buildClassRegisters()
   char           *dn;
 
   setupControl(configfile);
+  getControlBool("classRepositoryImage", &useImage);
 
   if (getControlChars("registrationDir", &dir)) {
     dir = "/var/lib/sfcb/registration";
@@ -560,9 +672,8 @@ getClass(ClassRegister * cr, const char *clsName)
 
   if (crec->cachedCls == NULL) {
     // fprintf(stderr,"--- reading class %s\n",clsName);
-    gzseek(cr->f, crec->position, SEEK_SET);
     buf = malloc(crec->length);
-    gzread(cr->f, buf, crec->length);
+    readClassRecord(cr, crec, buf);
 
     cc = NEW(CMPIConstClass);
     cc->hdl = buf;
@@ -575,7 +686,8 @@ getClass(ClassRegister * cr, const char *clsName)
     ENQ_TOP_LIST(crec, cb->firstCached, cb->lastCached, nextCached,
                  prevCached);
   } else {
-    if (crec != cb->firstCached) {
+    /* mapped classes are not in the LRU list */
+    if (crec != cb->firstCached && (crec->flags & CREC_isMapped) == 0) {
       DEQ_FROM_LIST(crec, cb->firstCached, cb->lastCached, nextCached,
                     prevCached);
       ENQ_TOP_LIST(crec, cb->firstCached, cb->lastCached, nextCached,
@@ -59,6 +59,7 @@ struct _Class_Register_FT {
 };
 
 extern Class_Register_FT *ClassRegisterFT;
+extern void     bumpProvGeneration();
 
 static CMPIConstClass *getClass(ClassRegister * cr, const char *clsName);
 int             traverseChildren(ClassRegister * cReg, const char *parent,
@@ -770,6 +771,9 @@ ClassProviderCreateClass(CMPIClassMI * mi,
 
   cReg->ft->wUnLock(cReg);
 
+  if (st.rc == CMPI_RC_OK)
+    bumpProvGeneration();
+
   _SFCB_RETURN(st);
 }
 
@@ -829,6 +833,8 @@ ClassProviderDeleteClass(CMPIClassMI * mi,
 
   cReg->ft->wUnLock(cReg);
 
+  bumpProvGeneration();
+
   _SFCB_RETURN(st);
 }
 
@@ -23,6 +23,9 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <zlib.h>
+#include "classSchemaBlock.h"
+#include "classSchemaImage.h"
+#include "classTree.h"
 
 #define LOCALCLASSNAME "ClassProvider"
 
@@ -30,6 +33,7 @@ static int      argc = 0;
 static char   **argv = NULL;
 static int      cSize = 10;      // can't be 0!
 static int      rSize = 10;      // can't be 0!
+static int      useImage = 0;
 
 typedef enum readCtl { stdRead, tempRead, cached } ReadCtl;
 
@@ -44,6 +48,8 @@ struct _ClassRegister {
                   topAssocs;
   char           *fn;
   gzFile          f;
+  ClBlockFile    *bf;
+  ClImage        *img;
 };
 typedef struct _ClassRegister ClassRegister;
 
@@ -59,8 +65,22 @@ typedef struct _ClassRecord {
   CMPIConstClass *cachedRCls;
   unsigned int    flags;
 #define CREC_isAssociation 1
+#define CREC_isMapped 2
 } ClassRecord;
 
+/*
+ * read a class record, from its block if the file is block compressed 
+ */
+static void
+readClassRecord(ClassRegister * cr, ClassRecord * crec, char *buf)
+{
+  if (cr->bf == NULL ||
+      readBlockRecord(cr->bf, crec->position, buf, crec->length)) {
+    gzseek(cr->f, crec->position, SEEK_SET);
+    gzread(cr->f, buf, crec->length);
+  }
+}
+
 typedef struct _ClassBase {
   UtilHashTable  *ht;
   UtilHashTable  *it;
@@ -143,11 +163,30 @@ buildInheritanceTable(ClassRegister * cr)
   }
 }
 
+/*
+ * lets every process answer ISA questions for this namespace locally
+ */
+static void
+publishClassTree(ClassRegister * cr, const char *dir)
+{
+  ClTreeWriter   *w = newClassTree();
+  Iterator        i;
+  char           *cn;
+  ClassRecord    *crec;
+
+  for (i = cr->ft->getFirstClassRecord(cr, &cn, &crec); i;
+       i = cr->ft->getNextClassRecord(cr, i, &cn, &crec))
+    addClassTree(w, cn, crec->parent);
+  writeClassTree(w, dir);
+}
+
 static void
 release(ClassRegister * cr)
 {
   ClassBase      *cb = (ClassBase *) cr->hdl;
   free(cr->fn);
+  closeBlockFile(cr->bf);
+  closeClassImage(cr->img);
   cb->ht->ft->release(cb->ht);
   free(cr);
 }
@@ -294,6 +333,102 @@ pruneRCache(ClassRegister * cr)
   }
 }
 
+static CMPIConstClass *
+newMappedClass(ClClass * cls)
+{
+  CMPIConstClass *cc = NEW(CMPIConstClass);
+  cc->hdl = cls;
+  cc->ft = CMPIConstClassFT;
+  return cc;
+}
+
+/*
+ * let the class records use the classes of the image, they are never
+ * read, cached or released otherwise 
+ */
+static int
+attachClassImage(ClassRegister * cr, ClImage * img)
+{
+  ClassBase      *cb = (ClassBase *) cr->hdl;
+  ClassRecord    *crec;
+  ClImageEntry   *e;
+  uint32_t        i;
+
+  if (img->count != (uint32_t) cb->ht->ft->size(cb->ht))
+    return 0;
+  for (i = 0, e = img->ents; i < img->count; i++, e++)
+    if (cb->ht->ft->get(cb->ht, getClassImageName(img, e)) == NULL)
+      return 0;
+
+  for (i = 0, e = img->ents; i < img->count; i++, e++) {
+    crec = cb->ht->ft->get(cb->ht, getClassImageName(img, e));
+    crec->cachedCCls = newMappedClass(getClassImageClass(img, e, 0));
+    if (e->resolvedOfs == e->classOfs)
+      crec->cachedRCls = crec->cachedCCls;
+    else
+      crec->cachedRCls = newMappedClass(getClassImageClass(img, e, 1));
+    crec->flags |= CREC_isMapped;
+  }
+  cr->img = img;
+  return 1;
+}
+
+static int
+buildClassImage(ClassRegister * cr, const char *fn)
+{
+  ClImageWriter  *w = newClassImage();
+  Iterator        i;
+  char           *cn;
+  ClassRecord    *crec;
+  CMPIConstClass *cc,
+                 *rc;
+  ReadCtl         ctl,
+                  rctl;
+  int             reduced = cr->vr && cr->vr->options == ClTypeClassReducedRep;
+
+  for (i = cr->ft->getFirstClassRecord(cr, &cn, &crec); i;
+       i = cr->ft->getNextClassRecord(cr, i, &cn, &crec)) {
+    ctl = tempRead;
+    cc = getClass(cr, cn, &ctl);
+    rc = NULL;
+    if (reduced && crec->parent &&
+        ((ClClass *) cc->hdl)->hdr.type == HDR_IncompleteClass) {
+      rctl = tempRead;
+      rc = getResolvedClass(cr, cn, crec, &rctl);
+    }
+    addClassImage(w, cn, (ClClass *) cc->hdl,
+                  rc ? (ClClass *) rc->hdl : NULL);
+    if (rc && rctl != cached)
+      CMRelease(rc);
+    if (ctl != cached)
+      CMRelease(cc);
+  }
+  return writeClassImage(w, fn, cr->fn);
+}
+
+static void
+mapClassImage(ClassRegister * cr, const char *dir)
+{
+  char           *fn = alloca(strlen(dir) + sizeof(CL_IMAGE_NAME) + 2);
+  ClImage        *img;
+
+  sprintf(fn, "%s/%s", dir, CL_IMAGE_NAME);
+  img = openClassImage(fn, cr->fn);
+  if (img && attachClassImage(cr, img))
+    return;
+  closeClassImage(img);
+
+  if (buildClassImage(cr, fn) == 0) {
+    img = openClassImage(fn, cr->fn);
+    if (img && attachClassImage(cr, img)) {
+      mlogf(M_INFO, M_SHOW, "--- Built class image %s\n", fn);
+      return;
+    }
+    closeClassImage(img);
+  }
+  mlogf(M_INFO, M_SHOW, "--- Using %s without class image\n", cr->fn);
+}
+
 static ClassRegister *
 newClassRegister(char *fname)
 {
@@ -336,6 +471,7 @@ newClassRegister(char *fname)
     return cr;
 
   cr->fn = strdup(fin);
+  cr->bf = openBlockFile(fin);
   cr->vr = NULL;
   pos = gztell(cr->f);
 
@@ -452,6 +588,9 @@ newClassRegister(char *fname)
           fin, total);
 
   buildInheritanceTable(cr);
+  publishClassTree(cr, fname);
+  if (useImage)
+    mapClassImage(cr, fname);
 
   return cr;
 }
@@ -513,6 +652,7 @@ buildClassRegisters()
   char           *dn;
 
   setupControl(configfile);
+  getControlBool("classRepositoryImage", &useImage);
 
   if (getControlChars("registrationDir", &dir)) {
     dir = "/var/lib/sfcb/registration";
@@ -777,7 +917,7 @@ getResolvedClass(ClassRegister * cr, const char *clsName,
     // printf("-#- class %s in resolved cache
     // %p\n",clsName,crec->cachedRCls);
     _SFCB_TRACE(1, ("-#- class %s in resolved cache %p\n",clsName,crec->cachedRCls));
-    if (crec != cb->firstRCached) {
+    if (crec != cb->firstRCached && (crec->flags & CREC_isMapped) == 0) {
       DEQ_FROM_LIST(crec, cb->firstRCached, cb->lastRCached, nextRCached,
                     prevRCached);
       ENQ_TOP_LIST(crec, cb->firstRCached, cb->lastRCached, nextRCached,
@@ -806,9 +946,8 @@ getClass(ClassRegister * cr, const char *clsName, ReadCtl *ctl)
 
   /* class is not cached */
   if (crec->cachedCCls == NULL) {
-    gzseek(cr->f, crec->position, SEEK_SET);
     buf = malloc(crec->length);
-    gzread(cr->f, buf, crec->length);
+    readClassRecord(cr, crec, buf);
 
     cc = NEW(CMPIConstClass);
     cc->hdl = buf;
@@ -834,7 +973,8 @@ getClass(ClassRegister * cr, const char *clsName, ReadCtl *ctl)
     *ctl = cached;
   } else {
     //    printf("-#- class %s in cache %p\n",clsName,crec->cachedCCls);
-    if (crec != cb->firstCCached) {
+    /* mapped classes are not in the LRU list */
+    if (crec != cb->firstCCached && (crec->flags & CREC_isMapped) == 0) {
       DEQ_FROM_LIST(crec, cb->firstCCached, cb->lastCCached, nextCCached,
                     prevCCached);
       //    fprintf(stderr, "ENQing %p\n", crec);
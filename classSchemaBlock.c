@@ -0,0 +1,320 @@
+/*
+ * classSchemaBlock.c
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Reading and writing block compressed classSchemas.gz files.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "classSchemaBlock.h"
+
+/*
+ * gzip header with FEXTRA set: magic, CM, FLG, MTIME, XFL, OS, XLEN
+ */
+#define GZ_HDR_SIZE 12
+/*
+ * index member: header, subfield id and length, count, blocks + 1,
+ * member size, empty deflate stream, CRC32 and ISIZE
+ */
+#define IDX_MEMBER_SIZE(n) \
+  (GZ_HDR_SIZE + 4 + 4 + ((n) + 1) * sizeof(ClBlockEntry) + 4 + 2 + 8)
+#define IDX_TAIL_SIZE (4 + 2 + 8)
+
+static const unsigned char gzEmpty[10] = { 3, 0 };
+
+static void
+putLe16(unsigned char *p, unsigned int v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+static unsigned int
+getLe16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+ClBlockFile    *
+openBlockFile(const char *fn)
+{
+  ClBlockFile    *bf;
+  struct stat     st;
+  unsigned char   tail[IDX_TAIL_SIZE],
+                 *m;
+  uint32_t        size,
+                  count;
+  int             fd;
+
+  fd = open(fn, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) || st.st_size < (off_t) IDX_MEMBER_SIZE(0) ||
+      pread(fd, tail, sizeof(tail), st.st_size - sizeof(tail)) !=
+      sizeof(tail) || memcmp(tail + 4, gzEmpty, sizeof(gzEmpty))) {
+    close(fd);
+    return NULL;
+  }
+
+  memcpy(&size, tail, sizeof(size));
+  if (size < IDX_MEMBER_SIZE(0) || size > st.st_size ||
+      size > IDX_MEMBER_SIZE(65535 / sizeof(ClBlockEntry))) {
+    close(fd);
+    return NULL;
+  }
+  m = malloc(size);
+  if (pread(fd, m, size, st.st_size - size) != size ||
+      m[0] != 0x1f || m[1] != 0x8b || m[2] != Z_DEFLATED || m[3] != 4 ||
+      getLe16(m + 10) != size - GZ_HDR_SIZE - 2 - 8 ||
+      m[12] != CL_BLOCK_SI1 || m[13] != CL_BLOCK_SI2 ||
+      getLe16(m + 14) != getLe16(m + 10) - 4) {
+    free(m);
+    close(fd);
+    return NULL;
+  }
+  memcpy(&count, m + 16, sizeof(count));
+  if (IDX_MEMBER_SIZE(count) != size) {
+    free(m);
+    close(fd);
+    return NULL;
+  }
+
+  bf = calloc(1, sizeof(*bf));
+  bf->fd = fd;
+  bf->count = count;
+  bf->blocks = malloc((count + 1) * sizeof(*bf->blocks));
+  memcpy(bf->blocks, m + 20, (count + 1) * sizeof(*bf->blocks));
+  bf->cached = -1;
+  free(m);
+
+  /* the index has to describe this very file */
+  if (bf->blocks[count].cofs != st.st_size - size) {
+    closeBlockFile(bf);
+    return NULL;
+  }
+  return bf;
+}
+
+void
+closeBlockFile(ClBlockFile * bf)
+{
+  if (bf == NULL)
+    return;
+  close(bf->fd);
+  free(bf->blocks);
+  free(bf->buf);
+  free(bf->cbuf);
+  free(bf);
+}
+
+static int
+inflateBlock(ClBlockFile * bf, uint32_t b)
+{
+  ClBlockEntry   *e = bf->blocks + b;
+  uint32_t        clen = e[1].cofs - e->cofs,
+                  ulen = e[1].uofs - e->uofs;
+  z_stream        zs;
+  int             rc;
+
+  if (clen > bf->cbufSize) {
+    free(bf->cbuf);
+    bf->cbuf = malloc(clen);
+    bf->cbufSize = clen;
+  }
+  if (pread(bf->fd, bf->cbuf, clen, e->cofs) != clen)
+    return -1;
+
+  bf->cached = -1;
+  bf->buf = realloc(bf->buf, ulen + 1);
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK)
+    return -1;
+  zs.next_in = bf->cbuf;
+  zs.avail_in = clen;
+  zs.next_out = (unsigned char *) bf->buf;
+  zs.avail_out = ulen + 1;
+  rc = inflate(&zs, Z_FINISH);
+  inflateEnd(&zs);
+  if (rc != Z_STREAM_END || zs.total_out != ulen)
+    return -1;
+  bf->cached = b;
+  return 0;
+}
+
+int
+readBlockRecord(ClBlockFile * bf, unsigned long pos, void *buf,
+                unsigned long len)
+{
+  uint32_t        lo = 0,
+                  hi = bf->count,
+                  mid;
+
+  /* last block starting at or before pos */
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+    if (bf->blocks[mid].uofs <= pos)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  if (bf->count == 0 || pos < bf->blocks[lo].uofs ||
+      pos + len > bf->blocks[lo + 1].uofs)
+    return -1;
+
+  if (bf->cached != lo && inflateBlock(bf, lo))
+    return -1;
+  memcpy(buf, bf->buf + (pos - bf->blocks[lo].uofs), len);
+  return 0;
+}
+
+static int
+writeBlock(FILE * o, const char *data, unsigned long len)
+{
+  z_stream        zs;
+  unsigned char  *out;
+  unsigned long   size;
+  int             rc;
+
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    return -1;
+  size = deflateBound(&zs, len) + 32;
+  out = malloc(size);
+  zs.next_in = (unsigned char *) data;
+  zs.avail_in = len;
+  zs.next_out = out;
+  zs.avail_out = size;
+  rc = deflate(&zs, Z_FINISH);
+  if (rc == Z_STREAM_END)
+    rc = fwrite(out, zs.total_out, 1, o) - 1;
+  else
+    rc = -1;
+  deflateEnd(&zs);
+  free(out);
+  return rc;
+}
+
+/*
+ * compresses the class records of in into blocks of about blockSize bytes
+ */
+int
+writeBlockFile(const char *in, const char *out, unsigned long blockSize)
+{
+  FILE           *i,
+                 *o;
+  struct stat     st;
+  char           *data;
+  unsigned char  *m;
+  ClBlockEntry   *blocks = NULL;
+  uint32_t        count = 0,
+                  max = 0,
+                  rsize,
+                  msize;
+  unsigned long   pos = 0,
+                  start = 0;
+  int             rc = 0;
+
+  i = fopen(in, "rb");
+  if (i == NULL)
+    return -1;
+  if (fstat(fileno(i), &st)) {
+    fclose(i);
+    return -1;
+  }
+  data = malloc(st.st_size + 1);
+  if (st.st_size && fread(data, st.st_size, 1, i) != 1) {
+    free(data);
+    fclose(i);
+    return -1;
+  }
+  fclose(i);
+
+  o = fopen(out, "wb");
+  if (o == NULL) {
+    free(data);
+    return -1;
+  }
+
+  /* every record starts with its size, blocks end on record boundaries */
+  while (rc == 0 && pos < (unsigned long) st.st_size) {
+    if (pos + sizeof(rsize) > (unsigned long) st.st_size)
+      rc = -1;
+    else {
+      memcpy(&rsize, data + pos, sizeof(rsize));
+      if (rsize < sizeof(rsize) || pos + rsize > (unsigned long) st.st_size)
+        rc = -1;
+      else
+        pos += rsize;
+    }
+    if (rc == 0 && (pos - start >= blockSize ||
+                    pos == (unsigned long) st.st_size)) {
+      if (count == max) {
+        max = max ? max * 2 : 64;
+        blocks = realloc(blocks, (max + 1) * sizeof(*blocks));
+      }
+      blocks[count].uofs = start;
+      blocks[count++].cofs = ftell(o);
+      rc = writeBlock(o, data + start, pos - start);
+      start = pos;
+    }
+  }
+  if (count > 65535 / sizeof(ClBlockEntry) - 1)
+    rc = -1;
+
+  if (rc == 0) {
+    if (blocks == NULL)
+      blocks = malloc(sizeof(*blocks));
+    blocks[count].uofs = pos;
+    blocks[count].cofs = ftell(o);
+
+    msize = IDX_MEMBER_SIZE(count);
+    m = calloc(1, msize);
+    m[0] = 0x1f;
+    m[1] = 0x8b;
+    m[2] = Z_DEFLATED;
+    m[3] = 4;                   /* FEXTRA */
+    m[9] = 3;                   /* OS: unix */
+    putLe16(m + 10, msize - GZ_HDR_SIZE - 2 - 8);
+    m[12] = CL_BLOCK_SI1;
+    m[13] = CL_BLOCK_SI2;
+    putLe16(m + 14, msize - GZ_HDR_SIZE - 2 - 8 - 4);
+    memcpy(m + 16, &count, sizeof(count));
+    memcpy(m + 20, blocks, (count + 1) * sizeof(*blocks));
+    memcpy(m + msize - IDX_TAIL_SIZE, &msize, sizeof(msize));
+    memcpy(m + msize - sizeof(gzEmpty), gzEmpty, sizeof(gzEmpty));
+    rc = fwrite(m, msize, 1, o) - 1;
+    free(m);
+  }
+
+  rc += fclose(o);
+  if (rc)
+    remove(out);
+  free(blocks);
+  free(data);
+  return rc;
+}
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
@@ -0,0 +1,70 @@
+/*
+ * classSchemaBlock.h
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Block compressed classSchemas.gz files.
+ *
+ * The file is a sequence of gzip members, each holding whole class
+ * records, so that gzread() and gunzip still see the plain classSchemas.
+ * It ends with an empty member whose extra field ("SF") holds the
+ * uncompressed and compressed start offset of every block, followed by
+ * the size of that member. A record can thus be read by inflating the
+ * one block containing it instead of seeking in the gzip stream.
+ *
+ */
+
+#ifndef CLASSSCHEMABLOCK_H
+#define CLASSSCHEMABLOCK_H
+
+#include <stdint.h>
+
+#define CL_BLOCK_SIZE 65536     /* default uncompressed block size */
+#define CL_BLOCK_SI1 'S'
+#define CL_BLOCK_SI2 'F'
+
+typedef struct clBlockEntry {
+  uint32_t        uofs,         /* offset in the uncompressed stream */
+                  cofs;         /* offset of the gzip member */
+} ClBlockEntry;
+
+typedef struct clBlockFile {
+  int             fd;
+  uint32_t        count;        /* blocks, blocks[count] ends the last */
+  ClBlockEntry   *blocks;
+  long            cached;       /* block held in buf, -1 if none */
+  char           *buf;
+  unsigned char  *cbuf;
+  uint32_t        cbufSize;
+} ClBlockFile;
+
+/*
+ * returns NULL unless fn is a block compressed file
+ */
+extern ClBlockFile *openBlockFile(const char *fn);
+extern void     closeBlockFile(ClBlockFile * bf);
+/*
+ * copies len bytes at uncompressed offset pos into buf; returns -1 if
+ * they are not within a single block
+ */
+extern int      readBlockRecord(ClBlockFile * bf, unsigned long pos,
+                                void *buf, unsigned long len);
+extern int      writeBlockFile(const char *in, const char *out,
+                               unsigned long blockSize);
+
+#endif
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
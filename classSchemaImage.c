@@ -0,0 +1,292 @@
+/*
+ * classSchemaImage.c
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Building and mapping class images.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "classSchemaImage.h"
+#include "mlog.h"
+#include "trace.h"
+
+#define CL_IMAGE_MAGIC "SFCBCIMG"
+#define CL_IMAGE_VERSION 1
+
+typedef struct clImageHdr {
+  char            magic[8];
+  uint32_t        version,
+                  objImplLevel,
+                  ptrSize,
+                  count;
+  uint64_t        base,         /* address the records are relocated for */
+                  size,
+                  srcSize,
+                  srcMtime,
+                  srcIno;
+} ClImageHdr;
+
+struct clImageWriter {
+  ClImageEntry   *ents;
+  uint32_t        count,
+                  max;
+  char           *names,
+                 *recs;
+  unsigned long   namesUsed,
+                  namesMax,
+                  recsUsed,
+                  recsMax;
+};
+
+static void
+relocateImage(ClImage * img)
+{
+  uint32_t        i;
+
+  for (i = 0; i < img->count; i++) {
+    ClClassRelocateClass(getClassImageClass(img, img->ents + i, 0));
+    if (img->ents[i].resolvedOfs != img->ents[i].classOfs)
+      ClClassRelocateClass(getClassImageClass(img, img->ents + i, 1));
+  }
+}
+
+ClImage        *
+openClassImage(const char *fn, const char *src)
+{
+  ClImage        *img;
+  ClImageHdr      hdr;
+  struct stat     st,
+                  sst;
+  char           *map;
+  int             fd;
+
+  _SFCB_ENTER(TRACE_PROVIDERS, "openClassImage");
+
+  fd = open(fn, O_RDONLY);
+  if (fd < 0)
+    _SFCB_RETURN(NULL);
+  if (fstat(fd, &st) || stat(src, &sst) ||
+      pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+      memcmp(hdr.magic, CL_IMAGE_MAGIC, sizeof(hdr.magic)) ||
+      hdr.version != CL_IMAGE_VERSION ||
+      hdr.objImplLevel != ClCurrentObjImplLevel ||
+      hdr.ptrSize != sizeof(void *) || hdr.size != (uint64_t) st.st_size ||
+      hdr.srcSize != (uint64_t) sst.st_size ||
+      hdr.srcMtime != (uint64_t) sst.st_mtime ||
+      hdr.srcIno != (uint64_t) sst.st_ino) {
+    close(fd);
+    _SFCB_RETURN(NULL);
+  }
+
+  /*
+   * private and writable only for the case the records have to be
+   * relocated; as long as nothing is written all pages stay shared
+   */
+  map = mmap((void *) (uintptr_t) hdr.base, hdr.size,
+             PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    _SFCB_RETURN(NULL);
+
+  img = calloc(1, sizeof(*img));
+  img->map = map;
+  img->size = hdr.size;
+  img->count = hdr.count;
+  img->ents = (ClImageEntry *) (map + sizeof(hdr));
+  if ((uintptr_t) map != hdr.base) {
+    _SFCB_TRACE(1, ("--- %s mapped at %p instead of %p, relocating", fn,
+                    map, (void *) (uintptr_t) hdr.base));
+    relocateImage(img);
+  }
+  _SFCB_RETURN(img);
+}
+
+void
+closeClassImage(ClImage * img)
+{
+  if (img == NULL)
+    return;
+  munmap(img->map, img->size);
+  free(img);
+}
+
+const char     *
+getClassImageName(ClImage * img, ClImageEntry * e)
+{
+  return img->map + e->nameOfs;
+}
+
+ClClass        *
+getClassImageClass(ClImage * img, ClImageEntry * e, int resolved)
+{
+  return (ClClass *) (img->map + (resolved ? e->resolvedOfs : e->classOfs));
+}
+
+ClImageWriter  *
+newClassImage(void)
+{
+  return calloc(1, sizeof(ClImageWriter));
+}
+
+static unsigned long
+addRecord(ClImageWriter * w, ClClass * cls)
+{
+  unsigned long   ofs = w->recsUsed,
+                  sz = ALIGN(ClSizeClass(cls), CLALIGN) + CLEXTRA;
+
+  if (w->recsUsed + sz > w->recsMax) {
+    w->recsMax = (w->recsUsed + sz) * 2;
+    w->recs = realloc(w->recs, w->recsMax);
+  }
+  memset(w->recs + ofs, 0, sz);
+  ClClassRebuildClass(cls, w->recs + ofs);
+  w->recsUsed += ALIGN(sz, CLALIGN);
+  return ofs;
+}
+
+void
+addClassImage(ClImageWriter * w, const char *name, ClClass * cls,
+              ClClass * resolved)
+{
+  ClImageEntry   *e;
+  size_t          l = strlen(name) + 1;
+
+  if (w->count == w->max) {
+    w->max = w->max ? w->max * 2 : 256;
+    w->ents = realloc(w->ents, w->max * sizeof(*w->ents));
+  }
+  if (w->namesUsed + l > w->namesMax) {
+    w->namesMax = (w->namesUsed + l) * 2;
+    w->names = realloc(w->names, w->namesMax);
+  }
+
+  e = w->ents + w->count++;
+  e->nameOfs = w->namesUsed;
+  e->flags = 0;
+  memcpy(w->names + w->namesUsed, name, l);
+  w->namesUsed += l;
+  e->classOfs = e->resolvedOfs = addRecord(w, cls);
+  if (resolved && resolved != cls)
+    e->resolvedOfs = addRecord(w, resolved);
+}
+
+static void
+freeClassImage(ClImageWriter * w)
+{
+  free(w->ents);
+  free(w->names);
+  free(w->recs);
+  free(w);
+}
+
+int
+writeClassImage(ClImageWriter * w, const char *fn, const char *src)
+{
+  ClImageHdr      hdr;
+  ClImage         img;
+  struct stat     sst;
+  char           *tmp,
+                 *map;
+  unsigned long   nameBase,
+                  recBase;
+  uint32_t        i;
+  FILE           *f;
+  int             rc = 0;
+
+  _SFCB_ENTER(TRACE_PROVIDERS, "writeClassImage");
+
+  if (stat(src, &sst)) {
+    freeClassImage(w);
+    _SFCB_RETURN(-1);
+  }
+
+  nameBase = sizeof(hdr) + w->count * sizeof(*w->ents);
+  recBase = ALIGN(nameBase + w->namesUsed, 64);
+  for (i = 0; i < w->count; i++) {
+    w->ents[i].nameOfs += nameBase;
+    w->ents[i].classOfs += recBase;
+    w->ents[i].resolvedOfs += recBase;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CL_IMAGE_MAGIC, sizeof(hdr.magic));
+  hdr.version = CL_IMAGE_VERSION;
+  hdr.objImplLevel = ClCurrentObjImplLevel;
+  hdr.ptrSize = sizeof(void *);
+  hdr.count = w->count;
+  hdr.size = recBase + w->recsUsed;
+  hdr.srcSize = sst.st_size;
+  hdr.srcMtime = sst.st_mtime;
+  hdr.srcIno = sst.st_ino;
+
+  tmp = malloc(strlen(fn) + 16);
+  sprintf(tmp, "%s.%d", fn, getpid());
+  f = fopen(tmp, "w+b");
+  if (f == NULL) {
+    mlogf(M_ERROR, M_SHOW, "--- Unable to create %s\n", tmp);
+    free(tmp);
+    freeClassImage(w);
+    _SFCB_RETURN(-1);
+  }
+  rc += fwrite(&hdr, sizeof(hdr), 1, f) - 1;
+  if (w->count)
+    rc += fwrite(w->ents, w->count * sizeof(*w->ents), 1, f) - 1;
+  if (w->namesUsed)
+    rc += fwrite(w->names, w->namesUsed, 1, f) - 1;
+  fseek(f, recBase, SEEK_SET);
+  if (w->recsUsed)
+    rc += fwrite(w->recs, w->recsUsed, 1, f) - 1;
+  rc += fflush(f);
+  rc += ftruncate(fileno(f), hdr.size);
+  freeClassImage(w);
+
+  /* relocate the records for wherever the image lands now */
+  if (rc == 0) {
+    map = mmap(NULL, hdr.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+               fileno(f), 0);
+    if (map == MAP_FAILED)
+      rc = -1;
+    else {
+      img.map = map;
+      img.count = hdr.count;
+      img.ents = (ClImageEntry *) (map + sizeof(hdr));
+      relocateImage(&img);
+      ((ClImageHdr *) map)->base = (uintptr_t) map;
+      rc = msync(map, hdr.size, MS_SYNC);
+      munmap(map, hdr.size);
+    }
+  }
+  rc += fclose(f);
+  if (rc == 0)
+    rc = rename(tmp, fn);
+  if (rc) {
+    mlogf(M_ERROR, M_SHOW, "--- Unable to write %s\n", fn);
+    remove(tmp);
+  }
+  free(tmp);
+  _SFCB_RETURN(rc);
+}
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
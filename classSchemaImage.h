@@ -0,0 +1,77 @@
+/*
+ * classSchemaImage.h
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Mapped class images (classSchemas.img).
+ *
+ * The image holds every class of a namespace, and its resolved form if
+ * that differs, as ClClass records ready for use. They are relocated for
+ * the address the image was built at; mapping it there again needs no
+ * fixups, so the classes are used straight from the page cache. Mapped
+ * elsewhere, the records are relocated in place, copying just the pages
+ * touched.
+ *
+ */
+
+#ifndef CLASSSCHEMAIMAGE_H
+#define CLASSSCHEMAIMAGE_H
+
+#include <stdint.h>
+#include "objectImpl.h"
+
+#define CL_IMAGE_NAME "classSchemas.img"
+
+typedef struct clImageEntry {
+  uint32_t        nameOfs,
+                  flags;
+  uint64_t        classOfs,     /* as in classSchemas */
+                  resolvedOfs;  /* same as classOfs unless resolved */
+} ClImageEntry;
+
+typedef struct clImage {
+  char           *map;
+  unsigned long   size;
+  uint32_t        count;
+  ClImageEntry   *ents;
+} ClImage;
+
+typedef struct clImageWriter ClImageWriter;
+
+/*
+ * returns NULL if fn is missing or was not built from src as it is now
+ */
+extern ClImage *openClassImage(const char *fn, const char *src);
+extern void     closeClassImage(ClImage * img);
+extern const char *getClassImageName(ClImage * img, ClImageEntry * e);
+extern ClClass *getClassImageClass(ClImage * img, ClImageEntry * e,
+                                   int resolved);
+
+extern ClImageWriter *newClassImage(void);
+/*
+ * resolved may be NULL or cls
+ */
+extern void     addClassImage(ClImageWriter * w, const char *name,
+                              ClClass * cls, ClClass * resolved);
+/*
+ * writes and releases w
+ */
+extern int      writeClassImage(ClImageWriter * w, const char *fn,
+                                const char *src);
+
+#endif
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
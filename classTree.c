@@ -0,0 +1,452 @@
+/*
+ * classTree.c
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Writing and mapping shared class hierarchy tables.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "classTree.h"
+#include "control.h"
+#include "mlog.h"
+#include "trace.h"
+
+#define CL_TREE_MAGIC "SFCBCTRE"
+#define CL_TREE_VERSION 2       /* 2 added srcSize and srcMtime */
+#define CL_TREE_NONE 0xffffffff
+#define CL_TREE_RETRY 10        /* seconds before looking for a missing
+                                 * table again */
+
+typedef struct clTreeHdr {
+  char            magic[8];
+  uint32_t        version,
+                  count,
+                  stale,        /* set once a newer table replaced this one
+                                 */
+                  pad;
+  uint64_t        size;
+  uint64_t        srcSize;      /* classSchemas the table was built from */
+  int64_t         srcMtime;
+} ClTreeHdr;
+
+/*
+ * entries are sorted by name ignoring case; a class is within the
+ * subtree of another if its interval [pre,post] is
+ */
+typedef struct clTreeEntry {
+  uint32_t        nameOfs,
+                  pre,
+                  post,
+                  parent;
+} ClTreeEntry;
+
+typedef struct clTreeClass {
+  char           *name,
+                 *parent;
+} ClTreeClass;
+
+struct clTreeWriter {
+  ClTreeClass    *cls;
+  uint32_t        count,
+                  max;
+};
+
+typedef struct clTreeMap {
+  struct clTreeMap *next;
+  char           *ns;
+  char           *map;          /* NULL if there is no table */
+  unsigned long   size;
+  time_t          checked;
+} ClTreeMap;
+
+static ClTreeMap *treeMaps = NULL;
+static pthread_mutex_t treeMapsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * the classSchemas of the namespace in dir, plain or compressed; size
+ * and mtime are 0 if there is none
+ */
+static void
+statSchemas(const char *dir, uint64_t * size, int64_t * mtime)
+{
+  struct stat     st;
+  size_t          l = strlen(dir) + 32;
+  char           *fn = malloc(l);
+
+  *size = 0;
+  *mtime = 0;
+  snprintf(fn, l, "%s/classSchemas", dir);
+  if (stat(fn, &st)) {
+    snprintf(fn, l, "%s/classSchemas.gz", dir);
+    if (stat(fn, &st)) {
+      free(fn);
+      return;
+    }
+  }
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+  free(fn);
+}
+
+/*
+ * namespaces come from clients and end up in a path: relative names
+ * made of '/' separated, non empty segments, none of them . or ..
+ */
+static int
+validNameSpace(const char *ns)
+{
+  const char     *s;
+
+  if (*ns == 0 || *ns == '/' || strlen(ns) > 256)
+    return 0;
+  for (s = ns; *s; s++) {
+    if (!isalnum((unsigned char) *s) && *s != '_' && *s != '-' &&
+        *s != '.' && *s != '/')
+      return 0;
+  }
+  for (s = ns; s; s = strchr(s, '/')) {
+    if (*s == '/')
+      s++;
+    if (*s == 0 || *s == '/' || strncmp(s, ".", strcspn(s, "/")) == 0 ||
+        strncmp(s, "..", strcspn(s, "/")) == 0)
+      return 0;
+  }
+  return 1;
+}
+
+ClTreeWriter   *
+newClassTree(void)
+{
+  return calloc(1, sizeof(ClTreeWriter));
+}
+
+void
+addClassTree(ClTreeWriter * w, const char *name, const char *parent)
+{
+  if (w->count == w->max) {
+    w->max = w->max ? w->max * 2 : 256;
+    w->cls = realloc(w->cls, w->max * sizeof(*w->cls));
+  }
+  w->cls[w->count].name = strdup(name);
+  w->cls[w->count++].parent = parent ? strdup(parent) : NULL;
+}
+
+static void
+freeClassTree(ClTreeWriter * w)
+{
+  uint32_t        i;
+
+  for (i = 0; i < w->count; i++) {
+    free(w->cls[i].name);
+    free(w->cls[i].parent);
+  }
+  free(w->cls);
+  free(w);
+}
+
+static int
+cmpClass(const void *a, const void *b)
+{
+  return strcasecmp(((ClTreeClass *) a)->name, ((ClTreeClass *) b)->name);
+}
+
+static uint32_t
+findClass(ClTreeWriter * w, const char *name)
+{
+  ClTreeClass     key,
+                 *c;
+
+  key.name = (char *) name;
+  c = bsearch(&key, w->cls, w->count, sizeof(*w->cls), cmpClass);
+  return c ? (uint32_t) (c - w->cls) : CL_TREE_NONE;
+}
+
+/*
+ * numbers the classes depth first, pre on the way down and post on the
+ * way up
+ */
+static void
+numberClasses(ClTreeWriter * w, ClTreeEntry * ents)
+{
+  uint32_t       *first,
+                 *next,
+                 *stack,
+                  i,
+                  n = 0,
+                  sp;
+
+  first = malloc(w->count * sizeof(*first));
+  next = malloc(w->count * sizeof(*next));
+  stack = malloc(w->count * sizeof(*stack));
+  for (i = 0; i < w->count; i++) {
+    first[i] = CL_TREE_NONE;
+    ents[i].pre = ents[i].post = CL_TREE_NONE;
+  }
+  for (i = w->count; i-- > 0;) {
+    if (ents[i].parent != CL_TREE_NONE) {
+      next[i] = first[ents[i].parent];
+      first[ents[i].parent] = i;
+    }
+  }
+
+  for (i = 0; i < w->count; i++) {
+    if (ents[i].parent != CL_TREE_NONE)
+      continue;
+    sp = 0;
+    stack[sp++] = i;
+    ents[i].pre = n++;
+    while (sp) {
+      uint32_t        c = stack[sp - 1];
+      if (first[c] != CL_TREE_NONE) {
+        uint32_t        ch = first[c];
+        first[c] = next[ch];
+        stack[sp++] = ch;
+        ents[ch].pre = n++;
+      } else {
+        ents[c].post = n++;
+        sp--;
+      }
+    }
+  }
+
+  /* only a broken repository has classes not reachable from a root */
+  for (i = 0; i < w->count; i++) {
+    if (ents[i].pre == CL_TREE_NONE) {
+      ents[i].pre = n++;
+      ents[i].post = n++;
+    }
+  }
+
+  free(first);
+  free(next);
+  free(stack);
+}
+
+int
+writeClassTree(ClTreeWriter * w, const char *dir)
+{
+  ClTreeHdr       hdr;
+  ClTreeEntry    *ents;
+  char           *fn,
+                 *tmp;
+  unsigned long   nameOfs;
+  uint32_t        i,
+                  stale = 1;
+  FILE           *f;
+  int             rc = 0,
+      old;
+
+  _SFCB_ENTER(TRACE_PROVIDERS, "writeClassTree");
+
+  qsort(w->cls, w->count, sizeof(*w->cls), cmpClass);
+
+  ents = malloc((w->count + 1) * sizeof(*ents));
+  nameOfs = sizeof(hdr) + w->count * sizeof(*ents);
+  for (i = 0; i < w->count; i++) {
+    ents[i].nameOfs = nameOfs;
+    nameOfs += strlen(w->cls[i].name) + 1;
+    ents[i].parent =
+        w->cls[i].parent ? findClass(w, w->cls[i].parent) : CL_TREE_NONE;
+  }
+  numberClasses(w, ents);
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CL_TREE_MAGIC, sizeof(hdr.magic));
+  hdr.version = CL_TREE_VERSION;
+  hdr.count = w->count;
+  hdr.size = nameOfs;
+  statSchemas(dir, &hdr.srcSize, &hdr.srcMtime);
+
+  fn = malloc(strlen(dir) + strlen(CL_TREE_NAME) + 2);
+  sprintf(fn, "%s/%s", dir, CL_TREE_NAME);
+  tmp = malloc(strlen(fn) + 16);
+  sprintf(tmp, "%s.%d", fn, getpid());
+
+  f = fopen(tmp, "wb");
+  if (f == NULL) {
+    mlogf(M_ERROR, M_SHOW, "--- Unable to create %s\n", tmp);
+    rc = -1;
+  } else {
+    rc += fwrite(&hdr, sizeof(hdr), 1, f) - 1;
+    if (w->count)
+      rc += fwrite(ents, w->count * sizeof(*ents), 1, f) - 1;
+    for (i = 0; i < w->count; i++)
+      rc += fwrite(w->cls[i].name, strlen(w->cls[i].name) + 1, 1, f) - 1;
+    rc += fclose(f);
+
+    /* readers still mapping the old table learn about the new one */
+    old = open(fn, O_WRONLY);
+    if (rc == 0)
+      rc = rename(tmp, fn);
+    if (rc) {
+      mlogf(M_ERROR, M_SHOW, "--- Unable to write %s\n", fn);
+      remove(tmp);
+    } else if (old >= 0 &&
+               pwrite(old, &stale, sizeof(stale),
+                      offsetof(ClTreeHdr, stale)) != sizeof(stale))
+      mlogf(M_ERROR, M_SHOW, "--- Unable to invalidate previous %s\n", fn);
+    if (old >= 0)
+      close(old);
+  }
+
+  free(tmp);
+  free(fn);
+  free(ents);
+  freeClassTree(w);
+  _SFCB_RETURN(rc);
+}
+
+/*
+ * a table is only used if it was built from the classSchemas next to it;
+ * one left behind by a repository rebuilt since is skipped until the
+ * class provider loads the namespace and writes a new one
+ */
+static char    *
+openTreeFile(const char *dir, unsigned long *size)
+{
+  ClTreeHdr       hdr;
+  struct stat     st;
+  uint64_t        srcSize;
+  int64_t         srcMtime;
+  size_t          l = strlen(dir) + strlen(CL_TREE_NAME) + 2;
+  char           *fn = malloc(l),
+                 *map;
+  int             fd;
+
+  snprintf(fn, l, "%s/%s", dir, CL_TREE_NAME);
+  fd = open(fn, O_RDONLY);
+  free(fn);
+  if (fd < 0)
+    return NULL;
+  statSchemas(dir, &srcSize, &srcMtime);
+  if (fstat(fd, &st) || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+      memcmp(hdr.magic, CL_TREE_MAGIC, sizeof(hdr.magic)) ||
+      hdr.version != CL_TREE_VERSION || hdr.stale ||
+      hdr.size != (uint64_t) st.st_size ||
+      sizeof(hdr) + (uint64_t) hdr.count * sizeof(ClTreeEntry) > hdr.size ||
+      hdr.srcSize != srcSize || hdr.srcMtime != srcMtime) {
+    close(fd);
+    return NULL;
+  }
+  map = mmap(NULL, hdr.size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+  *size = hdr.size;
+  return map;
+}
+
+static void
+mapTree(ClTreeMap * tm)
+{
+  char           *dir,
+                 *fn,
+                 *p;
+  size_t          l;
+
+  tm->checked = time(NULL);
+  if (getControlChars("registrationDir", &dir))
+    dir = "/var/lib/sfcb/registration";
+  l = strlen(dir) + strlen(tm->ns) + 16;
+  fn = malloc(l);
+  snprintf(fn, l, "%s/repository/%s", dir, tm->ns);
+  tm->map = openTreeFile(fn, &tm->size);
+
+  /* namespace directories are usually lower case */
+  if (tm->map == NULL) {
+    for (p = fn + strlen(dir); *p; p++)
+      *p = tolower(*p);
+    tm->map = openTreeFile(fn, &tm->size);
+  }
+  free(fn);
+}
+
+static ClTreeEntry *
+lookupClass(ClTreeMap * tm, const char *name)
+{
+  ClTreeHdr      *hdr = (ClTreeHdr *) tm->map;
+  ClTreeEntry    *ents = (ClTreeEntry *) (tm->map + sizeof(*hdr));
+  uint32_t        lo = 0,
+                  hi = hdr->count,
+                  mid;
+  int             c;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    c = strcasecmp(name, tm->map + ents[mid].nameOfs);
+    if (c == 0)
+      return ents + mid;
+    if (c < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return NULL;
+}
+
+int
+classTreeIsA(const char *ns, const char *cls, const char *type)
+{
+  ClTreeMap      *tm;
+  ClTreeEntry    *c,
+                 *t;
+  int             rc = -1;
+
+  if (ns == NULL || cls == NULL || type == NULL || !validNameSpace(ns))
+    return -1;
+
+  pthread_mutex_lock(&treeMapsMutex);
+  for (tm = treeMaps; tm; tm = tm->next)
+    if (strcasecmp(tm->ns, ns) == 0)
+      break;
+  if (tm == NULL) {
+    tm = calloc(1, sizeof(*tm));
+    tm->ns = strdup(ns);
+    tm->next = treeMaps;
+    treeMaps = tm;
+    mapTree(tm);
+  } else if (tm->map && ((volatile ClTreeHdr *) tm->map)->stale) {
+    munmap(tm->map, tm->size);
+    mapTree(tm);
+  } else if (tm->map == NULL && time(NULL) - tm->checked >= CL_TREE_RETRY)
+    mapTree(tm);
+
+  if (tm->map) {
+    c = lookupClass(tm, cls);
+    t = lookupClass(tm, type);
+    if (c && t)
+      rc = (t->pre <= c->pre && c->post <= t->post);
+  }
+  pthread_mutex_unlock(&treeMapsMutex);
+  return rc;
+}
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
@@ -0,0 +1,58 @@
+/*
+ * classTree.h
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Shared class hierarchy tables (classTree).
+ *
+ * The class provider publishes the inheritance of every namespace it
+ * serves as a file next to its classSchemas. Each class carries the
+ * interval its subtree spans in a depth-first numbering, so that any
+ * process mapping the file answers "is A a B" with two compares instead
+ * of asking the class provider. A table is never changed once written;
+ * a new one replaces it and marks the old one stale, prompting readers
+ * to map the new one.
+ *
+ */
+
+#ifndef CLASSTREE_H
+#define CLASSTREE_H
+
+#define CL_TREE_NAME "classTree"
+
+typedef struct clTreeWriter ClTreeWriter;
+
+extern ClTreeWriter *newClassTree(void);
+/*
+ * parent may be NULL
+ */
+extern void     addClassTree(ClTreeWriter * w, const char *name,
+                             const char *parent);
+/*
+ * writes dir/classTree and releases w
+ */
+extern int      writeClassTree(ClTreeWriter * w, const char *dir);
+
+/*
+ * returns 1 if cls is type or one of its subclasses, 0 if not and -1
+ * if there is no table for ns or it does not know both classes
+ */
+extern int      classTreeIsA(const char *ns, const char *cls,
+                             const char *type);
+
+#endif
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
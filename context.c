@@ -99,7 +99,7 @@ __cft_release(CMPIContext *ctx)
     propertyFT.release(c->entries);
     memUnlinkEncObj(c->mem_state);
     c->mem_state = MEM_RELEASED;
-    free(ctx);
+    memFree(ctx);
     CMReturn(CMPI_RC_OK);
   }
   CMReturn(CMPI_RC_ERR_FAILED);
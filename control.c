@@ -80,6 +80,8 @@ static Control init[] = {
   {"enableHttp", CTL_BOOL, NULL, {.b=1}},
   {"enableUds", CTL_BOOL,  NULL, {.b=1}},
   {"httpProcs", CTL_LONG, NULL, {.slong=8}},
+  {"httpWorkerModel", CTL_STRING, "fork", {0}},
+  {"httpWorkerMaxRequests", CTL_LONG, NULL, {.slong=1000}},
   {"httpsPort", CTL_LONG, NULL, {.slong=5989}},
   {"enableHttps", CTL_BOOL, NULL, {.b=0}},
   {"httpLocalOnly", CTL_BOOL, NULL, {.b=0}},
@@ -90,20 +92,35 @@ static Control init[] = {
   {"slpRefreshInterval", CTL_LONG, NULL, {.slong=600}},
 #endif
   {"provProcs", CTL_LONG, NULL, {.slong=32}},
+  {"providerRoutingCacheSize", CTL_LONG, NULL, {.slong=128}},
+  {"providerFanOut", CTL_LONG, NULL, {.slong=8}},
+  {"providerFanOutOrder", CTL_STRING, "provider", {0}},
+  {"socketPairPoolSize", CTL_LONG, NULL, {.slong=16}},
+  {"providerResultShm", CTL_BOOL, NULL, {.b=0}},
+  {"providerResultShmMinSize", CTL_LONG, NULL, {.slong=65536}},
   {"sfcbCustomLib", CTL_STRING, "sfcCustomLib", {0}},
   {"basicAuthLib", CTL_STRING, "sfcBasicAuthentication", {0}},
   {"basicAuthEntry", CTL_STRING, "_sfcBasicAuthenticate", {0}},
   {"doBasicAuth", CTL_BOOL, NULL, {.b=0}},
+  {"authCacheEntries", CTL_LONG, NULL, {.slong=256}},
+  {"authCachePassTTL", CTL_LONG, NULL, {.slong=60}},
+  {"authCacheFailTTL", CTL_LONG, NULL, {.slong=10}},
   {"doUdsAuth", CTL_BOOL, NULL, {.b=0}},
 
   {"useChunking", CTL_STRING, "true", {0}},
   {"chunkSize", CTL_LONG, NULL, {.slong=50000}},
   {"maxChunkObjCount", CTL_ULONG, NULL, {.ulong=0}},
 
+  {"pullOperationTimeout", CTL_LONG, NULL, {.slong=60}},
+  {"pullMaxOperationTimeout", CTL_LONG, NULL, {.slong=600}},
+  {"pullMaxObjectCount", CTL_LONG, NULL, {.slong=10000}},
+  {"pullMaxEnumerationContexts", CTL_LONG, NULL, {.slong=64}},
+
   {"trimWhitespace", CTL_BOOL, NULL, {.b=1}},
 
   {"keepaliveTimeout", CTL_LONG, NULL, {.slong=15}},
   {"keepaliveMaxRequest", CTL_LONG, NULL, {.slong=10}},
+  {"httpEventLoop", CTL_BOOL, NULL, {.b=0}},
   {"selectTimeout", CTL_LONG, NULL, {.slong=5}},
   {"maxBindAttempts", CTL_LONG, NULL, {.slong=8}},
 
@@ -112,6 +129,12 @@ static Control init[] = {
   {"providerAutoGroup", CTL_BOOL, NULL, {.b=1}},
   {"providerDefaultUserSFCB", CTL_BOOL, NULL, {.b=1}},
   {"providerDefaultUser", CTL_STRING, "", {0}},
+  {"providerThreads", CTL_LONG, NULL, {.slong=16}},
+  {"providerQueueDepth", CTL_LONG, NULL, {.slong=256}},
+  {"repositoryCompactThreshold", CTL_LONG, NULL, {.slong=50}},
+  {"classRepositoryImage", CTL_BOOL, NULL, {.b=0}},
+  {"compactInstanceResults", CTL_BOOL, NULL, {.b=1}},
+  {"useHeapArena", CTL_BOOL, NULL, {.b=1}},
 
   {"sslKeyFilePath", CTL_STRING, SFCB_CONFDIR "/file.pem", {0}},
   {"sslCertificateFilePath", CTL_STRING, SFCB_CONFDIR "/server.pem", {0}},
@@ -135,6 +158,8 @@ static Control init[] = {
   {"traceMask", CTL_LONG, NULL, {.slong=0}},
 
   {"httpMaxContentLength", CTL_UINT, NULL, {.uint=100000000}},
+  {"httpCompressionLevel", CTL_LONG, NULL, {.slong=6}},
+  {"httpCompressionMinSize", CTL_LONG, NULL, {.slong=1024}},
   {"validateMethodParamTypes", CTL_BOOL, NULL, {.b=0}},
   {"maxMsgLen", CTL_ULONG, NULL, {.ulong=10000000}},
   {"networkInterface", CTL_USTRING, NULL, {0}},
@@ -64,7 +64,7 @@ __dtft_release(CMPIDateTime *dt)
   if (ndt->mem_state && ndt->mem_state != MEM_RELEASED) {
     memUnlinkEncObj(ndt->mem_state);
     ndt->mem_state = MEM_RELEASED;
-    free(ndt);
+    memFree(ndt);
     CMReturn(CMPI_RC_OK);
   }
 
@@ -45,7 +45,7 @@ __eft_release(CMPIEnumeration *enumeration)
     e->data->ft->release(e->data);
     memUnlinkEncObj(e->mem_state);
     e->mem_state = MEM_RELEASED;
-    free(enumeration);
+    memFree(enumeration);
     CMReturn(CMPI_RC_OK);
   }
 
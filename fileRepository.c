@@ -27,8 +27,13 @@
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
 #include <dirent.h>
 #include <errno.h>
 
@@ -44,6 +49,77 @@ char           *repfn = NULL;
 
 #define BASE "repository"
 
+/*
+ * An index file has a base and a journal. The base is a header, the
+ * records in .inst file order, the record numbers sorted by key, and the
+ * keys; it is mmap'ed and searched binary. Keys are ordered case
+ * insensitively first, so that qualifier lookups ignoring case can use
+ * the same table.
+ *
+ * The .inst file and the journal are only appended to: an update adds the
+ * new blob and a put record, a delete just a delete record. Journal
+ * records are newer than the base and are looked at first. Once the
+ * journal gets long, or too much of the .inst file is dead, a background
+ * thread folds the journal into a new base, copying the live blobs to the
+ * next generation of the .inst file (<class>.<gen>) when needed. Writers
+ * serialize on a lock of the namespace directory, readers do not lock.
+ *
+ * Text index files of older versions are still read, and are replaced by
+ * a binary one when first opened.
+ */
+#define IDX_MAGIC "SFCBIDX\n"
+#define IDX_VERSION 2
+#define IDX_LOG_PUT 1
+#define IDX_LOG_DEL 2
+#define IDX_LOG_CHECK 0x5fcb10c5
+#define IDX_LOG_MAX 256         /* journal records before it is folded */
+#define IDX_COMPACT_MIN 65536   /* dead .inst bytes worth a compaction */
+
+#define IDX_CREATE 1
+#define IDX_LOCK 2
+
+#define IDX_ALIGN(l) (((l) + 7) & ~7UL)
+
+typedef struct idxHdr {
+  char            magic[8];
+  uint32_t        version,
+                  count,
+                  keySize,
+                  gen;          /* .inst file generation */
+  uint64_t        liveSize;     /* blob bytes of all records */
+} IdxHdr;
+
+typedef struct idxEnt {
+  uint64_t        blobOfs;
+  uint32_t        blobLen,
+                  keyOfs,       /* into the key area, keys are 0 terminated */
+                  keyLen,
+                  reserved;
+} IdxEnt;
+
+/*
+ * journal record, followed by the key, 0 terminated and padded to 8 
+ */
+typedef struct idxLogEnt {
+  uint32_t        op,
+                  keyLen;
+  uint64_t        blobOfs;
+  uint32_t        blobLen,
+                  check;        /* a record torn by a crash ends the journal */
+} IdxLogEnt;
+
+typedef struct idxLog {
+  int             op,
+                  live;         /* not superseded by a later record */
+  char           *key;
+  size_t          keyLen;
+  unsigned long   blobOfs,
+                  blobLen;
+} IdxLog;
+
+static pthread_mutex_t compactMtx = PTHREAD_MUTEX_INITIALIZER;
+static int      compacting = 0;
+
 #define fdHandleError(bi) \
    mlogf(M_ERROR,M_SHOW,"*** Repository error for %s\n",bi->fnd); \
    freeBlobIndex(&bi,1);
@@ -83,6 +159,7 @@ static int
 getIndexRecordCase(BlobIndex * bi, const char *key, size_t keyl,
                    char **keyb, size_t * keybl, short ignorecase)
 /*
+ * reads the next record of a text index,
  * returns -1 failure, 0 OK, 1 not found (only with key) 
  */
 {
@@ -248,11 +325,522 @@ getIndexRecordCase(BlobIndex * bi, const char *key, size_t keyl,
 }
 
 static int
-getIndexRecord(BlobIndex * bi, char *key, size_t keyl, char **keyb,
-               size_t * keybl)
+idxKeyCmp(const char *a, size_t al, const char *b, size_t bl,
+          short ignorecase)
 {
-  // use case-sensitive compare on the key
-  return getIndexRecordCase(bi, key, keyl, keyb, keybl, 0);
+  size_t          n = al < bl ? al : bl;
+  int             c = strncasecmp(a, b, n);
+
+  if (c == 0)
+    c = (al > bl) - (al < bl);
+  if (c == 0 && !ignorecase)
+    c = memcmp(a, b, n);
+  return c;
+}
+
+/*
+ * returns the position of key in sorted, or where it would be inserted;
+ * found is set if it is there 
+ */
+static unsigned long
+idxSearch(BlobIndex * bi, const char *key, size_t keyl, short ignorecase,
+          int *found)
+{
+  unsigned long   lo = 0,
+                  hi = bi->count,
+                  mid;
+  IdxEnt         *e;
+  int             c;
+
+  *found = 0;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    e = bi->ents + bi->sorted[mid];
+    c = idxKeyCmp(bi->keys + e->keyOfs, e->keyLen, key, keyl, ignorecase);
+    if (c < 0)
+      lo = mid + 1;
+    else {
+      if (c == 0)
+        *found = 1;
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/*
+ * make the base tables private and big enough for one more record 
+ */
+static void
+idxOwn(BlobIndex * bi, size_t keyl)
+{
+  IdxEnt         *ents;
+  uint32_t       *sorted;
+  char           *keys;
+
+  if (bi->maxCount == 0) {
+    bi->maxCount = bi->count + 16;
+    bi->maxKeySize = bi->keySize + keyl + 256;
+    ents = malloc(bi->maxCount * sizeof(*ents));
+    sorted = malloc(bi->maxCount * sizeof(*sorted));
+    keys = malloc(bi->maxKeySize);
+    if (bi->count) {
+      memcpy(ents, bi->ents, bi->count * sizeof(*ents));
+      memcpy(sorted, bi->sorted, bi->count * sizeof(*sorted));
+      memcpy(keys, bi->keys, bi->keySize);
+    }
+    bi->ents = ents;
+    bi->sorted = sorted;
+    bi->keys = keys;
+  }
+  if (bi->count == bi->maxCount) {
+    bi->maxCount *= 2;
+    bi->ents = realloc(bi->ents, bi->maxCount * sizeof(*bi->ents));
+    bi->sorted = realloc(bi->sorted, bi->maxCount * sizeof(*bi->sorted));
+  }
+  if (bi->keySize + keyl + 1 > bi->maxKeySize) {
+    bi->maxKeySize = (bi->keySize + keyl + 1) * 2;
+    bi->keys = realloc(bi->keys, bi->maxKeySize);
+  }
+}
+
+/*
+ * add a base record, idxSort() has to be called afterwards 
+ */
+static void
+idxAppend(BlobIndex * bi, const char *key, size_t keyl, unsigned long ofs,
+          unsigned long len)
+{
+  IdxEnt         *e;
+
+  idxOwn(bi, keyl);
+  e = bi->ents + bi->count;
+  e->blobOfs = ofs;
+  e->blobLen = len;
+  e->keyOfs = bi->keySize;
+  e->keyLen = keyl;
+  e->reserved = 0;
+  memcpy(bi->keys + bi->keySize, key, keyl);
+  bi->keys[bi->keySize + keyl] = 0;
+  bi->keySize += keyl + 1;
+  bi->sorted[bi->count] = bi->count;
+  bi->count++;
+}
+
+typedef struct idxSortEnt {
+  const char     *key;
+  size_t          keyl;
+  uint32_t        rec;
+} IdxSortEnt;
+
+static int
+idxSortCmp(const void *a, const void *b)
+{
+  const IdxSortEnt *x = a,
+      *y = b;
+  return idxKeyCmp(x->key, x->keyl, y->key, y->keyl, 0);
+}
+
+static void
+idxSort(BlobIndex * bi)
+{
+  IdxSortEnt     *se = malloc((bi->count + 1) * sizeof(*se));
+  unsigned long   i;
+
+  for (i = 0; i < bi->count; i++) {
+    se[i].key = bi->keys + bi->ents[i].keyOfs;
+    se[i].keyl = bi->ents[i].keyLen;
+    se[i].rec = i;
+  }
+  qsort(se, bi->count, sizeof(*se), idxSortCmp);
+  for (i = 0; i < bi->count; i++)
+    bi->sorted[i] = se[i].rec;
+  free(se);
+}
+
+/*
+ * replace base and journal by a base of the live records 
+ */
+static void
+idxMerge(BlobIndex * bi)
+{
+  IdxEnt         *ents = bi->ents;
+  char           *keys = bi->keys;
+  uint32_t       *sorted = bi->sorted;
+  unsigned long   count = bi->count,
+                  i;
+  int             owned = bi->maxCount != 0;
+  IdxLog         *l;
+
+  bi->count = bi->maxCount = bi->keySize = bi->maxKeySize = 0;
+  bi->ents = NULL;
+  bi->sorted = NULL;
+  bi->keys = NULL;
+
+  for (i = 0; i < count; i++)
+    if (bi->shadowed == NULL || bi->shadowed[i] == 0)
+      idxAppend(bi, keys + ents[i].keyOfs, ents[i].keyLen,
+                ents[i].blobOfs, ents[i].blobLen);
+  for (i = 0; i < bi->logCount; i++) {
+    l = bi->log + i;
+    if (l->live && l->op == IDX_LOG_PUT)
+      idxAppend(bi, l->key, l->keyLen, l->blobOfs, l->blobLen);
+  }
+  /* an empty base still needs its tables */
+  idxOwn(bi, 0);
+  idxSort(bi);
+
+  if (owned) {
+    free(ents);
+    free(sorted);
+    free(keys);
+  }
+  free(bi->shadowed);
+  free(bi->log);
+  bi->shadowed = NULL;
+  bi->log = NULL;
+  bi->logCount = 0;
+}
+
+static void
+idxSetRecord(BlobIndex * bi, unsigned long rec)
+{
+  bi->pos = rec;
+  if (rec < bi->count) {
+    bi->bofs = bi->ents[rec].blobOfs;
+    bi->blen = bi->ents[rec].blobLen;
+  } else {
+    bi->bofs = bi->log[rec - bi->count].blobOfs;
+    bi->blen = bi->log[rec - bi->count].blobLen;
+  }
+}
+
+/*
+ * next live record: base records not superseded, then journal puts 
+ */
+static int
+getIndexRecord(BlobIndex * bi, char **keyb, size_t * keybl)
+{
+  unsigned long   n;
+  IdxLog         *l;
+
+  for (; (n = bi->next) < bi->count + bi->logCount; bi->next++) {
+    if (n < bi->count) {
+      if (bi->shadowed && bi->shadowed[n])
+        continue;
+      if (keyb && keybl) {
+        *keyb = bi->keys + bi->ents[n].keyOfs;
+        *keybl = bi->ents[n].keyLen;
+      }
+    } else {
+      l = bi->log + (n - bi->count);
+      if (!l->live || l->op != IDX_LOG_PUT)
+        continue;
+      if (keyb && keybl) {
+        *keyb = l->key;
+        *keybl = l->keyLen;
+      }
+    }
+    idxSetRecord(bi, n);
+    bi->next++;
+    return 0;
+  }
+  return -1;
+}
+
+static char    *
+instFileName(BlobIndex * bi, unsigned long gen)
+{
+  size_t          l = strlen(bi->fnx) - 4;      /* without .idx */
+  char           *fn = malloc(l + 24);
+
+  memcpy(fn, bi->fnx, l);
+  fn[l] = 0;
+  if (gen)
+    sprintf(fn + l, ".%lu", gen);
+  return fn;
+}
+
+static int
+lockIndex(BlobIndex * bi)
+{
+  bi->lockFd = open(bi->dir, O_RDONLY);
+  if (bi->lockFd < 0)
+    return -1;
+  if (flock(bi->lockFd, LOCK_EX)) {
+    close(bi->lockFd);
+    return -1;
+  }
+  bi->locked = 1;
+  return 0;
+}
+
+static void
+unlockIndex(BlobIndex * bi)
+{
+  if (bi->locked) {
+    close(bi->lockFd);
+    bi->locked = 0;
+  }
+}
+
+/*
+ * write the base to a new file and replace the index, which may still be
+ * mapped; the journal has to be merged before 
+ */
+static int
+writeIndex(BlobIndex * bi)
+{
+  char           *xn = alloca(strlen(bi->dir) + 8);
+  static const char pad[8];
+  IdxHdr          hdr;
+  IdxEnt          e;
+  FILE           *x;
+  unsigned long   i,
+                  size;
+  int             rc = 0;
+
+  strcpy(xn, bi->dir);
+  strcat(xn, "idx");
+  x = fopen(xn, "wb");
+  if (x == NULL)
+    return -1;
+
+  memcpy(hdr.magic, IDX_MAGIC, sizeof(hdr.magic));
+  hdr.version = IDX_VERSION;
+  hdr.count = bi->count;
+  hdr.keySize = 0;
+  hdr.gen = bi->gen;
+  hdr.liveSize = 0;
+  for (i = 0; i < bi->count; i++) {
+    hdr.keySize += bi->ents[i].keyLen + 1;
+    hdr.liveSize += bi->ents[i].blobLen;
+  }
+  rc += fwrite(&hdr, sizeof(hdr), 1, x) - 1;
+
+  /* keys are written in record order, dropping the space of removed ones */
+  for (e.keyOfs = i = 0; i < bi->count; i++) {
+    e.blobOfs = bi->ents[i].blobOfs;
+    e.blobLen = bi->ents[i].blobLen;
+    e.keyLen = bi->ents[i].keyLen;
+    e.reserved = 0;
+    rc += fwrite(&e, sizeof(e), 1, x) - 1;
+    e.keyOfs += e.keyLen + 1;
+  }
+  if (bi->count)
+    rc += fwrite(bi->sorted, sizeof(*bi->sorted) * bi->count, 1, x) - 1;
+  for (i = 0; i < bi->count; i++)
+    rc += fwrite(bi->keys + bi->ents[i].keyOfs, bi->ents[i].keyLen + 1, 1,
+                 x) - 1;
+  /* the journal starts 8 byte aligned */
+  size = sizeof(hdr) + bi->count * (sizeof(e) + sizeof(uint32_t)) +
+      hdr.keySize;
+  if (IDX_ALIGN(size) > size)
+    rc += fwrite(pad, IDX_ALIGN(size) - size, 1, x) - 1;
+  rc += fclose(x);
+  if (rc == 0)
+    rc = rename(xn, bi->fnx);
+  if (rc)
+    remove(xn);
+  return rc;
+}
+
+/*
+ * read a text index of an older version and replace it by a binary one 
+ */
+static int
+readTextIndex(BlobIndex * bi)
+{
+  char           *kb;
+  size_t          kbl;
+  struct stat     st,
+                  xst;
+  int             locked = bi->locked;
+
+  bi->index = malloc(bi->dSize + 1);
+  if (bi->dSize && fread(bi->index, bi->dSize, 1, bi->fx) != 1) {
+    free(bi->index);
+    bi->index = NULL;
+    return -1;
+  }
+  bi->index[bi->dSize] = 0;
+
+  bi->next = 0;
+  while (getIndexRecordCase(bi, NULL, 0, &kb, &kbl, 0) == 0)
+    idxAppend(bi, kb, kbl, bi->bofs, bi->blen);
+  idxOwn(bi, 0);
+  idxSort(bi);
+  free(bi->index);
+  bi->index = NULL;
+  bi->next = 0;
+  bi->liveCount = bi->count;
+  for (kbl = 0; kbl < bi->count; kbl++)
+    bi->liveSize += bi->ents[kbl].blobLen;
+
+  /* convert unless somebody else did so meanwhile */
+  if (bi->count && (locked || lockIndex(bi) == 0)) {
+    if (fstat(fileno(bi->fx), &st) == 0 && stat(bi->fnx, &xst) == 0 &&
+        st.st_ino == xst.st_ino && writeIndex(bi))
+      mlogf(M_INFO, M_SHOW, "--- Unable to convert %s to binary index: %s\n",
+            bi->fnx, strerror(errno));
+    if (!locked)
+      unlockIndex(bi);
+  }
+  return 0;
+}
+
+/*
+ * FNV-1a of a journal key, for the replay in readLog
+ */
+static unsigned long
+logKeyHash(const char *key, unsigned long len)
+{
+  unsigned long   h = 2166136261UL;
+
+  while (len--)
+    h = (h ^ (unsigned char) *key++) * 16777619UL;
+  return h;
+}
+
+/*
+ * collect the journal following the base and mark what it supersedes;
+ * the last record of each key is found through a table of record
+ * numbers, so the replay takes one pass however often keys repeat
+ */
+static void
+readLog(BlobIndex * bi, unsigned long base)
+{
+  char           *p = bi->index + base,
+                 *end = bi->index + bi->dSize;
+  IdxLogEnt      *le;
+  IdxLog         *l;
+  unsigned long   i,
+                  j,
+                  max = 0,
+                  slot,
+                  mask,
+                 *last;
+  int             found;
+
+  while (p + sizeof(*le) <= end) {
+    le = (IdxLogEnt *) p;
+    if ((le->op != IDX_LOG_PUT && le->op != IDX_LOG_DEL) ||
+        le->check != (IDX_LOG_CHECK ^ le->op ^ le->keyLen ^ le->blobLen) ||
+        le->keyLen >= (unsigned long) (end - p) ||
+        p + IDX_ALIGN(sizeof(*le) + le->keyLen + 1) > end ||
+        p[sizeof(*le) + le->keyLen])
+      break;
+    if (bi->logCount == max) {
+      max = max ? max * 2 : 16;
+      bi->log = realloc(bi->log, max * sizeof(*bi->log));
+    }
+    l = bi->log + bi->logCount++;
+    l->op = le->op;
+    l->live = 1;
+    l->key = p + sizeof(*le);
+    l->keyLen = le->keyLen;
+    l->blobOfs = le->blobOfs;
+    l->blobLen = le->blobLen;
+    p += IDX_ALIGN(sizeof(*le) + le->keyLen + 1);
+  }
+  bi->logEnd = p - bi->index;
+  if (bi->logCount == 0)
+    return;
+
+  /* open addressing, at most half full; slots hold record number + 1 */
+  for (mask = 16; mask < bi->logCount * 2; mask *= 2);
+  last = calloc(mask--, sizeof(*last));
+  for (i = 0; i < bi->logCount; i++) {
+    l = bi->log + i;
+    for (slot = logKeyHash(l->key, l->keyLen) & mask; (j = last[slot]);
+         slot = (slot + 1) & mask) {
+      if (bi->log[j - 1].keyLen == l->keyLen &&
+          memcmp(bi->log[j - 1].key, l->key, l->keyLen) == 0) {
+        bi->log[j - 1].live = 0;
+        break;
+      }
+    }
+    last[slot] = i + 1;
+  }
+  free(last);
+
+  for (i = 0; i < bi->logCount; i++) {
+    l = bi->log + i;
+    if (!l->live)
+      continue;
+    slot = idxSearch(bi, l->key, l->keyLen, 0, &found);
+    if (found) {
+      if (bi->shadowed == NULL)
+        bi->shadowed = calloc(bi->count, 1);
+      bi->shadowed[bi->sorted[slot]] = 1;
+      bi->liveSize -= bi->ents[bi->sorted[slot]].blobLen;
+      bi->liveCount--;
+    }
+    if (l->op == IDX_LOG_PUT) {
+      bi->liveSize += l->blobLen;
+      bi->liveCount++;
+    }
+  }
+}
+
+static int
+readIndex(BlobIndex * bi)
+{
+  struct stat     st;
+  IdxHdr         *hdr;
+  char           *map;
+  unsigned long   base;
+
+  if (fstat(fileno(bi->fx), &st))
+    return -1;
+  bi->dSize = st.st_size;
+  if (bi->dSize < (int) sizeof(IdxHdr))
+    return readTextIndex(bi);
+
+  map = mmap(NULL, bi->dSize, PROT_READ, MAP_PRIVATE, fileno(bi->fx), 0);
+  if (map == MAP_FAILED)
+    return -1;
+  hdr = (IdxHdr *) map;
+  if (memcmp(hdr->magic, IDX_MAGIC, sizeof(hdr->magic))) {
+    munmap(map, bi->dSize);
+    return readTextIndex(bi);
+  }
+  base = IDX_ALIGN(sizeof(IdxHdr) +
+                   hdr->count * (sizeof(IdxEnt) + sizeof(uint32_t)) +
+                   hdr->keySize);
+  if (hdr->version > IDX_VERSION) {
+    mlogf(M_ERROR, M_SHOW,
+          "--- %s: index version %u written by a newer sfcb, %d supported\n",
+          bi->fnx, (unsigned) hdr->version, IDX_VERSION);
+    munmap(map, bi->dSize);
+    return -1;
+  }
+  if (hdr->version != IDX_VERSION || (unsigned long) bi->dSize < base) {
+    mlogf(M_ERROR, M_SHOW, "--- %s: unsupported or damaged index\n",
+          bi->fnx);
+    munmap(map, bi->dSize);
+    return -1;
+  }
+
+  bi->index = map;
+  bi->mapped = 1;
+  bi->count = bi->liveCount = hdr->count;
+  bi->keySize = hdr->keySize;
+  bi->liveSize = hdr->liveSize;
+  bi->ents = (IdxEnt *) (map + sizeof(IdxHdr));
+  bi->sorted = (uint32_t *) (bi->ents + bi->count);
+  bi->keys = (char *) (bi->sorted + bi->count);
+  if ((bi->gen = hdr->gen)) {
+    free(bi->fnd);
+    bi->fnd = instFileName(bi, bi->gen);
+  }
+  readLog(bi, base);
+
+  /* a writer must not append behind a torn record */
+  if (bi->locked && bi->logEnd < (unsigned long) bi->dSize &&
+      truncate(bi->fnx, bi->logEnd))
+    return -1;
+  return 0;
 }
 
 void
@@ -281,9 +869,20 @@ freeBlobIndex(BlobIndex ** bip, int all)
   }
   if (all)
     if (bi->index) {
-      free(bi->index);
+      if (bi->mapped)
+        munmap(bi->index, bi->dSize);
+      else
+        free(bi->index);
       bi->index = NULL;
     }
+  if (bi->maxCount) {
+    free(bi->ents);
+    free(bi->sorted);
+    free(bi->keys);
+  }
+  free(bi->shadowed);
+  free(bi->log);
+  unlockIndex(bi);
   bi->freed = -1;
   if (bi->fd)
     fclose(bi->fd);
@@ -296,21 +895,26 @@ freeBlobIndex(BlobIndex ** bip, int all)
 static int
 indxLocateCase(BlobIndex * bi, const char *key, short ignorecase)
 {
-  int             loc;
-  int             kl = strlen(key);
-  bi->next = 0;
-  while (bi->next < bi->dSize) {
-    loc = getIndexRecordCase(bi, key, kl, NULL, 0, ignorecase);
-    if (loc < 0) {
-      return 0;
-    } else if (loc == 0) {
-      /*
-       * found 
-       */
+  unsigned long   slot,
+                  i;
+  size_t          kl = strlen(key);
+  int             found;
+
+  /* the journal is newer than the base */
+  for (i = bi->logCount; i-- > 0;)
+    if (idxKeyCmp(bi->log[i].key, bi->log[i].keyLen, key, kl,
+                  ignorecase) == 0) {
+      if (bi->log[i].op != IDX_LOG_PUT)
+        return 0;
+      idxSetRecord(bi, bi->count + i);
       return 1;
     }
-  }
-  return 0;
+
+  slot = idxSearch(bi, key, kl, ignorecase, &found);
+  if (!found || (bi->shadowed && bi->shadowed[bi->sorted[slot]]))
+    return 0;
+  idxSetRecord(bi, bi->sorted[slot]);
+  return 1;
 }
 
 static int
@@ -326,7 +930,7 @@ getFirst(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
   char           *buf = NULL;
   bi->next = 0;
 
-  if (getIndexRecord(bi, NULL, 0, keyb, keybl) == 0) {
+  if (getIndexRecord(bi, keyb, keybl) == 0) {
     bi->fd = fopen(bi->fnd, "rb");
     if (bi->fd == NULL) {
       fdHandleError(bi);
@@ -351,7 +955,7 @@ getNext(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
 {
   char           *buf = NULL;
 
-  if (getIndexRecord(bi, NULL, 0, keyb, keybl) == 0) {
+  if (getIndexRecord(bi, keyb, keybl) == 0) {
     fseek(bi->fd, bi->bofs, SEEK_SET);
     buf = malloc(bi->blen + 8);
     fread(buf, bi->blen, 1, bi->fd);
@@ -368,107 +972,21 @@ getNext(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
   return (void *) buf;
 }
 
-static void
+static int
 copy(FILE * o, FILE * i, int len, unsigned long ofs)
 {
   char           *buf = malloc(len);
+  int             rc;
+
   fseek(i, ofs, SEEK_SET);
-  fread(buf, len, 1, i);
-  fwrite(buf, len, 1, o);
+  rc = fread(buf, len, 1, i) - 1;
+  rc += fwrite(buf, len, 1, o) - 1;
   free(buf);
+  return rc;
 }
 
 static int
-adjust(BlobIndex * bi, int pos, int adj)
-{
-  int             dp = pos,
-      l,
-      o,
-      sl;
-  char           *p,
-                 *r = NULL,
-      str[32];
-  while (dp < bi->dSize) {
-    memset(str, ' ', sizeof(str) - 1);
-    str[sizeof(str) - 1] = 0;
-    l = atoi(bi->index + dp);
-    for (p = bi->index + dp + l - 2; *p != ' '; p--)
-      if (*p == '\r')
-        r = p;
-    o = atoi(++p);
-    o -= adj;
-    sl = sprintf(str + (r - p), "%d", o);
-    memcpy(p, str + sl, r - p);
-    dp += l;
-  }
-  return 0;
-}
-
-static int
-rebuild(BlobIndex * bi, void *blob, int blen)
-{
-  int             ofs,
-                  len,
-                  xt = 0,
-                  dt = 0, 
-                  rc = 0;
-  char           *xn = alloca(strlen(bi->dir) + 8);
-  char           *dn = alloca(strlen(bi->dir) + 8);
-  FILE           *x,
-                 *d;
-
-  strcpy(xn, bi->dir);
-  strcat(xn, "idx");
-  strcpy(dn, bi->dir);
-  strcat(dn, "inst");
-  x = fopen(xn, "wb");
-  d = fopen(dn, "wb");
-
-  if (bi->bofs)
-    copy(d, bi->fd, bi->bofs, 0);
-  dt += bi->bofs;
-  len = bi->dlen - (bi->bofs + bi->blen);
-  if (len)
-    copy(d, bi->fd, bi->dlen - (bi->bofs + bi->blen), bi->bofs + bi->blen);
-  dt += len;
-  //pos = ftell(d);
-  if (blen)
-    rc = fwrite(blob,blen,1,d) - 1;
-  dt += blen;
-  rc += fclose(d);
-  if (rc != 0) return -1;
-
-
-  adjust(bi, bi->pos, bi->blen);
-
-  ofs = bi->pos + bi->len;
-  if (bi->pos)
-    rc += fwrite(bi->index, bi->pos, 1, x) - 1;
-  xt += bi->pos;
-  len = bi->dSize - ofs;
-  if (len)
-    rc += fwrite(bi->index + ofs, len, 1, x) - 1;
-  xt += len;
-  rc += fclose(x);
-  if (rc != 0) return -1;
-
-  remove(bi->fnd);
-  remove(bi->fnx);
-  if (dt)
-    rename(dn, bi->fnd);
-  else
-    remove(dn);
-  if (xt)
-    rename(xn, bi->fnx);
-  else
-    remove(xn);
-
-  return 0;
-}
-
-int
-getIndex(const char *ns, const char *cls, int elen, int mki,
-         BlobIndex ** bip)
+openIndex(const char *ns, const char *cls, int flags, BlobIndex ** bip)
 {
   BlobIndex      *bi;
   char           *fn;
@@ -503,123 +1021,253 @@ getIndex(const char *ns, const char *cls, int elen, int mki,
   strcat(fn, ".idx");
   bi->fnx = strdup(fn);
 
-  bi->fx = fopen(bi->fnx, "rb+");
+  if ((flags & IDX_LOCK) && lockIndex(bi)) {
+    mlogf(M_ERROR, M_SHOW, "*** Repository error locking %s: %s\n",
+          bi->dir, strerror(errno));
+    freeBlobIndex(&bi, 1);
+    *bip = NULL;
+    return 0;
+  }
+
+  bi->fx = fopen(bi->fnx, "rb");
   if (bi->fx == NULL) {
-    if (mki == 0) {
+    if ((flags & IDX_CREATE) == 0) {
       freeBlobIndex(&bi, 1);
       *bip = NULL;
       return 0;
     }
-    bi->fx = fopen(bi->fnx, "wb");
-    bi->aSize = elen;
-    bi->dSize = 0;
-    bi->index = malloc(bi->aSize);
   }
 
-  else {
-    fseek(bi->fx, 0, SEEK_END);
-    bi->dSize = ftell(bi->fx);
-    bi->aSize = bi->dSize + elen;
-    bi->index = malloc(bi->aSize);
-    fseek(bi->fx, 0, SEEK_SET);
-    fread(bi->index, bi->dSize, 1, bi->fx);
-    bi->index[bi->dSize] = 0;
+  else if (readIndex(bi)) {
+    mlogf(M_ERROR, M_SHOW, "*** Repository error for %s\n", bi->fnx);
+    freeBlobIndex(&bi, 1);
+    *bip = NULL;
+    return 0;
   }
   *bip = bi;
   return 1;
 }
 
 int
-addBlob(const char *ns, const char *cls, char *id, void *blob, int len)
+getIndex(const char *ns, const char *cls, int elen, int mki,
+         BlobIndex ** bip)
+{
+  int             rc = openIndex(ns, cls, mki ? IDX_CREATE : 0, bip);
+
+  if (rc)
+    (*bip)->aSize = elen;
+  return rc;
+}
+
+static int
+appendLog(BlobIndex * bi, int op, const char *key, unsigned long ofs,
+          unsigned long len)
+{
+  size_t          kl = strlen(key),
+                  size = IDX_ALIGN(sizeof(IdxLogEnt) + kl + 1);
+  char           *rec = calloc(1, size);
+  IdxLogEnt      *le = (IdxLogEnt *) rec;
+  FILE           *x;
+  int             rc;
+
+  le->op = op;
+  le->keyLen = kl;
+  le->blobOfs = ofs;
+  le->blobLen = len;
+  le->check = IDX_LOG_CHECK ^ le->op ^ le->keyLen ^ le->blobLen;
+  memcpy(rec + sizeof(*le), key, kl);
+
+  x = fopen(bi->fnx, "ab");
+  if (x == NULL) {
+    free(rec);
+    return -1;
+  }
+  rc = fwrite(rec, size, 1, x) - 1;
+  rc += fclose(x);
+  free(rec);
+  return rc;
+}
+
+static int
+compactThreshold()
+{
+  long            pct;
+
+  if (getControlNum("repositoryCompactThreshold", &pct))
+    pct = 50;
+  return pct;
+}
+
+/*
+ * fold the journal into a new base and, if enough of the .inst file is
+ * dead, copy the live blobs to the next generation of it 
+ */
+static int
+compactRepository(const char *ns, const char *cls)
 {
-  int             keyl =
-      strlen(ns) + strlen(cls) + strlen(id) + strlen(BASE);
-  int             es,
-                  ep,
-                  rc;
-  char           *idxe = alloca(keyl + 64);
   BlobIndex      *bi;
+  struct stat     st;
+  FILE           *d = NULL,
+                 *o = NULL;
+  char           *fn = NULL,
+                 *old;
+  unsigned long   dead,
+                  ofs = 0,
+                  i;
+  int             copyData,
+                  rc = 0;
 
-  rc = getIndex(ns, cls, keyl + 64, 1, &bi);
-  if (rc == 0)
-    return 1;
+  if (openIndex(ns, cls, IDX_LOCK, &bi) == 0)
+    return 0;
 
-  if (bi->dSize == 0) {
-    bi->fd = fopen(bi->fnd, "wb");
-    if (bi->fd == NULL) {
-      fdHandleError(bi);
-      return -1;
+  dead = stat(bi->fnd, &st) ? 0 : st.st_size - bi->liveSize;
+  copyData = dead >= IDX_COMPACT_MIN &&
+      dead * 100 > (unsigned long) st.st_size * compactThreshold();
+  if (!copyData && bi->logCount < IDX_LOG_MAX) {
+    freeBlobIndex(&bi, 1);
+    return 0;
+  }
+
+  idxMerge(bi);
+  if (copyData) {
+    fn = instFileName(bi, bi->gen + 1);
+    d = fopen(fn, "wb");
+    o = fopen(bi->fnd, "rb");
+    if (d == NULL || o == NULL)
+      rc = -1;
+    for (i = 0; rc == 0 && i < bi->count; i++) {
+      rc = copy(d, o, bi->ents[i].blobLen, bi->ents[i].blobOfs);
+      bi->ents[i].blobOfs = ofs;
+      ofs += bi->ents[i].blobLen;
     }
-    rc = fwrite(blob,len,1,bi->fd) - 1;  /* write the serialized instance */
-    rc += fclose(bi->fd);
-    bi->fd = NULL;
-    if (rc != 0) {
-      fdHandleError(bi); 
-      return -1; 
+    if (o)
+      fclose(o);
+    if (d && fclose(d))
+      rc = -1;
+    if (rc) {
+      remove(fn);
+      free(fn);
+      mlogf(M_ERROR, M_SHOW, "*** Repository error compacting %s\n",
+            bi->fnd);
+      freeBlobIndex(&bi, 1);
+      return -1;
     }
+    bi->gen++;
+  }
 
-    es = sprintf(idxe, "    %zd %s %d %d\r\n", strlen(id), id, len, 0);
-    ep = sprintf(idxe, "%d", es);
-    idxe[ep] = ' ';
-
-    memcpy(bi->index, idxe, es);
-    bi->dSize = es;
-    rc = fwrite(bi->index,bi->dSize,1,bi->fx) - 1;  /* write idx file */
-    rc += fclose(bi->fx);
-    bi->fx = NULL;
-    if (rc != 0) {
-      fdHandleError(bi); 
-      return -1; 
-    }
+  if (writeIndex(bi)) {
+    mlogf(M_ERROR, M_SHOW, "*** Repository error writing %s\n", bi->fnx);
+    if (fn)
+      remove(fn);
+    rc = -1;
   }
+  /* readers may still use the previous generation, drop the one before */
+  else if (fn && bi->gen >= 2) {
+    old = instFileName(bi, bi->gen - 2);
+    remove(old);
+    free(old);
+  }
+  free(fn);
+  freeBlobIndex(&bi, 1);
+  return rc;
+}
 
-  else {
+typedef struct compactParms {
+  char           *ns,
+                 *cls;
+} CompactParms;
 
-    if (indxLocate(bi,id)) { /* already have entries in the idx file; append */
-      bi->fd = fopen(bi->fnd, "rb");
-      if (bi->fd == NULL) {
-        fdHandleError(bi);
-        return -1;
-      } else {
-        fseek(bi->fd, 0, SEEK_END);
-        bi->dlen = ftell(bi->fd);
-        es = sprintf(idxe, "    %zd %s %d %lu\r\n", strlen(id), id, len,
-                     bi->dlen);
-        ep = sprintf(idxe, "%d", es);
-        idxe[ep] = ' ';
-        memcpy(bi->index + bi->dSize, idxe, es);
-        bi->dSize += es;
-        if (rebuild(bi,blob,len) != 0) { fdHandleError(bi); return -1; }
-      }
+static void    *
+compactThread(void *parms)
+{
+  CompactParms   *cp = (CompactParms *) parms;
+
+  compactRepository(cp->ns, cp->cls);
+  free(cp->ns);
+  free(cp->cls);
+  free(cp);
+  pthread_mutex_lock(&compactMtx);
+  compacting = 0;
+  pthread_mutex_unlock(&compactMtx);
+  return NULL;
+}
+
+/*
+ * start a compaction in the background once the journal is long or too
+ * much of the .inst file is dead; one at a time per process 
+ */
+static void
+compactIfNeeded(BlobIndex * bi, const char *ns, const char *cls,
+                unsigned long dataSize)
+{
+  unsigned long   dead = dataSize - bi->liveSize;
+  CompactParms   *cp;
+  pthread_t       t;
+  pthread_attr_t  tattr;
+
+  if (bi->logCount + 1 < IDX_LOG_MAX &&
+      (dead < IDX_COMPACT_MIN ||
+       dead * 100 <= dataSize * compactThreshold()))
+    return;
+
+  pthread_mutex_lock(&compactMtx);
+  if (compacting == 0) {
+    cp = malloc(sizeof(*cp));
+    cp->ns = strdup(ns);
+    cp->cls = strdup(cls);
+    pthread_attr_init(&tattr);
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&t, &tattr, compactThread, cp) == 0)
+      compacting = 1;
+    else {
+      free(cp->ns);
+      free(cp->cls);
+      free(cp);
     }
+    pthread_attr_destroy(&tattr);
+  }
+  pthread_mutex_unlock(&compactMtx);
+}
 
-    else { /* first entry in the idx file */
-      bi->fd = fopen(bi->fnd, "ab+");
-      if (bi->fd == NULL)
-        bi->fd = fopen(bi->fnd, "wb+");
-      fseek(bi->fd, 0, SEEK_END);
-      bi->fpos = ftell(bi->fd);
-      rc = fwrite(blob,len,1,bi->fd) - 1;
-      rc += fclose(bi->fd);
-      bi->fd = NULL;
-      if (rc != 0) {
-        fdHandleError(bi); 
-        return -1; 
-      }
+int
+addBlob(const char *ns, const char *cls, char *id, void *blob, int len)
+{
+  int             rc;
+  unsigned long   ofs;
+  BlobIndex      *bi;
 
-      es = sprintf(idxe, "    %zd %s %d %lu\r\n", strlen(id), id, len,
-                   bi->fpos);
-      ep = sprintf(idxe, "%d", es);
-      idxe[ep] = ' ';
-
-      memcpy(bi->index + bi->dSize, idxe, es);
-      bi->dSize += es;
-      fseek(bi->fx, 0, SEEK_SET);
-      rc = fwrite(bi->index,bi->dSize,1,bi->fx) - 1;
-      rc += fclose(bi->fx);
-      bi->fx = NULL;
+  rc = openIndex(ns, cls, IDX_CREATE | IDX_LOCK, &bi);
+  if (rc == 0)
+    return 1;
+
+  if (bi->fx == NULL) { /* new class, start with an empty base */
+    idxOwn(bi, 0);
+    if (writeIndex(bi) != 0) {
+      fdHandleError(bi);
+      return -1;
     }
   }
+
+  /* a replaced blob just becomes dead space */
+  bi->fd = fopen(bi->fnd, bi->fx ? "ab" : "wb");
+  if (bi->fd == NULL) {
+    fdHandleError(bi);
+    return -1;
+  }
+  fseek(bi->fd, 0, SEEK_END);
+  ofs = ftell(bi->fd);
+  rc = fwrite(blob,len,1,bi->fd) - 1;  /* write the serialized instance */
+  rc += fclose(bi->fd);
+  bi->fd = NULL;
+  if (rc != 0 || appendLog(bi, IDX_LOG_PUT, id, ofs, len) != 0) {
+    fdHandleError(bi); 
+    return -1; 
+  }
+
+  if (indxLocate(bi, id))
+    bi->liveSize -= bi->blen;
+  bi->liveSize += len;
+  compactIfNeeded(bi, ns, cls, ofs + len);
   freeBlobIndex(&bi, 1);
   return 0;
 }
@@ -627,26 +1275,36 @@ addBlob(const char *ns, const char *cls, char *id, void *blob, int len)
 int
 deleteBlob(const char *ns, const char *cls, const char *id)
 {
-  int             keyl =
-      strlen(ns) + strlen(cls) + strlen(id) + strlen(BASE);
   BlobIndex      *bi;
+  struct stat     st;
+  char           *fn;
   int             rc;
 
-  rc = getIndex(ns, cls, keyl + 64, 0, &bi);
+  rc = openIndex(ns, cls, IDX_LOCK, &bi);
 
   if (rc) {
     if (indxLocate(bi, id)) {
-      bi->fd = fopen(bi->fnd, "rb");
-      if (bi->fd == NULL) {
-        fdHandleError(bi);
-        return -1;
-      } else {
-        fseek(bi->fd, 0, SEEK_END);
-        bi->dlen = ftell(bi->fd);
-        if (rebuild(bi,NULL,0) != 0) { fdHandleError(bi); return -1; }
-        freeBlobIndex(&bi, 1);
-        return 0;
+      if (bi->liveCount == 1) { /* last one, drop the class files */
+        remove(bi->fnx);
+        remove(bi->fnd);
+        if (bi->gen) {
+          fn = instFileName(bi, bi->gen - 1);
+          remove(fn);
+          free(fn);
+        }
       }
+
+      else {
+        if (appendLog(bi, IDX_LOG_DEL, id, 0, 0) != 0) {
+          fdHandleError(bi);
+          return -1;
+        }
+        bi->liveSize -= bi->blen;
+        if (stat(bi->fnd, &st) == 0)
+          compactIfNeeded(bi, ns, cls, st.st_size);
+      }
+      freeBlobIndex(&bi, 1);
+      return 0;
     }
   }
   freeBlobIndex(&bi, 1);
@@ -19,6 +19,7 @@
  *
  */
 #include <stdio.h>
+#include <stdint.h>
 #include <sfcCommon/utilft.h>
 
 #ifndef _FILEREPOSITORY_
@@ -44,6 +45,23 @@ typedef struct blobIndex {
                   next;
   unsigned long   fpos;
   unsigned long   dlen;
+  int             mapped,       /* index is an mmap'ed binary index file */
+                  locked,
+                  lockFd;       /* namespace directory, held by writers */
+  unsigned long   count,        /* base records in ents and sorted */
+                  maxCount,     /* allocated, 0 if they point into index */
+                  keySize,
+                  maxKeySize;
+  struct idxEnt  *ents;         /* records in .inst file order */
+  uint32_t       *sorted;       /* record numbers in key order */
+  char           *keys;
+  unsigned char  *shadowed;     /* base records superseded by the journal */
+  struct idxLog  *log;          /* journal records following the base */
+  unsigned long   logCount,
+                  logEnd,       /* end of the intact journal */
+                  gen,          /* .inst file generation */
+                  liveSize,
+                  liveCount;
 } BlobIndex;
 
 #define NEW(td) (td*)calloc(sizeof(td),1)
@@ -38,6 +38,7 @@
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <zlib.h>
 
 #include "cmpi/cmpidt.h"
 #include "msgqueue.h"
@@ -65,9 +66,14 @@
 #include <sys/resource.h>
 
 #include "httpComm.h"
+#include "authCache.h"
 #include "sfcVersion.h"
 #include "control.h"
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #ifdef HAVE_UDS
 #include <grp.h>
 #endif
@@ -90,6 +96,17 @@ static int      doFork = 0;
 #define CHUNK_FORCE 2
 int chunkMode = CHUNK_ALLOW;
 
+/* Content-Encoding of the response, from the request's Accept-Encoding */
+#define ENC_IDENTITY 0
+#define ENC_GZIP     1
+#define ENC_DEFLATE  2
+static int      respEncoding = ENC_IDENTITY;
+static const char *encNames[] = { NULL, "gzip", "deflate" };
+static long     compressLevel = 6;
+static long     compressMinSize = 1024;
+static z_stream respStream;     /* deflating a chunked response */
+static int      respDeflating = 0;
+
 int             sfcbSSLMode = 0;        /* used as a global sslMode */
 int             httpLocalOnly = 0;      /* 1 = only listen on loopback
                                          * interface */
@@ -100,7 +117,45 @@ static int      running = 0;
 static long     keepaliveTimeout = 15;
 static long     keepaliveMaxRequest = 10;
 static long     numRequest;
+static int      preFork = 0;    /* httpWorkerModel: prefork */
+static long     workerMaxRequests = 1000;
+static long     workerRequests = 0;
+static pid_t   *workerPids = NULL;
+
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ * Connections parked in the HTTP daemon's event loop (httpEventLoop),
+ * indexed by socket. A request processor is only forked once a
+ * complete request header is waiting on the connection.
+ */
+typedef struct idleConn {
+  int             state;
+  pid_t           pid;          /* request processor serving it */
+  long            requests;     /* requests served on this connection */
+  time_t          deadline;     /* closed when idle past this */
+} IdleConn;
+
+#define IC_UNUSED 0
+#define IC_IDLE   1
+#define IC_BUSY   2
+#define IC_KEEP   3             /* request processor done, keep connection */
+#define IC_CLOSE  4             /* request processor done, close connection */
+
+/* request processor exit status asking to keep the connection */
+#define KEEPALIVE_EXIT 3
+
+static int      useEventLoop = 0;
+static int      eventFd = -1;
+static IdleConn *idleConns = NULL;
+static int      idleConnsMax = 0;
+static long     connRequests = 0;
+static pid_t    lastRequestProc = 0;
+static void     leaveEventLoop(int keepFd);
+#endif
 static long     selectTimeout = 5; /* default 5 sec. timeout for select() before read() */
+/* bytes read past the end of the last request, the start of the next one */
+static char    *pendingInput = NULL;
+static unsigned int pendingLength = 0;
 struct timeval  httpSelectTimeout = { 0, 0 };   
 
 #if defined USE_SSL
@@ -206,7 +261,8 @@ typedef struct _buffer {
   unsigned long   wait_time;
   unsigned int    header_length;
   unsigned int    content_length;
-  int             trailers;
+  int             trailers,
+                  chunked;      /* Transfer-Encoding: chunked */
   char           *httpHdr,
                  *authorization,
                  *content_type,
@@ -280,6 +336,8 @@ remProcCtl()
 {
   semctl(httpProcSem, 0, IPC_RMID, 0);
   semctl(httpWorkSem, 0, IPC_RMID, 0);
+  removeAuthCache();
+  stopEnumCtxHolders();
   return 0;
 }
 
@@ -299,6 +357,7 @@ baValidate(char *cred, char **principal)
   char            dlName[512];
   int             ret = AUTH_FAIL;
   char *entry;
+  const char     *host;
 
   if (strncasecmp(cred, "basic ", 6))
     return AUTH_FAIL;
@@ -331,6 +390,13 @@ baValidate(char *cred, char **principal)
   }
   else {
     *principal = strdup(auth);
+    /* the client address only matters to authenticate2 */
+    host = authenticate2 ? extras.clientIp : NULL;
+    if (getAuthCache(auth, pw, host, &ret, &extras.role)) {
+      free(auth);
+      return ret;
+    }
+
     if (authenticate2)
       ret = authenticate2(auth, pw, &extras);
     else 
@@ -341,6 +407,15 @@ baValidate(char *cred, char **principal)
     else if (ret == AUTH_SERVTEMP)  ret = AUTH_SERVTEMP;
     else if (ret == AUTH_SERVPERM)  ret = AUTH_SERVPERM;
     else  ret = AUTH_FAIL;
+
+    /*
+     * expired passwords and server trouble are not remembered, nor are
+     * failures the library explained
+     */
+    if (ret == AUTH_PASS)
+      putAuthCache(auth, pw, host, ret, extras.role, 1);
+    else if (ret == AUTH_FAIL && extras.ErrorDetail == NULL)
+      putAuthCache(auth, pw, host, ret, NULL, 0);
   }
 
   free(auth);
@@ -353,6 +428,7 @@ handleSigChld(int __attribute__ ((unused)) sig)
   const int       oerrno = errno;
   pid_t           pid;
   int             status;
+  long            i;
 
   for (;;) {
     pid = wait4(0, &status, WNOHANG, NULL);
@@ -368,6 +444,17 @@ handleSigChld(int __attribute__ ((unused)) sig)
       break;
     } else {
       running--;
+      if (workerPids)
+        for (i = 0; i < hMax; i++)
+          if (workerPids[i] == pid)
+            workerPids[i] = 0;
+#ifdef HAVE_SYS_EPOLL_H
+      for (i = 0; i < idleConnsMax; i++)
+        if (idleConns[i].state == IC_BUSY && idleConns[i].pid == pid)
+          idleConns[i].state = (WIFEXITED(status) &&
+                                WEXITSTATUS(status) == KEEPALIVE_EXIT) ?
+              IC_KEEP : IC_CLOSE;
+#endif
       // fprintf(stderr, "%s: SIGCHLD signal %d - %s(%d)\n", name, pid,
       // __FILE__, __LINE__);
     }
@@ -379,6 +466,7 @@ static void
 stopProc()
 {
   // printf("--- %s draining %d\n",processName,running);
+  stopEnumCtxHolders();
   for (;;) {
     if (running == 0) {
       mlogf(M_INFO, M_SHOW, "--- %s terminating %d\n", processName,
@@ -403,6 +491,16 @@ handleSigUsr1(int __attribute__ ((unused)) sig)
   }
 }
 
+/*
+ * prefork request processors finish the current connection and
+ * leave, the HTTP daemon waits for them in stopProc()
+ */
+static void
+handleWorkerSigUsr1(int __attribute__ ((unused)) sig)
+{
+  stopAccepting = 1;
+}
+
 static void handleSigUsr2(int __attribute__ ((unused)) sig)
 {
 #ifndef LOCAL_CONNECT_ONLY_ENABLE
@@ -421,6 +519,13 @@ static void handleSigUsr2(int __attribute__ ((unused)) sig)
 #endif // LOCAL_CONNECT_ONLY_ENABLE
 }
 
+/* forget all remembered authentication results */
+static void
+handleSigHup(int __attribute__ ((unused)) sig)
+{
+  flushAuthCache();
+}
+
 static void handleSigPipe(int __attribute__ ((unused)) sig)
 {
   exit(1);
@@ -429,7 +534,7 @@ static void handleSigPipe(int __attribute__ ((unused)) sig)
 static void
 freeBuffer(Buffer * b)
 {
-  Buffer emptyBuf = { NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, NULL, NULL,
+  Buffer emptyBuf = { NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0, NULL, NULL,
                       NULL, NULL, NULL, NULL, NULL, NULL };
   if (b->data)
     free(b->data);
@@ -477,6 +582,21 @@ add2buffer(Buffer * b, char *str, size_t len)
   (b->data)[b->length] = 0;
 }
 
+/*
+ * keeps bytes read past the end of a request for the next getHdrs()
+ */
+static void
+keepPending(const char *from, unsigned int len)
+{
+  free(pendingInput);
+  pendingInput = NULL;
+  pendingLength = len;
+  if (len) {
+    pendingInput = malloc(len);
+    memcpy(pendingInput, from, len);
+  }
+}
+
 static void
 genError(CommHndl conn_fd, Buffer * b, int status, char *title, char *more)
 {
@@ -561,9 +681,9 @@ getPayload(CommHndl conn_fd, Buffer * b)
   int             rc = 0;
 
   if (c > b->content_length) {
-    mlogf(M_INFO, M_SHOW,
-          "--- HTTP Content-Length is lying; rejecting, %d %d\n", c, b->content_length);
-    return -1;
+    /* a pipelined request follows */
+    keepPending(b->data + b->ptr + b->content_length, c - b->content_length);
+    c = b->content_length;
   }
 
   b->content = malloc(b->content_length + 8);
@@ -575,6 +695,141 @@ getPayload(CommHndl conn_fd, Buffer * b)
   return rc;
 }
 
+/*
+ * reads a chunked request body, taking what getHdrs() read past the
+ * headers first; the body grows with the chunks, so maxLen is enforced
+ * as they arrive rather than up front
+ */
+typedef struct chunkReader {
+  CommHndl        conn_fd;
+  char           *cur,
+                 *end;
+  char            buf[4096];
+} ChunkReader;
+
+static int
+fillChunkReader(ChunkReader * r)
+{
+  fd_set          httpfds;
+  int             n,
+                  isReady;
+
+  for (;;) {
+#ifdef USE_SSL
+    if (r->conn_fd.ssl && SSL_pending(r->conn_fd.ssl))
+      isReady = 1;
+    else
+#endif
+    {
+      FD_ZERO(&httpfds);
+      FD_SET(r->conn_fd.socket, &httpfds);
+      isReady = select(r->conn_fd.socket + 1, &httpfds, NULL, NULL,
+                       &httpSelectTimeout);
+    }
+    if (isReady == 0)
+      return -1;
+    n = commRead(r->conn_fd, r->buf, sizeof(r->buf));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (n <= 0)
+      return -1;
+    r->cur = r->buf;
+    r->end = r->buf + n;
+    return n;
+  }
+}
+
+static int
+readChunkLine(ChunkReader * r, char *line, int max)
+{
+  int             l = 0;
+  char            c;
+
+  for (;;) {
+    if (r->cur == r->end && fillChunkReader(r) < 0)
+      return -1;
+    c = *r->cur++;
+    if (c == '\n')
+      break;
+    if (l < max - 1)
+      line[l++] = c;
+  }
+  if (l && line[l - 1] == '\r')
+    l--;
+  line[l] = 0;
+  return l;
+}
+
+static int
+readChunkData(ChunkReader * r, char *into, unsigned int length)
+{
+  unsigned int    n = r->end - r->cur;
+
+  if (n > length)
+    n = length;
+  memcpy(into, r->cur, n);
+  r->cur += n;
+  if (n < length && readData(r->conn_fd, into + n, length - n) < 0)
+    return -1;
+  return 0;
+}
+
+/*
+ * returns -1 on read or format errors and -2 if the body exceeds maxLen
+ */
+static int
+getChunkedPayload(CommHndl conn_fd, Buffer * b, unsigned int maxLen)
+{
+  ChunkReader     r;
+  char            line[256],
+                 *e;
+  unsigned long   size,
+                  total = 0,
+                  alloc = 0;
+
+  r.conn_fd = conn_fd;
+  r.cur = b->data + b->ptr;
+  r.end = b->data + b->length;
+  b->ptr = b->length;
+
+  for (;;) {
+    if (readChunkLine(&r, line, sizeof(line)) < 0)
+      return -1;
+    errno = 0;
+    size = strtoul(line, &e, 16);
+    if (e == line || errno || (*e && *e != ';' && *e != ' ' && *e != '\t'))
+      return -1;
+    if (size == 0)
+      break;
+    if (size > maxLen || total + size > maxLen)
+      return -2;
+    if (total + size + 8 > alloc) {
+      alloc = total + size + 8 > alloc * 2 ? total + size + 8 : alloc * 2;
+      if (alloc > (unsigned long) maxLen + 8)
+        alloc = (unsigned long) maxLen + 8;
+      b->content = realloc(b->content, alloc);
+    }
+    if (readChunkData(&r, b->content + total, size) ||
+        readChunkLine(&r, line, sizeof(line)) != 0)
+      return -1;
+    total += size;
+  }
+
+  /* skip trailers */
+  do {
+    if (readChunkLine(&r, line, sizeof(line)) < 0)
+      return -1;
+  } while (*line);
+  /* a pipelined request may follow */
+  keepPending(r.cur, r.end - r.cur);
+
+  if (b->content == NULL)
+    b->content = malloc(8);
+  b->content[total] = 0;
+  b->content_length = total;
+  return total;
+}
+
 void
 dumpResponse(RespSegments * rs)
 {
@@ -593,6 +848,136 @@ dumpResponse(RespSegments * rs)
   }
 }
 
+/*
+ * picks the Content-Encoding for the response: gzip if acceptable,
+ * else deflate, else none 
+ */
+static int
+acceptEncoding(const char *val)
+{
+  const char     *p = val,
+                 *e,
+                 *s;
+  size_t          n;
+  int             ok,
+                  gzip = -1,
+                  deflate = -1,
+                  any = -1;
+
+  while (*p) {
+    p += strspn(p, " \t,");
+    if (*p == 0)
+      break;
+    n = strcspn(p, " \t;,");
+    e = p + n + strcspn(p + n, ",");
+    ok = 1;
+    for (s = p + n; (s = memchr(s, ';', e - s)) != NULL;) {
+      s++;
+      s += strspn(s, " \t");
+      if ((*s == 'q' || *s == 'Q') && s[1] == '=')
+        ok = strtod(s + 2, NULL) > 0;
+    }
+    if ((n == 4 && strncasecmp(p, "gzip", 4) == 0) ||
+        (n == 6 && strncasecmp(p, "x-gzip", 6) == 0))
+      gzip = ok;
+    else if (n == 7 && strncasecmp(p, "deflate", 7) == 0)
+      deflate = ok;
+    else if (n == 1 && *p == '*')
+      any = ok;
+    p = e;
+  }
+
+  if (gzip == 1 || (gzip < 0 && any == 1))
+    return ENC_GZIP;
+  if (deflate == 1)
+    return ENC_DEFLATE;
+  return ENC_IDENTITY;
+}
+
+static int
+startDeflate(z_stream * zs)
+{
+  memset(zs, 0, sizeof(*zs));
+  return deflateInit2(zs, compressLevel, Z_DEFLATED,
+                      respEncoding == ENC_GZIP ? 15 + 16 : 15, 8,
+                      Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+static void
+deflateBlock(z_stream * zs, const char *data, unsigned int len, int flush,
+             UtilStringBuffer * out)
+{
+  char            buf[16384];
+
+  zs->next_in = (Bytef *) data;
+  zs->avail_in = len;
+  do {
+    zs->next_out = (Bytef *) buf;
+    zs->avail_out = sizeof(buf);
+    deflate(zs, flush);
+    if (zs->avail_out < sizeof(buf))
+      out->ft->appendBlock(out, buf, sizeof(buf) - zs->avail_out);
+  } while (zs->avail_out == 0);
+}
+
+#define IOV_ADD(iov,n,p,l) { (iov)[n].iov_base = (void *) (p); \
+                             (iov)[(n)++].iov_len = (l); }
+
+/*
+ * adds the segments of a response to iov, without copying them 
+ */
+static int
+addSegments(struct iovec *iov, int n, RespSegments * rs, int *ls)
+{
+  int             i;
+
+  for (i = 0; i < 7; i++) {
+    if (rs->segments[i].txt && ls[i]) {
+      if (rs->segments[i].mode == 2) {
+        UtilStringBuffer *sb = (UtilStringBuffer *) rs->segments[i].txt;
+        IOV_ADD(iov, n, sb->ft->getCharPtr(sb), ls[i]);
+      } else
+        IOV_ADD(iov, n, rs->segments[i].txt, ls[i]);
+    }
+  }
+  return n;
+}
+
+static void
+releaseSegments(RespSegments * rs)
+{
+  int             i;
+
+  for (i = 0; i < 7; i++) {
+    if (rs->segments[i].txt) {
+      if (rs->segments[i].mode == 2) {
+        UtilStringBuffer *sb = (UtilStringBuffer *) rs->segments[i].txt;
+        sb->ft->release(sb);
+      } else if (rs->segments[i].mode == 1)
+        free(rs->segments[i].txt);
+    }
+  }
+}
+
+/*
+ * compresses and releases the segments of a response 
+ */
+static UtilStringBuffer *
+deflateSegments(z_stream * zs, RespSegments * rs, int *ls, int len,
+                int flush)
+{
+  UtilStringBuffer *out = UtilFactory->newStrinBuffer(len / 4 + 64);
+  struct iovec    iov[7];
+  int             i,
+                  n = addSegments(iov, 0, rs, ls);
+
+  for (i = 0; i < n; i++)
+    deflateBlock(zs, iov[i].iov_base, iov[i].iov_len, Z_NO_FLUSH, out);
+  deflateBlock(zs, NULL, 0, flush, out);
+  releaseSegments(rs);
+  return out;
+}
+
 static void
 write100ContResponse(CommHndl conn_fd)
 {
@@ -619,10 +1004,15 @@ writeResponse(CommHndl conn_fd, RespSegments rs)
   static char     op[] = { "CIMOperation: MethodResponse\r\n" };
   static char     cclose[] = "Connection: close\r\n";
   static char     end[] = { "\r\n" };
-  char            str[256];
+  char            str[256],
+                  enc[64];
   int             len,
                   i,
+                  n = 0,
                   ls[8];
+  struct iovec    iov[16];
+  z_stream        zs;
+  UtilStringBuffer *zb = NULL;
 
   _SFCB_ENTER(TRACE_HTTPDAEMON, "writeResponse");
 
@@ -639,29 +1029,40 @@ writeResponse(CommHndl conn_fd, RespSegments rs)
     }
   }
 
-  commWrite(conn_fd, head, strlen(head));
-  commWrite(conn_fd, cont, strlen(cont));
-  sprintf(str, "Content-Length: %d\r\n", len);
-  commWrite(conn_fd, str, strlen(str));
-  commWrite(conn_fd, cach, strlen(cach));
-  commWrite(conn_fd, op, strlen(op));
+  if (respEncoding && compressLevel > 0 && len >= compressMinSize &&
+      startDeflate(&zs)) {
+    zb = deflateSegments(&zs, &rs, ls, len, Z_FINISH);
+    deflateEnd(&zs);
+    _SFCB_TRACE(1, ("--- response deflated from %d to %d bytes", len,
+                    zb->ft->getSize(zb)));
+    len = zb->ft->getSize(zb);
+  }
+
+  /* headers and body leave in a single writev() */
+  IOV_ADD(iov, n, head, sizeof(head) - 1);
+  IOV_ADD(iov, n, cont, sizeof(cont) - 1);
+  if (zb) {
+    IOV_ADD(iov, n, enc, snprintf(enc, sizeof(enc),
+                                  "Content-Encoding: %s\r\n",
+                                  encNames[respEncoding]));
+  }
+  IOV_ADD(iov, n, str, snprintf(str, sizeof(str),
+                                "Content-Length: %d\r\n", len));
+  IOV_ADD(iov, n, cach, sizeof(cach) - 1);
+  IOV_ADD(iov, n, op, sizeof(op) - 1);
   if (keepaliveTimeout == 0 || numRequest >= keepaliveMaxRequest) {
-    commWrite(conn_fd, cclose, strlen(cclose));
+    IOV_ADD(iov, n, cclose, sizeof(cclose) - 1);
   }
-  commWrite(conn_fd, end, strlen(end));
+  IOV_ADD(iov, n, end, sizeof(end) - 1);
 
-  for (len = 0, i = 0; i < 7; i++) {
-    if (rs.segments[i].txt) {
-      if (rs.segments[i].mode == 2) {
-        UtilStringBuffer *sb = (UtilStringBuffer *) rs.segments[i].txt;
-        commWrite(conn_fd, (void *) sb->ft->getCharPtr(sb), ls[i]);
-        sb->ft->release(sb);
-      } else {
-        commWrite(conn_fd, rs.segments[i].txt, ls[i]);
-        if (rs.segments[i].mode == 1)
-          free(rs.segments[i].txt);
-      }
-    }
+  if (zb) {
+    IOV_ADD(iov, n, zb->ft->getCharPtr(zb), len);
+    commWritev(conn_fd, iov, n);
+    zb->ft->release(zb);
+  } else {
+    n = addSegments(iov, n, &rs, ls);
+    commWritev(conn_fd, iov, n);
+    releaseSegments(&rs);
   }
 
   commFlush(conn_fd);
@@ -681,19 +1082,35 @@ writeChunkHeaders(BinRequestContext * ctx)
   static char     trls[] =
       { "Trailer: CIMError, CIMStatusCode, CIMStatusCodeDescription, SFCBErrorDetail\r\n" };
   static char     cclose[] = "Connection: close\r\n";
+  char            str[256];
+  struct iovec    iov[8];
+  int             n = 0;
 
   _SFCB_ENTER(TRACE_HTTPDAEMON, "writeChunkHeaders");
 
-  commWrite(*(ctx->commHndl), head, strlen(head));
-  commWrite(*(ctx->commHndl), cont, strlen(cont));
-  commWrite(*(ctx->commHndl), cach, strlen(cach));
-  commWrite(*(ctx->commHndl), op, strlen(op));
-  commWrite(*(ctx->commHndl), tenc, strlen(tenc));
-  commWrite(*(ctx->commHndl), trls, strlen(trls));
+  /*
+   * the size is not known up front, so httpCompressionMinSize does not
+   * apply; one stream spans all chunks 
+   */
+  if (respDeflating)
+    deflateEnd(&respStream);
+  respDeflating = respEncoding && compressLevel > 0 &&
+      startDeflate(&respStream);
+
+  IOV_ADD(iov, n, head, sizeof(head) - 1);
+  IOV_ADD(iov, n, cont, sizeof(cont) - 1);
+  IOV_ADD(iov, n, cach, sizeof(cach) - 1);
+  IOV_ADD(iov, n, op, sizeof(op) - 1);
+  IOV_ADD(iov, n, tenc, sizeof(tenc) - 1);
+  if (respDeflating) {
+    IOV_ADD(iov, n, str, sprintf(str, "Content-Encoding: %s\r\n",
+                                 encNames[respEncoding]));
+  }
+  IOV_ADD(iov, n, trls, sizeof(trls) - 1);
   if (keepaliveTimeout == 0 || numRequest >= keepaliveMaxRequest) {
-    commWrite(*(ctx->commHndl), cclose, strlen(cclose));
+    IOV_ADD(iov, n, cclose, sizeof(cclose) - 1);
   }
-  commFlush(*(ctx->commHndl));
+  commWritev(*(ctx->commHndl), iov, n);
 
   _SFCB_EXIT();
 }
@@ -703,9 +1120,13 @@ writeChunkResponse(BinRequestContext * ctx, BinResponseHdr * rh)
 {
   int             i,
                   len,
+                  last,
+                  n = 0,
                   ls[8];
   char            str[256];
+  struct iovec    iov[8];
   RespSegments    rs;
+  UtilStringBuffer *zb = NULL;
   _SFCB_ENTER(TRACE_HTTPDAEMON, "writeChunkResponse");
   switch (ctx->chunkedMode) {
   case 1:
@@ -739,6 +1160,7 @@ writeChunkResponse(BinRequestContext * ctx, BinResponseHdr * rh)
     }
     break;
   }
+  last = (rh->moreChunks == 0 && ctx->pDone >= ctx->pCount);
 
   if (rh->rc == 1) {
 
@@ -754,38 +1176,57 @@ writeChunkResponse(BinRequestContext * ctx, BinResponseHdr * rh)
           len += ls[i] = strlen(rs.segments[i].txt);
       }
     }
+    /*
+     * every chunk is flushed, so clients can inflate it as it arrives 
+     */
+    if (respDeflating) {
+      zb = deflateSegments(&respStream, &rs, ls, len,
+                           last ? Z_FINISH : Z_SYNC_FLUSH);
+      len = zb->ft->getSize(zb);
+      if (last) {
+        deflateEnd(&respStream);
+        respDeflating = 0;
+      }
+    }
     /*
      * make sure we do not have a 0 len , this would 
      * indicate the end of the chunk data. 
      */
     if (len != 0) {
-      sprintf(str, "\r\n%x\r\n", len);
-      commWrite(*(ctx->commHndl), str, strlen(str));
+      IOV_ADD(iov, n, str, sprintf(str, "\r\n%x\r\n", len));
       _SFCB_TRACE(1, ("---  writeChunkResponse chunk amount %x ", len));
     }
 
-    for (len = 0, i = 0; i < 7; i++) {
-      if (rs.segments[i].txt) {
-        if (rs.segments[i].mode == 2) {
-          UtilStringBuffer *sb = (UtilStringBuffer *) rs.segments[i].txt;
-          commWrite(*(ctx->commHndl), (void *) sb->ft->getCharPtr(sb),
-                    ls[i]);
-          sb->ft->release(sb);
-        } else {
-          commWrite(*(ctx->commHndl), rs.segments[i].txt, ls[i]);
-          if (rs.segments[i].mode == 1)
-            free(rs.segments[i].txt);
-        }
-
-      }
+    if (zb) {
+      if (len)
+        IOV_ADD(iov, n, zb->ft->getCharPtr(zb), len);
+      commWritev(*(ctx->commHndl), iov, n);
+      zb->ft->release(zb);
+    } else {
+      n = addSegments(iov, n, &rs, ls);
+      commWritev(*(ctx->commHndl), iov, n);
+      releaseSegments(&rs);
     }
   }
 
-  if (rh->moreChunks == 0 && ctx->pDone >= ctx->pCount) {
+  if (last) {
     char           *eStr = "\r\n0\r\n";
     char            status[512];
     char           *desc = NULL;
 
+    /* an error ended the response before its last chunk */
+    if (respDeflating) {
+      zb = UtilFactory->newStrinBuffer(64);
+      deflateBlock(&respStream, NULL, 0, Z_FINISH, zb);
+      deflateEnd(&respStream);
+      respDeflating = 0;
+      sprintf(str, "\r\n%x\r\n", zb->ft->getSize(zb));
+      commWrite(*(ctx->commHndl), str, strlen(str));
+      commWrite(*(ctx->commHndl), (void *) zb->ft->getCharPtr(zb),
+                zb->ft->getSize(zb));
+      zb->ft->release(zb);
+    }
+
     _SFCB_TRACE(1, ("---  writing trailers"));
 
     sprintf(status, "CIMStatusCode: %d\r\n", (int) (rh->rc - 1));
@@ -863,40 +1304,49 @@ getHdrs(CommHndl conn_fd, Buffer * b, int to)
   initialTV.tv_sec = to;
   currentTV = initialTV;
 
+  /* what the previous request read ahead comes first */
+  if (pendingLength) {
+    add2buffer(b, pendingInput, pendingLength);
+    total = pendingLength;
+    keepPending(NULL, 0);
+  }
+
   for (;; pass++) {
-    isReady = select(conn_fd.socket + 1, &httpfds, NULL, NULL, &currentTV);
+    if (pass > 1 || total == 0) {
+      isReady = select(conn_fd.socket + 1, &httpfds, NULL, NULL, &currentTV);
 
-    if (isReady == 0) {
-      mlogf(M_ERROR, M_SHOW, "-#- timeout waiting for HTTP headers\n");
-      state = HTTP_ERROR_TIMEOUT_HDR;
-      break;
-    }
+      if (isReady == 0) {
+        mlogf(M_ERROR, M_SHOW, "-#- timeout waiting for HTTP headers\n");
+        state = HTTP_ERROR_TIMEOUT_HDR;
+        break;
+      }
 
-    char            buf[hdrBufsize];
-    int             r = commRead(conn_fd, buf, sizeof(buf));
+      char            buf[hdrBufsize];
+      int             r = commRead(conn_fd, buf, sizeof(buf));
 
-    if (r < 0) {
-      if (errno == EINTR || errno == EAGAIN) {
-        continue;
-      } else {
-        mlogf(M_INFO, M_SHOW, "--- getHdrs: read() error %s\n",
-              strerror(errno));
-        state = HTTP_ERROR_READERROR;
-        break;
+      if (r < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+          continue;
+        } else {
+          mlogf(M_INFO, M_SHOW, "--- getHdrs: read() error %s\n",
+                strerror(errno));
+          state = HTTP_ERROR_READERROR;
+          break;
+        }
       }
-    }
-    if (r == 0) {
-      if (b->size == 0) {
-        state = HTTP_ERROR_NOERROR;
+      if (r == 0) {
+        if (b->size == 0) {
+          state = HTTP_ERROR_NOERROR;
+          break;
+        }
+        mlogf(M_ERROR, M_SHOW, "-#- HTTP header ended prematurely\n");
+        state = HTTP_ERROR_CLIENT_ABORT_HDR;
         break;
       }
-      mlogf(M_ERROR, M_SHOW, "-#- HTTP header ended prematurely\n");
-      state = HTTP_ERROR_CLIENT_ABORT_HDR;
-      break;
-    }
 
-    add2buffer(b, buf, r);
-    total += r;
+      add2buffer(b, buf, r);
+      total += r;
+    }
 
     if (!vChecked && strstr(b->data, "\n")) {
       if (chkHttpVerb(b->data, CIM_PROTOCOL_CIM_XML)) {
@@ -1010,7 +1460,7 @@ static int
 doHttpRequest(CommHndl conn_fd)
 {
   char           *cp;
-  Buffer          inBuf = { NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, NULL, NULL,
+  Buffer          inBuf = { NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0, NULL, NULL,
                             NULL, NULL, NULL, NULL, NULL, NULL };
   RespSegments    response;
   static RespSegments nullResponse = { NULL, 0, 0, NULL, {{0, NULL}} };
@@ -1120,6 +1570,7 @@ doHttpRequest(CommHndl conn_fd)
   }
 
   /* parse rest of headers */
+  respEncoding = ENC_IDENTITY;
   while ((hdr = getNextHdr(&inBuf)) != NULL) {
     _SFCB_TRACE(1, ("--- Header: %s", hdr));
     if (hdr[0] == 0)
@@ -1159,6 +1610,16 @@ doHttpRequest(CommHndl conn_fd)
       }
       inBuf.content_length = clen;
     }
+    else if (strncasecmp(hdr, "Transfer-Encoding:", 18) == 0) {
+      cp = &hdr[18];
+      cp += strspn(cp, " \t");
+      if (strncasecmp(cp, "chunked", 7) != 0) {
+        _SFCB_TRACE(1, ("--- exiting: unsupported transfer-encoding"));
+        genError(conn_fd, &inBuf, 501, "Not Implemented", NULL);
+        TERMINATE(1);
+      }
+      inBuf.chunked = 1;
+    }
     else if (strncasecmp(hdr, "Content-Type:", 13) == 0) {
       SET_HDR_CP(inBuf.content_type, &hdr[13]);
     }
@@ -1173,6 +1634,9 @@ doHttpRequest(CommHndl conn_fd)
     else if (strncasecmp(hdr, "User-Agent:", 11) == 0) {
       SET_HDR_CP(inBuf.useragent, &hdr[11]);
     }
+    else if (strncasecmp(hdr, "Accept-Encoding:", 16) == 0) {
+      respEncoding = acceptEncoding(&hdr[16]);
+    }
     else if (strncasecmp(hdr, "TE:", 3) == 0) {
       char           *cp = &hdr[3];
       cp += strspn(cp, " \t");
@@ -1312,7 +1776,7 @@ doHttpRequest(CommHndl conn_fd)
   }
 
   len = inBuf.content_length;
-  if (len == UINT_MAX) {
+  if (len == UINT_MAX && !inBuf.chunked) {
     if (!discardInput) {
       genError(conn_fd, &inBuf, 411, "Length Required", NULL);
     }
@@ -1326,11 +1790,28 @@ doHttpRequest(CommHndl conn_fd)
   }
 
   hdr = malloc(strlen(inBuf.authorization) + 64);
-  len += hl =
-      sprintf(hdr, "<!-- xml -->\n<!-- auth: %s -->\n",
-              inBuf.authorization);
-
-  rc = getPayload(conn_fd, &inBuf);
+  hl = sprintf(hdr, "<!-- xml -->\n<!-- auth: %s -->\n",
+               inBuf.authorization);
+
+  if (inBuf.chunked) {
+    unsigned int    maxLen;
+    if ((getControlUNum("httpMaxContentLength", &maxLen) != 0) || maxLen == 0) {
+      _SFCB_TRACE(1, ("--- exiting: bad config httpMaxContentLength"));
+      genError(conn_fd, &inBuf, 501,
+               "Server misconfigured (httpMaxContentLength)", NULL);
+      free(more);
+      TERMINATE(1);
+    }
+    rc = getChunkedPayload(conn_fd, &inBuf, maxLen);
+    if (rc == -2) {
+      _SFCB_TRACE(1, ("--- exiting: chunked content too big"));
+      genError(conn_fd, &inBuf, 413, "Request Entity Too Large", NULL);
+      free(more);
+      TERMINATE(1);
+    }
+  } else
+    rc = getPayload(conn_fd, &inBuf);
+  len = inBuf.content_length + hl;
   if (rc < 0) {
     genError(conn_fd, &inBuf, 400, "Bad Request", NULL);
     _SFCB_TRACE(1, ("--- exiting after request timeout."));
@@ -1472,6 +1953,10 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
       semAcquireUnDo(httpProcSem, 0);
       semReleaseUnDo(httpProcSem, httpProcIdX + 1);
       semRelease(httpWorkSem, 0);
+#ifdef HAVE_SYS_EPOLL_H
+      if (useEventLoop)
+        leaveEventLoop(connFd);
+#endif
       atexit(releaseAuthHandle);
       atexit(uninitGarbageCollector);
       atexit(sunsetControl);
@@ -1481,10 +1966,15 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
      */
     else if (r > 0) {
       running++;
+#ifdef HAVE_SYS_EPOLL_H
+      lastRequestProc = r;
+#endif
       _SFCB_EXIT();
     }
-  } else
+  } else {
     r = 0;
+    sessionId++;
+  }
 
   /*
    * fork() failed 
@@ -1713,10 +2203,15 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
     }
 #endif
     numRequest = 0;
+#ifdef HAVE_SYS_EPOLL_H
+    if (useEventLoop)
+      numRequest = connRequests;
+#endif
     FD_ZERO(&httpfds);
     FD_SET(conn_fd.socket, &httpfds);
     do {
       numRequest += 1;
+      workerRequests += 1;
 
       if (doHttpRequest(conn_fd)) {
         /*
@@ -1731,6 +2226,27 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
         _SFCB_TRACE(1,("--- keepalive disabled or max requests exceeded"));
         break;
       }
+      if (preFork && (stopAccepting || (workerMaxRequests &&
+                                        workerRequests >= workerMaxRequests))) {
+        _SFCB_TRACE(1,("--- request processor stopping or due for recycling"));
+        break;
+      }
+#ifdef HAVE_SYS_EPOLL_H
+      if (useEventLoop && doFork && !sslMode && pendingLength == 0) {
+        /*
+         * the HTTP daemon keeps waiting for the next request; one read
+         * ahead already is no longer on the socket, so it is served here 
+         */
+        _SFCB_TRACE(1, ("--- keepalive connection returned to event loop"));
+        commClose(conn_fd);
+        dumpTiming(currentProc);
+        exit(KEEPALIVE_EXIT);
+      }
+#endif
+      if (pendingLength) {
+        _SFCB_TRACE(1, ("--- pipelined request already read"));
+        continue;
+      }
       _SFCB_TRACE(1, ("--- keepalive enabled, waiting for new request"));
       /*
        * wait for next request or timeout 
@@ -1999,6 +2515,13 @@ acceptRequest(int sock, void *ssin, socklen_t sin_len, int sslMode)
     abort();
   }
 
+  if (preFork) {
+    /*
+     * listen sockets are non-blocking, the connection must not be
+     */
+    fcntl(connFd, F_SETFL, fcntl(connFd, F_GETFL) & ~O_NONBLOCK);
+  }
+
   handleHttpRequest(connFd, sslMode);
   close(connFd);
 }
@@ -2078,6 +2601,318 @@ initSSL()
 }
 #endif                          // USE_SSL
 
+#ifdef HAVE_SYS_EPOLL_H
+typedef struct listener {
+  int             fd;
+  void           *sin;
+  socklen_t       sin_len;
+  int             sslMode;
+} Listener;
+
+static void
+closeIdleConn(int fd)
+{
+  if (idleConns[fd].state == IC_IDLE)
+    epoll_ctl(eventFd, EPOLL_CTL_DEL, fd, NULL);
+  idleConns[fd].state = IC_UNUSED;
+  close(fd);
+}
+
+static void
+watchIdleConn(int fd, time_t now)
+{
+  struct epoll_event ev;
+
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+  ev.data.fd = fd;
+  if (epoll_ctl(eventFd, EPOLL_CTL_ADD, fd, &ev)) {
+    mlogf(M_ERROR, M_SHOW, "--- epoll_ctl failed for %d: %s\n", fd,
+          strerror(errno));
+    idleConns[fd].state = IC_UNUSED;
+    close(fd);
+    return;
+  }
+  idleConns[fd].state = IC_IDLE;
+  idleConns[fd].pid = 0;
+  idleConns[fd].deadline = now +
+      (idleConns[fd].requests ? keepaliveTimeout : selectTimeout);
+}
+
+/*
+ * called in a freshly forked request processor: it only owns keepFd
+ */
+static void
+leaveEventLoop(int keepFd)
+{
+  sigset_t        chldMask;
+  int             fd;
+
+  for (fd = 0; fd < idleConnsMax; fd++)
+    if (idleConns[fd].state != IC_UNUSED && fd != keepFd)
+      close(fd);
+  close(eventFd);
+  idleConnsMax = 0;
+
+  sigemptyset(&chldMask);
+  sigaddset(&chldMask, SIGCHLD);
+  sigprocmask(SIG_UNBLOCK, &chldMask, NULL);
+}
+
+static void
+acceptIdleConn(Listener * l, time_t now)
+{
+  int             connFd,
+                  n;
+  socklen_t       sin_len = l->sin_len;
+  IdleConn       *ic;
+
+  if ((connFd = accept(l->fd, (struct sockaddr *) l->sin, &sin_len)) < 0) {
+    if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+      mlogf(M_ERROR, M_SHOW, "--- accept error %s\n", strerror(errno));
+    return;
+  }
+
+  if (connFd >= idleConnsMax) {
+    n = connFd + 64;
+    if ((ic = realloc(idleConns, n * sizeof(*ic))) == NULL) {
+      mlogf(M_ERROR, M_SHOW, "--- no memory for connection %d\n", connFd);
+      close(connFd);
+      return;
+    }
+    memset(ic + idleConnsMax, 0, (n - idleConnsMax) * sizeof(*ic));
+    idleConns = ic;
+    idleConnsMax = n;
+  }
+
+  _SFCB_TRACE(1, ("--- Accepted connection %d into event loop", connFd));
+  idleConns[connFd].requests = 0;
+  watchIdleConn(connFd, now);
+}
+
+/*
+ * Peek at what arrived on an idle connection and fork a request
+ * processor once the request header is complete.
+ */
+static void
+checkIdleConn(int fd, uint32_t events)
+{
+  char            buf[hdrLimmit + 1];
+  ssize_t         len;
+
+  len = recv(fd, buf, hdrLimmit, MSG_PEEK | MSG_DONTWAIT);
+  if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+    _SFCB_TRACE(1, ("--- Idle connection %d closed by client", fd));
+    closeIdleConn(fd);
+    return;
+  }
+  if (len < 0)
+    return;
+
+  buf[len] = 0;
+  if (len < hdrLimmit && strstr(buf, "\r\n\r\n") == NULL &&
+      strstr(buf, "\n\n") == NULL) {
+    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+      closeIdleConn(fd);
+    return;
+  }
+
+  epoll_ctl(eventFd, EPOLL_CTL_DEL, fd, NULL);
+  idleConns[fd].state = IC_BUSY;
+  connRequests = idleConns[fd].requests++;
+  lastRequestProc = 0;
+  handleHttpRequest(fd, 0);
+  idleConns[fd].pid = lastRequestProc;
+}
+
+static void
+sweepIdleConns(time_t now)
+{
+  int             fd;
+
+  for (fd = 0; fd < idleConnsMax; fd++) {
+    switch (idleConns[fd].state) {
+    case IC_KEEP:
+      watchIdleConn(fd, now);
+      break;
+    case IC_CLOSE:
+      closeIdleConn(fd);
+      break;
+    case IC_IDLE:
+      if (now > idleConns[fd].deadline) {
+        _SFCB_TRACE(1, ("--- Idle connection %d timed out", fd));
+        closeIdleConn(fd);
+      }
+      break;
+    }
+  }
+}
+
+/*
+ * Single event loop for the listen sockets and all idle keep-alive
+ * connections. SIGCHLD is only delivered inside epoll_pwait(), so
+ * handleSigChld() never races with the connection table. HTTPS
+ * connections keep their SSL state in the request processor and are
+ * forked on accept as before.
+ */
+static void
+eventLoop(Listener * lst, int nl)
+{
+  struct epoll_event ev,
+                  evs[64];
+  sigset_t        chldMask,
+                  oldMask;
+  int             n,
+                  i,
+                  j,
+                  fd;
+  time_t          now;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "eventLoop");
+
+  if ((eventFd = epoll_create(64)) < 0) {
+    mlogf(M_ERROR, M_SHOW, "--- epoll_create failed, using select(): %s\n",
+          strerror(errno));
+    useEventLoop = 0;
+    _SFCB_EXIT();
+  }
+  for (i = 0; i < nl; i++) {
+    fcntl(lst[i].fd, F_SETFL, fcntl(lst[i].fd, F_GETFL) | O_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.fd = lst[i].fd;
+    epoll_ctl(eventFd, EPOLL_CTL_ADD, lst[i].fd, &ev);
+  }
+
+  sigemptyset(&chldMask);
+  sigaddset(&chldMask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &chldMask, &oldMask);
+
+  while (stopAccepting == 0) {
+    n = epoll_pwait(eventFd, evs, 64, 1000, &oldMask);
+    if (stopAccepting)
+      break;
+
+#ifdef USE_SSL
+    if (sslReloadRequested) {
+      sunsetControl();
+      setupControl(configfile);
+      initSSL();
+    }
+#endif                          // USE_SSL
+
+    now = time(NULL);
+    for (i = 0; i < n; i++) {
+      fd = evs[i].data.fd;
+      for (j = 0; j < nl && lst[j].fd != fd; j++);
+      if (j == nl)
+        checkIdleConn(fd, evs[i].events);
+      else if (lst[j].sslMode)
+        acceptRequest(lst[j].fd, lst[j].sin, lst[j].sin_len, 1);
+      else
+        acceptIdleConn(&lst[j], now);
+    }
+    sweepIdleConns(now);
+  }
+
+  for (fd = 0; fd < idleConnsMax; fd++)
+    if (idleConns[fd].state != IC_UNUSED)
+      close(fd);
+  idleConnsMax = 0;
+  close(eventFd);
+  sigprocmask(SIG_SETMASK, &oldMask, NULL);
+  _SFCB_EXIT();
+}
+#endif                          // HAVE_SYS_EPOLL_H
+
+/*
+ * Start hMax long-lived request processors and keep them running.
+ * Each of them accepts connections on the (shared) listen sockets
+ * itself. Only returns in a freshly started request processor; the
+ * HTTP daemon stays here until stopProc() terminates it.
+ */
+static void
+preforkWorkers()
+{
+  long            i;
+  pid_t           r;
+  sigset_t        chldMask,
+                  oldMask;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "preforkWorkers");
+
+  workerPids = calloc(hMax, sizeof(pid_t));
+  sigemptyset(&chldMask);
+  sigaddset(&chldMask, SIGCHLD);
+
+  for (;;) {
+    if (stopAccepting) {
+      for (i = 0; i < hMax; i++)
+        if (workerPids[i])
+          kill(workerPids[i], SIGUSR1);
+      /*
+       * stopProc() ends this process once all request processors are gone 
+       */
+      for (;;)
+        sleep(5);
+    }
+#ifdef USE_SSL
+    if (sslReloadRequested) {
+      sunsetControl();
+      setupControl(configfile);
+      initSSL();
+      for (i = 0; i < hMax; i++)
+        if (workerPids[i])
+          kill(workerPids[i], SIGUSR2);
+    }
+#endif                          // USE_SSL
+
+    for (i = 0; i < hMax && stopAccepting == 0; i++) {
+      if (workerPids[i])
+        continue;
+
+      /*
+       * keep handleSigChld() from seeing the child before its pid is known 
+       */
+      sigprocmask(SIG_BLOCK, &chldMask, &oldMask);
+      sessionId++;
+      r = fork();
+
+      if (r == 0) {
+        sigprocmask(SIG_SETMASK, &oldMask, NULL);
+        currentProc = getpid();
+        processName = "CIMREQ-Processor";
+        free(workerPids);
+        workerPids = NULL;
+        running = 0;
+        doFork = 0;
+        workerRequests = 0;
+        setSignal(SIGUSR1, handleWorkerSigUsr1, SA_RESTART);
+        atexit(releaseAuthHandle);
+        atexit(uninitGarbageCollector);
+        atexit(sunsetControl);
+        _SFCB_TRACE(1, ("--- Preforked request processor %d slot %ld",
+                        currentProc, i));
+        _SFCB_EXIT();
+      }
+
+      if (r < 0) {
+        mlogf(M_ERROR, M_SHOW, "--- fork request processor: %s\n",
+              strerror(errno));
+      } else {
+        workerPids[i] = r;
+        running++;
+      }
+      sigprocmask(SIG_SETMASK, &oldMask, NULL);
+      if (r < 0)
+        break;
+    }
+
+    /*
+     * woken up early by SIGCHLD, SIGUSR1 or SIGUSR2 
+     */
+    sleep(1);
+  }
+}
+
 int
 httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
     sa_family_t ipAddrFam, int sfcbPid)
@@ -2097,6 +2932,8 @@ httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
   int             enableHttp = 0;
   fd_set          httpfds;
   int             maxfdp1;      /* highest-numbered fd +1 */
+  int             listenFds[3],
+                  nlf = 0;
 
 #ifdef USE_SSL
 #ifdef HAVE_IPV6
@@ -2163,6 +3000,12 @@ httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
 
   if (getControlBool("doBasicAuth", &doBa))
     doBa = 0;
+  if (doBa)
+    initAuthCache();
+
+  /* request handlers take instance results class relative */
+  if (getControlBool("compactInstanceResults", &classRelativeResults))
+    classRelativeResults = 1;
 
 #ifdef HAVE_UDS
   if (getControlBool("doUdsAuth", &doUdsAuth))
@@ -2180,6 +3023,30 @@ httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
   if (getControlNum("keepaliveMaxRequest", &keepaliveMaxRequest))
     keepaliveMaxRequest = 10;
 
+  if (getControlNum("httpCompressionLevel", &compressLevel))
+    compressLevel = 6;
+  if (compressLevel < 0 || compressLevel > 9) {
+    mlogf(M_ERROR, M_SHOW,
+          "--- httpCompressionLevel %ld out of range, using 6\n",
+          compressLevel);
+    compressLevel = 6;
+  }
+  if (getControlNum("httpCompressionMinSize", &compressMinSize))
+    compressMinSize = 1024;
+
+  char* workerModel;
+  if (doFork && getControlChars("httpWorkerModel", &workerModel) == 0 &&
+      strcmp(workerModel, "prefork") == 0) {
+    preFork = 1;
+    if (getControlNum("httpWorkerMaxRequests", &workerMaxRequests))
+      workerMaxRequests = 1000;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (doFork && !preFork && getControlBool("httpEventLoop", &useEventLoop))
+    useEventLoop = 0;
+#endif
+
   char* chunkStr;
   if (getControlChars("useChunking", &chunkStr) == 0) {
     if (strcmp(chunkStr, "false") == 0) {
@@ -2235,6 +3102,15 @@ httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
     mlogf(M_INFO, M_SHOW, "--- Maximum requests per connection: %ld\n",
           keepaliveMaxRequest);
   }
+  if (preFork) {
+    mlogf(M_INFO, M_SHOW, "--- Prefork http request handlers: %ld\n", hMax);
+    mlogf(M_INFO, M_SHOW, "--- Requests per http request handler: %ld\n",
+          workerMaxRequests);
+  }
+#ifdef HAVE_SYS_EPOLL_H
+  if (useEventLoop)
+    mlogf(M_INFO, M_SHOW, "--- Idle connections kept in event loop\n");
+#endif
 
   if (enableHttp) {
     httpListenFd = getSocket(ipAddrFam);
@@ -2282,13 +3158,23 @@ httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
   if (bindrc > 0)
     return 1;                   /* if can't bind to port, return 1 */
 
+  /* enumeration context holders must not keep the ports open */
+  listenFds[nlf++] = httpListenFd;
+#ifdef USE_SSL
+  listenFds[nlf++] = httpsListenFd;
+#endif
+#ifdef HAVE_UDS
+  listenFds[nlf++] = udsListenFd;
+#endif
+  initEnumCtxHolders(listenFds, nlf);
+
   currentProc = getpid();
 
   setSignal(SIGCHLD, handleSigChld, 0);
   setSignal(SIGUSR1, handleSigUsr1, 0);
   setSignal(SIGINT, SIG_IGN, 0);
   setSignal(SIGTERM, SIG_IGN, 0);
-  setSignal(SIGHUP, SIG_IGN, 0);
+  setSignal(SIGHUP, handleSigHup, 0);
   setSignal(SIGUSR2, handleSigUsr2, 0);
   setSignal(SIGPIPE, handleSigPipe,0);
 
@@ -2313,7 +3199,57 @@ httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
   semAcquire(sfcbSem, INIT_PROV_MGR_ID);
 #endif
 
-  for (;;) {
+  if (preFork) {
+    /*
+     * all request processors wait on the same listen sockets; the ones
+     * losing the race for a connection must not block in accept()
+     */
+    if (httpListenFd >= 0)
+      fcntl(httpListenFd, F_SETFL, fcntl(httpListenFd, F_GETFL) | O_NONBLOCK);
+#ifdef USE_SSL
+    if (httpsListenFd >= 0)
+      fcntl(httpsListenFd, F_SETFL,
+            fcntl(httpsListenFd, F_GETFL) | O_NONBLOCK);
+#endif                          // USE_SSL
+#ifdef HAVE_UDS
+    if (udsListenFd >= 0)
+      fcntl(udsListenFd, F_SETFL, fcntl(udsListenFd, F_GETFL) | O_NONBLOCK);
+#endif                          // HAVE_UDS
+    preforkWorkers();
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (useEventLoop) {
+    Listener        lst[3];
+    int             nl = 0;
+
+    if (httpListenFd >= 0) {
+      lst[nl].fd = httpListenFd;
+      lst[nl].sin = &httpSin;
+      lst[nl].sin_len = httpSin_len;
+      lst[nl++].sslMode = 0;
+    }
+#ifdef USE_SSL
+    if (httpsListenFd >= 0) {
+      lst[nl].fd = httpsListenFd;
+      lst[nl].sin = &httpsSin;
+      lst[nl].sin_len = httpsSin_len;
+      lst[nl++].sslMode = 1;
+    }
+#endif                          // USE_SSL
+#ifdef HAVE_UDS
+    if (udsListenFd >= 0) {
+      lst[nl].fd = udsListenFd;
+      lst[nl].sin = &sun;
+      lst[nl].sin_len = sun_len;
+      lst[nl++].sslMode = 0;
+    }
+#endif                          // HAVE_UDS
+    eventLoop(lst, nl);
+  }
+#endif                          // HAVE_SYS_EPOLL_H
+
+  while (stopAccepting == 0) {
 
     /*
      * select() modifies httpfds in-place, so reset after every select() 
@@ -2369,6 +3305,18 @@ httpDaemon(int argc, char *argv[], int sslMode, char *ipAddr,
       acceptRequest(udsListenFd, &sun, sun_len, 0);
     }
 #endif
+
+    if (preFork && workerMaxRequests && workerRequests >= workerMaxRequests) {
+      _SFCB_TRACE(1, ("--- Request processor %d served %ld requests, recycling",
+                      currentProc, workerRequests));
+      break;
+    }
+  }
+
+  if (preFork) {
+    _SFCB_TRACE(1, ("--- Request processor exiting %d", currentProc));
+    dumpTiming(currentProc);
+    exit(0);
   }
 
   remProcCtl();
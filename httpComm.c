@@ -114,6 +114,120 @@ commWrite(CommHndl to, void *data, size_t count)
   _SFCB_RETURN(rc);
 }
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#if defined USE_SSL
+/*
+ * small pieces are collected into records of this size, larger ones
+ * are written as they are 
+ */
+#define SSL_BATCH 16384
+
+static int
+sslWritev(SSL * ssl, struct iovec *iov, int cnt)
+{
+  char            buf[SSL_BATCH];
+  size_t          used = 0;
+  int             i,
+                  rc,
+                  total = 0;
+
+  for (i = 0; i < cnt; i++) {
+    if (iov[i].iov_len == 0)
+      continue;
+    if (used + iov[i].iov_len <= sizeof(buf)) {
+      memcpy(buf + used, iov[i].iov_base, iov[i].iov_len);
+      used += iov[i].iov_len;
+      continue;
+    }
+    if (used) {
+      if ((rc = SSL_write(ssl, buf, used)) <= 0)
+        return -1;
+      total += rc;
+      used = 0;
+    }
+    if (iov[i].iov_len < sizeof(buf)) {
+      memcpy(buf, iov[i].iov_base, iov[i].iov_len);
+      used = iov[i].iov_len;
+    } else {
+      if ((rc = SSL_write(ssl, iov[i].iov_base, iov[i].iov_len)) <= 0)
+        return -1;
+      total += rc;
+    }
+  }
+  if (used) {
+    if ((rc = SSL_write(ssl, buf, used)) <= 0)
+      return -1;
+    total += rc;
+  }
+  return total;
+}
+#endif
+
+int
+commWritev(CommHndl to, struct iovec *iov, int cnt)
+{
+  ssize_t         rc;
+  int             n,
+                  total = 0;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "commWritev");
+
+#ifdef SFCB_DEBUG
+  /* let commWrite() trace the pieces */
+  if ((*_ptr_sfcb_trace_mask & TRACE_XMLOUT)) {
+    int             i;
+    for (i = 0; i < cnt; i++) {
+      if (iov[i].iov_len == 0)
+        continue;
+      if ((rc = commWrite(to, iov[i].iov_base, iov[i].iov_len)) < 0)
+        _SFCB_RETURN(-1);
+      total += rc;
+    }
+    /* commWrite() may have buffered it all, callers do not flush */
+    commFlush(to);
+    _SFCB_RETURN(total);
+  }
+#endif
+
+#if defined USE_SSL
+  if (to.bio || to.ssl) {
+    /* whatever is still buffered goes first */
+    if (to.bio)
+      (void) BIO_flush(to.bio);
+    _SFCB_RETURN(sslWritev(to.ssl, iov, cnt));
+  }
+#endif
+
+  if (to.file)
+    fflush(to.file);
+
+  while (cnt > 0) {
+    n = cnt < IOV_MAX ? cnt : IOV_MAX;
+    rc = writev(to.socket, iov, n);
+    if (rc < 0) {
+      if (errno == EINTR)
+        continue;
+      _SFCB_RETURN(-1);
+    }
+    total += rc;
+    /* skip what was written, resuming within a partly written piece */
+    while (cnt > 0 && (size_t) rc >= iov->iov_len) {
+      rc -= iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (cnt > 0) {
+      iov->iov_base = (char *) iov->iov_base + rc;
+      iov->iov_len -= rc;
+    }
+  }
+
+  _SFCB_RETURN(total);
+}
+
 int
 commRead(CommHndl from, void *data, size_t count)
 {
@@ -36,6 +36,7 @@
 
 #include <sys/wait.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 
 #include "trace.h"
@@ -78,6 +79,11 @@ typedef struct commHndl {
 
 void            commInit();
 int             commWrite(CommHndl to, void *data, size_t count);
+/*
+ * writes all of iov in as few system calls (or SSL records) as possible,
+ * bypassing the stream buffer; returns the bytes written or -1 
+ */
+int             commWritev(CommHndl to, struct iovec *iov, int cnt);
 int             commRead(CommHndl from, void *data, size_t count);
 void            commFlush(CommHndl hdl);
 void            commClose(CommHndl hdl);
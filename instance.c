@@ -22,6 +22,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <sched.h>
 
 #include <sfcCommon/utilft.h>
 #include "native.h"
@@ -29,6 +33,8 @@
 
 #include "objectImpl.h"
 #include "providerMgr.h"
+#include "msgqueue.h"
+#include "mlog.h"
 #include "config.h"
 
 #ifdef SFCB_IX86
@@ -78,9 +84,7 @@ struct native_instance {
 static pthread_mutex_t gopMtx = PTHREAD_MUTEX_INITIALIZER;
 
 #ifdef HAVE_DEFAULT_PROPERTIES
-static pthread_mutex_t ifdpMtx = PTHREAD_MUTEX_INITIALIZER;
-static int     instFillDefaultProperties(struct native_instance *inst,
-                                          const char *ns, const char *cn);
+static ClInstance *instFromTemplate(const char *ns, const char *cn);
 #endif
 
 static CMPIStatus __ift_internal_setPropertyFilter(CMPIInstance * instance,
@@ -184,7 +188,7 @@ __ift_release(CMPIInstance *instance)
     ClInstanceFree((ClInstance *) instance->hdl);
     memUnlinkEncObj(i->mem_state);
     i->mem_state = MEM_RELEASED;
-    free(i);
+    memFree(i);
     CMReturn(CMPI_RC_OK);
   }
   CMReturn(CMPI_RC_ERR_FAILED);
@@ -936,6 +940,153 @@ NATIVE_FT_VERSION,
 
 CMPIInstanceFT *CMPI_Instance_FT = &ift;
 
+static unsigned int
+classHash(const char *ns, const char *cn)
+{
+  unsigned int    h = 0;
+
+  while (*cn)
+    h = h * 31 + tolower(*cn++);
+  while (*ns)
+    h = h * 31 + tolower(*ns++);
+  return h;
+}
+
+/*
+ * Class layouts: a rebuilt copy of each class that class relative
+ * instances (see objectImpl.c) were encoded against or are decoded
+ * with. Decoded instances point into their layout for as long as the
+ * message holding them lives, so layouts are never freed, and lookups
+ * take no lock as layouts are only ever added. There is one per class
+ * definition seen, keyed by class and layout id: a new provider
+ * generation only has each class looked up again, and a layout is
+ * added only if the class really changed.
+ */
+#define LAYOUT_BUCKETS 256
+#define LAYOUT_CHECK   1        /* seconds between generation checks */
+
+typedef struct instLayout {
+  struct instLayout *next;
+  char           *ns,
+                 *cn;
+  ClClass        *cls;          /* NULL if there is no such class */
+  unsigned int    id;
+  volatile int    gen;          /* generation the class was last seen in */
+} InstLayout;
+
+static InstLayout *volatile layoutBuckets[LAYOUT_BUCKETS];
+static volatile int layoutGen = -1;
+static volatile time_t layoutChecked = 0;
+static pthread_mutex_t layoutMtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+checkLayoutGen(int force)
+{
+  time_t          now = time(NULL);
+
+  if (force || now - layoutChecked >= LAYOUT_CHECK) {
+    pthread_mutex_lock(&layoutMtx);
+    if (force || now - layoutChecked >= LAYOUT_CHECK) {
+      layoutGen = semGetValue(sfcbSem, PROV_GEN_ID);
+      layoutChecked = now;
+    }
+    pthread_mutex_unlock(&layoutMtx);
+  }
+}
+
+/*
+ * the layout of the class as of the current generation
+ */
+static InstLayout *
+findLayout(const char *ns, const char *cn, unsigned int h)
+{
+  InstLayout     *l;
+
+  for (l = layoutBuckets[h]; l; l = l->next)
+    if (l->gen == layoutGen && strcasecmp(l->cn, cn) == 0 &&
+        strcasecmp(l->ns, ns) == 0)
+      return l;
+  return NULL;
+}
+
+/*
+ * the layout of any generation for a class (known) or its absence
+ */
+static InstLayout *
+findLayoutId(const char *ns, const char *cn, unsigned int h, int known,
+             unsigned int id)
+{
+  InstLayout     *l;
+
+  for (l = layoutBuckets[h]; l; l = l->next)
+    if ((l->cls != NULL) == known && l->id == id &&
+        strcasecmp(l->cn, cn) == 0 && strcasecmp(l->ns, ns) == 0)
+      return l;
+  return NULL;
+}
+
+static InstLayout *
+getLayout(const char *ns, const char *cn)
+{
+  unsigned int    h = classHash(ns, cn) % LAYOUT_BUCKETS;
+  CMPIConstClass *cc;
+  ClClass        *cls = NULL;
+  InstLayout     *l;
+  unsigned int    id = 0;
+  int             gen;
+
+  checkLayoutGen(0);
+  if ((l = findLayout(ns, cn, h)) != NULL)
+    return l;
+
+  gen = layoutGen;
+  if ((cc = getConstClass(ns, cn)) != NULL) {
+    cls = ClClassRebuildClass((ClClass *) cc->hdl, NULL);
+    id = ClClassLayoutId(cls);
+  }
+
+  pthread_mutex_lock(&layoutMtx);
+  if ((l = findLayoutId(ns, cn, h, cls != NULL, id)) != NULL) {
+    /* unchanged, or another thread was quicker */
+    if (cls)
+      ClClassFreeClass(cls);
+    l->gen = gen;
+  } else {
+    l = calloc(1, sizeof(*l));
+    l->ns = strdup(ns);
+    l->cn = strdup(cn);
+    l->cls = cls;
+    l->id = id;
+    l->gen = gen;
+    l->next = layoutBuckets[h];
+    /* the layout must be complete before lookups can reach it */
+    __sync_synchronize();
+    layoutBuckets[h] = l;
+  }
+  pthread_mutex_unlock(&layoutMtx);
+  return l;
+}
+
+/*
+ * the layout a class relative instance was encoded against, NULL if the
+ * class changed and the old definition is not known here
+ */
+static InstLayout *
+getLayoutById(const char *ns, const char *cn, unsigned int id)
+{
+  unsigned int    h = classHash(ns, cn) % LAYOUT_BUCKETS;
+  InstLayout     *l;
+
+  if ((l = findLayoutId(ns, cn, h, 1, id)) != NULL)
+    return l;
+  /* the class may have changed since our last generation check */
+  checkLayoutGen(1);
+  l = getLayout(ns, cn);
+  if (l->cls == NULL || l->id != id)
+    return NULL;
+  return l;
+}
+
 unsigned long
 getInstanceSerializedSize(const CMPIInstance *ci)
 {
@@ -943,6 +1094,50 @@ getInstanceSerializedSize(const CMPIInstance *ci)
   return ClSizeInstance(cli) + sizeof(struct native_instance);
 }
 
+/*
+ * like getInstanceSerializedSize(), for a requestor reading class
+ * relative instances; *layout is to be passed on to
+ * getCompactSerializedInstance() 
+ */
+unsigned long
+getCompactInstanceSerializedSize(const CMPIInstance *ci, void **layout)
+{
+  ClInstance     *cli = (ClInstance *) ci->hdl;
+  const char     *cn = ClInstanceGetClassName(cli);
+  InstLayout     *l;
+  unsigned long   sz;
+
+  *layout = NULL;
+  /* the classes of the class providers themselves are left alone */
+  if (ClInstanceIsClassRelative(cli) || strncmp(cn, "__", 2) == 0)
+    return getInstanceSerializedSize(ci);
+
+  l = getLayout(ClInstanceGetNameSpace(cli), cn);
+  if (l->cls == NULL || (sz = ClSizeInstanceCompact(cli, l->cls)) == 0)
+    return getInstanceSerializedSize(ci);
+
+  *layout = l;
+  return sz + sizeof(struct native_instance);
+}
+
+void
+getCompactSerializedInstance(const CMPIInstance *ci, void *layout,
+                             void *area)
+{
+  InstLayout     *l = (InstLayout *) layout;
+
+  if (l == NULL) {
+    getSerializedInstance(ci, area);
+    return;
+  }
+  memcpy(area, ci, sizeof(struct native_instance));
+  ClInstanceRebuildCompact((ClInstance *) ci->hdl, l->cls, l->id,
+                           (void *) ((char *) area +
+                                     sizeof(struct native_instance)));
+  ((CMPIInstance *) (area))->hdl =
+      (ClInstance *) ((char *) area + sizeof(struct native_instance));
+}
+
 void
 getSerializedInstance(const CMPIInstance *ci, void *area)
 {
@@ -954,6 +1149,38 @@ getSerializedInstance(const CMPIInstance *ci, void *area)
       (ClInstance *) ((char *) area + sizeof(struct native_instance));
 }
 
+static void
+setLayout(ClInstance * inst)
+{
+  const char     *ns = ClInstanceGetNameSpace(inst),
+      *cn = ClInstanceGetClassName(inst);
+  unsigned int    id = ClInstanceLayoutId(inst);
+  InstLayout     *l = getLayoutById(ns, cn, id);
+
+  /* responses are checked by checkSerializedInstance() on arrival */
+  if (ClInstanceSetLayout(inst, l ? l->cls : NULL, id))
+    mlogf(M_ERROR, M_SHOW,
+          "--- %s:%s changed while its instances were sent, property names are lost\n",
+          ns, cn);
+}
+
+/*
+ * returns -1 if area holds a class relative instance that cannot be
+ * decoded here, because its class changed while it was sent
+ */
+int
+checkSerializedInstance(void *area)
+{
+  ClInstance     *inst = (ClInstance *) ((struct native_instance *) area + 1);
+
+  if (!ClInstanceIsClassRelative(inst))
+    return 0;
+  ClInstanceRelocateInstance(inst);
+  return getLayoutById(ClInstanceGetNameSpace(inst),
+                       ClInstanceGetClassName(inst),
+                       ClInstanceLayoutId(inst)) ? 0 : -1;
+}
+
 CMPIInstance   *
 relocateSerializedInstance(void *area)
 {
@@ -964,6 +1191,8 @@ relocateSerializedInstance(void *area)
   ci->property_list = NULL;
   ci->key_list = NULL;
   ClInstanceRelocateInstance((ClInstance *) ci->instance.hdl);
+  if (ClInstanceIsClassRelative((ClInstance *) ci->instance.hdl))
+    setLayout((ClInstance *) ci->instance.hdl);
   return (CMPIInstance *) ci;
 }
 
@@ -1022,15 +1251,13 @@ internal_new_CMPIInstance(int mode, const CMPIObjectPath * cop,
     if (rc)
       CMSetStatus(rc, CMPI_RC_ERR_FAILED);
   } else {
-    instance.instance.hdl = ClInstanceNew(ns, cn);
-
+    instance.instance.hdl = NULL;
 #ifdef HAVE_DEFAULT_PROPERTIES
-    if (!override) {
-      if (instFillDefaultProperties(&instance,ns,cn)) {
-         mlogf(M_ERROR, M_SHOW, "--- Could not fill default properties for instance of %ss; mutex creation failure\n", cn);      
-      }
-    }
+    if (!override)
+      instance.instance.hdl = instFromTemplate(ns, cn);
 #endif
+    if (instance.instance.hdl == NULL)
+      instance.instance.hdl = ClInstanceNew(ns, cn);
 
     while (j-- && (tmp1.rc == CMPI_RC_OK)) {
       CMPIString     *keyName;
@@ -1148,72 +1375,243 @@ setInstanceLocalMode(int mode)
 }
 
 #ifdef HAVE_DEFAULT_PROPERTIES
-static int
-instFillDefaultProperties(struct native_instance *inst,
-                          const char *ns, const char *cn)
+static void
+instFillDefaultProperties(struct native_instance *inst, CMPIConstClass *cc)
 {
-  static UtilHashTable *clt = NULL;
-  CMPIConstClass *cc;
   CMPICount       pc;
   CMPIData        pd;
   CMPIStatus      ps;
   CMPIString     *pn = NULL;
   CMPIValue      *vp;
 
-  pthread_mutex_lock(&ifdpMtx);
-  if (clt == NULL)
-    clt =
-        UtilFactory->newHashTable(61,
-                                  UtilHashTable_charKey |
-                                  UtilHashTable_ignoreKeyCase);
+  pc = cc->ft->getPropertyCount(cc, NULL);
+  while (pc > 0) {
+    pc -= 1;
+    pd = cc->ft->getPropertyAt(cc, pc, &pn, &ps);
 
-  if ((cc = clt->ft->get(clt, cn)) == NULL) {
-    cc = getConstClass(ns, cn);
-    if (cc) {
-      clt->ft->put(clt, strdup(cn), cc->ft->clone(cc, NULL));
+    /* if this prop is an EmbeddedObject, force type to CMPI_instance to allow CMSetProperty with a CMPI_Instance */
+    /* (also works for EmbeddedInstance, since the EmbeddedObject qual will also be set in that case */
+    CMPIData pqd = cc->ft->getPropQualifier(cc, CMGetCharsPtr(pn, NULL), "EmbeddedObject", NULL);
+    if ((pqd.state == CMPI_goodValue) && (pqd.value.boolean == 1)) {
+      pd.type = CMPI_instance;
     }
-  }
-  pthread_mutex_unlock(&ifdpMtx);
-  if (cc) {
-    pc = cc->ft->getPropertyCount(cc, NULL);
-    while (pc > 0) {
-      pc -= 1;
-      pd = cc->ft->getPropertyAt(cc, pc, &pn, &ps);
-
-      /* if this prop is an EmbeddedObject, force type to CMPI_instance to allow CMSetProperty with a CMPI_Instance */
-      /* (also works for EmbeddedInstance, since the EmbeddedObject qual will also be set in that case */
-      CMPIData pqd = cc->ft->getPropQualifier(cc, CMGetCharsPtr(pn, NULL), "EmbeddedObject", NULL);
-      if ((pqd.state == CMPI_goodValue) && (pqd.value.boolean == 1)) {
-	pd.type = CMPI_instance;
-      }
-      
-      if (ps.rc == CMPI_RC_OK && pn) {
-        vp = &pd.value;
-        if (pd.state & CMPI_nullValue) {
-          /*
-           * must set null value indication: CMPI doesn't allow to do
-           * that properly 
-           */
-          pd.value.chars = NULL;
-          if ((pd.type & (CMPI_SIMPLE | CMPI_REAL | CMPI_INTEGER)) &&
-              (pd.type & CMPI_ARRAY) == 0) {
-            vp = NULL;
-          }
-        }
-        __ift_setProperty(&inst->instance, CMGetCharsPtr(pn, NULL),
-                          vp, pd.type);
-
-        /* Copy EmbeddedInstance qualifier from the class to the instance,
-           so we know, what to put into CIM-XML */
-        CMPIData pqd = cc->ft->getPropQualifier(cc, CMGetCharsPtr(pn, NULL), "EmbeddedInstance", NULL);
-        if ((pqd.state == CMPI_goodValue) && (pqd.value.string != NULL)) {
-          __ift_addPropertyQualifier(&inst->instance, CMGetCharsPtr(pn,NULL), "EmbeddedInstance");
+
+    if (ps.rc == CMPI_RC_OK && pn) {
+      vp = &pd.value;
+      if (pd.state & CMPI_nullValue) {
+        /*
+         * must set null value indication: CMPI doesn't allow to do
+         * that properly 
+         */
+        pd.value.chars = NULL;
+        if ((pd.type & (CMPI_SIMPLE | CMPI_REAL | CMPI_INTEGER)) &&
+            (pd.type & CMPI_ARRAY) == 0) {
+          vp = NULL;
         }
+      }
+      __ift_setProperty(&inst->instance, CMGetCharsPtr(pn, NULL),
+                        vp, pd.type);
+
+      /* Copy EmbeddedInstance qualifier from the class to the instance,
+         so we know, what to put into CIM-XML */
+      CMPIData pqd = cc->ft->getPropQualifier(cc, CMGetCharsPtr(pn, NULL), "EmbeddedInstance", NULL);
+      if ((pqd.state == CMPI_goodValue) && (pqd.value.string != NULL)) {
+        __ift_addPropertyQualifier(&inst->instance, CMGetCharsPtr(pn,NULL), "EmbeddedInstance");
+      }
+
+    }
+  }
+}
+
+/*
+ * Instance templates: a new instance of a class with its default
+ * values and EmbeddedInstance qualifiers filled in, rebuilt into one
+ * block. Instances are created by copying it, so the class is walked
+ * once per class instead of once per instance.
+ *
+ * Lookups take no lock. Templates are published complete, behind a
+ * barrier, and added and unlinked under tmplMtx. All templates are
+ * unlinked when the provider generation (PROV_GEN_ID) moves on, which
+ * class creation and deletion do, and freed after a grace period: every
+ * lookup counts itself in tmplReaders for the epoch it started in, and
+ * the epoch is only flipped again once the previous one has drained.
+ */
+#define TMPL_BUCKETS 256
+#define TMPL_CHECK   1          /* seconds between generation checks */
+
+typedef struct instTemplate {
+  struct instTemplate *next;
+  char           *ns,
+                 *cn;
+  ClInstance     *inst;         /* NULL if there is no such class */
+} InstTemplate;
+
+static InstTemplate *volatile tmplBuckets[TMPL_BUCKETS];
+static int      tmplGen = -1;
+static volatile time_t tmplChecked = 0;
+static volatile unsigned int tmplEpoch = 0;
+static volatile long tmplReaders[2];
+static pthread_mutex_t tmplMtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+freeTemplates(InstTemplate * t)
+{
+  InstTemplate   *n;
+
+  for (; t; t = n) {
+    n = t->next;
+    if (t->inst)
+      ClInstanceFree(t->inst);
+    free(t->ns);
+    free(t->cn);
+    free(t);
+  }
+}
+
+static unsigned int
+enterTemplates()
+{
+  unsigned int    e;
+
+  for (;;) {
+    e = tmplEpoch;
+    __sync_fetch_and_add(&tmplReaders[e & 1], 1);
+    if (e == tmplEpoch)
+      return e;
+    /* flipped meanwhile, the writer may already wait for the other side */
+    __sync_fetch_and_sub(&tmplReaders[e & 1], 1);
+  }
+}
+
+static void
+leaveTemplates(unsigned int e)
+{
+  __sync_fetch_and_sub(&tmplReaders[e & 1], 1);
+}
 
+static void
+checkTemplates()
+{
+  time_t          now = time(NULL);
+  InstTemplate   *old[TMPL_BUCKETS];
+  unsigned int    e;
+  int             i,
+                  gen,
+                  drop = 0;
+
+  if (now - tmplChecked < TMPL_CHECK)
+    return;
+
+  pthread_mutex_lock(&tmplMtx);
+  if (now - tmplChecked >= TMPL_CHECK) {
+    gen = semGetValue(sfcbSem, PROV_GEN_ID);
+    if (gen != tmplGen) {
+      for (i = 0; i < TMPL_BUCKETS; i++) {
+        old[i] = tmplBuckets[i];
+        tmplBuckets[i] = NULL;
       }
+      drop = 1;
     }
+    tmplGen = gen;
+    tmplChecked = now;
   }
-  return 0;
+  if (drop) {
+    /* lookups that may still see the unlinked ones started before this */
+    __sync_synchronize();
+    e = __sync_fetch_and_add(&tmplEpoch, 1);
+    while (tmplReaders[e & 1])
+      sched_yield();
+    for (i = 0; i < TMPL_BUCKETS; i++)
+      freeTemplates(old[i]);
+  }
+  pthread_mutex_unlock(&tmplMtx);
+}
+
+static InstTemplate *
+findTemplate(const char *ns, const char *cn, unsigned int h)
+{
+  InstTemplate   *t;
+
+  for (t = tmplBuckets[h]; t; t = t->next)
+    if (strcasecmp(t->cn, cn) == 0 && strcasecmp(t->ns, ns) == 0)
+      return t;
+  return NULL;
+}
+
+/*
+ * called between enterTemplates() and leaveTemplates(), or with tmplMtx
+ * held
+ */
+static ClInstance *
+copyTemplate(InstTemplate * t)
+{
+  ClInstance     *inst;
+
+  if (t->inst == NULL)
+    return NULL;
+  inst = malloc(t->inst->hdr.size);
+  memcpy(inst, t->inst, t->inst->hdr.size);
+  ClInstanceRelocateInstance(inst);
+  return inst;
+}
+
+static ClInstance *
+buildTemplate(const char *ns, const char *cn, unsigned int h)
+{
+  InstTemplate   *t = calloc(1, sizeof(*t)),
+      *o;
+  CMPIConstClass *cc = getConstClass(ns, cn);
+  struct native_instance tmp;
+  ClInstance     *inst;
+
+  t->ns = strdup(ns);
+  t->cn = strdup(cn);
+  if (cc) {
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.instance.hdl = ClInstanceNew(ns, cn);
+    tmp.instance.ft = CMPI_Instance_FT;
+    instFillDefaultProperties(&tmp, cc);
+    t->inst = ClInstanceRebuild((ClInstance *) tmp.instance.hdl, NULL);
+    ClInstanceFree((ClInstance *) tmp.instance.hdl);
+  }
+
+  pthread_mutex_lock(&tmplMtx);
+  if ((o = findTemplate(ns, cn, h)) != NULL) {
+    /* another thread was quicker */
+    freeTemplates(t);
+    t = o;
+  } else {
+    t->next = tmplBuckets[h];
+    /* lookups must not find it before it is complete */
+    __sync_synchronize();
+    tmplBuckets[h] = t;
+  }
+  inst = copyTemplate(t);
+  pthread_mutex_unlock(&tmplMtx);
+  return inst;
+}
+
+/*
+ * returns a new instance of cn with its defaults, or NULL if cn is not
+ * known 
+ */
+static ClInstance *
+instFromTemplate(const char *ns, const char *cn)
+{
+  InstTemplate   *t;
+  ClInstance     *inst;
+  unsigned int    h = classHash(ns, cn) % TMPL_BUCKETS,
+                  e;
+
+  checkTemplates();
+  e = enterTemplates();
+  if ((t = findTemplate(ns, cn, h)) != NULL) {
+    inst = copyTemplate(t);
+    leaveTemplates(e);
+    return inst;
+  }
+  leaveTemplates(e);
+  return buildTemplate(ns, cn, h);
 }
 #endif
 
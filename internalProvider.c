@@ -209,7 +209,7 @@ InternalProviderEnumInstanceNames(CMPIInstanceMI __attribute__ ((unused)) *mi,
             CMPIStatus      st = { CMPI_RC_ERR_FAILED, NULL };
             return st;
           }
-          if (bi->next < bi->dSize && ipGetNext(bi, NULL, &kp, &ekl)) {
+          if (ipGetNext(bi, NULL, &kp, &ekl)) {
             continue;
           }
           break;
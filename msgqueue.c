@@ -19,6 +19,7 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <string.h>
 #include <errno.h>
 #include "cmpi/cmpidt.h"
@@ -30,7 +31,11 @@
 #include <unistd.h>
 #include <stddef.h>
 #include "control.h"
+#include "config.h"
 #include <grp.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 extern unsigned long exFlags;
 
@@ -38,6 +43,7 @@ ComSockets      resultSockets;
 ComSockets      sfcbSockets;
 ComSockets      providerSockets;
 int             localMode = 1;
+int             classRelativeResults = 0;
 int             disableDefaultProvider = 0;
 
 ComSockets     *sPairs;
@@ -155,6 +161,7 @@ initSem(int provs)
   sun.val = 0; /* init as unacquirable */
   semctl(sfcbSem, INIT_CLASS_PROV_ID, SETVAL, sun);
   semctl(sfcbSem, INIT_PROV_MGR_ID, SETVAL, sun);
+  semctl(sfcbSem, PROV_GEN_ID, SETVAL, sun);
 
   for (i = 0; i < provs; i++) {
     sun.val = 1;
@@ -166,6 +173,17 @@ initSem(int provs)
   _SFCB_RETURN(0);
 }
 
+/*
+ * Invalidate provider routing cached by request processes. Only
+ * equality is checked, so the counter may wrap.
+ */
+void
+bumpProvGeneration()
+{
+  if (semRelease(sfcbSem, PROV_GEN_ID) && errno == ERANGE)
+    semSetValue(sfcbSem, PROV_GEN_ID, 0);
+}
+
 int
 remSem()
 {
@@ -283,6 +301,32 @@ spGetMsg(int *s, int *from, void *data, unsigned length, MqgStat * mqg)
   return 0;
 }
 
+/*
+ *              shared memory result transport
+ *
+ * Large results can be handed over in a memory file instead of being
+ * streamed through the socket. The message header then has type MSG_SHM,
+ * totalSize gives the length of the data and the memory file descriptor
+ * travels as SCM_RIGHTS. The receiver maps it and copies the data into
+ * the buffer it returns, so callers of spRecvResult() see no difference.
+ */
+
+static int
+spGetShm(int shmfd, void *data, unsigned long length)
+{
+  void           *area;
+
+  area = mmap(NULL, length, PROT_READ, MAP_SHARED, shmfd, 0);
+  if (area == MAP_FAILED) {
+    close(shmfd);
+    return -1;
+  }
+  memcpy(data, area, length);
+  munmap(area, length);
+  close(shmfd);
+  return 0;
+}
+
 /*
  *              spRcvMsg
  */
@@ -294,7 +338,8 @@ spRcvMsg(int *s, int *from, void **data, unsigned long *length,
   SpMessageHdr    spMsg;
   static char    *em = "rcvMsg receiving from";
   MqgStat         imqg;
-  int             fromfd;
+  int             fromfd,
+                  shmfd = -1;
   unsigned long   maxlen;
   int             partRecvd = 0,
       totalRecvd = 0;
@@ -316,6 +361,10 @@ spRcvMsg(int *s, int *from, void **data, unsigned long *length,
       mqg->eintr = 1;
   } while (mqg->teintr);
 
+  if (spMsg.type == MSG_SHM) {
+    shmfd = fromfd;
+    fromfd = -1;
+  }
   if (fromfd > 0)
     spMsg.returnS = fromfd;
   *from = spMsg.returnS;
@@ -333,13 +382,26 @@ spRcvMsg(int *s, int *from, void **data, unsigned long *length,
     mlogf(M_ERROR, M_SHOW,
           "--- spRcvMsg max message length exceeded, %lu bytes from %d\n",
           *length, *s);
+    if (shmfd >= 0)
+      close(shmfd);
     return -1;
   }
   if (*length) {
     *data = malloc(spMsg.totalSize + 8);
     if (*data == NULL) {
+      if (shmfd >= 0)
+        close(shmfd);
       return spHandleError(s, em);
     }
+  }
+  if (*length && shmfd >= 0) {
+    if (spGetShm(shmfd, *data, *length)) {
+      free(*data);
+      *data = 0;
+      return spHandleError(s, em);
+    }
+    _SFCB_TRACE(1, ("--- Received shared memory segment %d bytes", *length));
+  } else if (*length) {
     partRecvd = totalRecvd = 0;
     do {
       if ((partRecvd =
@@ -356,7 +418,7 @@ spRcvMsg(int *s, int *from, void **data, unsigned long *length,
     _SFCB_TRACE(1, ("--- Received data segment %d bytes", *length));
   }
 
-  if (spMsg.type == MSG_DATA) {
+  if (spMsg.type == MSG_DATA || spMsg.type == MSG_SHM) {
     _SFCB_TRACE(1, ("--- Received %d bytes", *length));
     _SFCB_RETURN(0);
   }
@@ -526,6 +588,83 @@ spSendResult(int *to, int *from, void *data, unsigned long size)
   _SFCB_RETURN(rc);
 }
 
+/*
+ * hand the iovecs over in a memory file, returns 1 if the caller has to
+ * fall back to sending them through the socket
+ */
+static int
+spSendShm(int *to, int *from, int n, struct iovec *iov, unsigned long size)
+{
+#ifdef HAVE_MEMFD_CREATE
+  static long     shmMin = -1;
+  SpMessageHdr    spMsg = { MSG_SHM, 0, abs(*from), size };
+  struct msghdr   msg;
+  struct iovec    hiov;
+  char            ccmsg[CMSG_SPACE(sizeof(int))];
+  struct cmsghdr *cmsg;
+  char           *area,
+                 *p;
+  int             shmfd,
+                  i,
+                  rc;
+
+  _SFCB_ENTER(TRACE_MSGQUEUE, "spSendShm");
+
+  if (shmMin < 0) {
+    if (getControlBool("providerResultShm", &i) || i == 0)
+      shmMin = 0;
+    else if (getControlNum("providerResultShmMinSize", &shmMin) ||
+             shmMin < 1)
+      shmMin = 1;
+  }
+  /* a request socket to pass along would need a second descriptor */
+  if (shmMin == 0 || size < (unsigned long) shmMin || *from > 0)
+    _SFCB_RETURN(1);
+
+  if ((shmfd = memfd_create("sfcb-result", MFD_CLOEXEC)) < 0)
+    _SFCB_RETURN(1);
+  if (ftruncate(shmfd, size) < 0 ||
+      (area = mmap(NULL, size, PROT_WRITE, MAP_SHARED, shmfd, 0))
+      == MAP_FAILED) {
+    close(shmfd);
+    _SFCB_RETURN(1);
+  }
+  for (p = area, i = 1; i < n; i++) {
+    memcpy(p, iov[i].iov_base, iov[i].iov_len);
+    p += iov[i].iov_len;
+  }
+  munmap(area, size);
+
+  spMsg.segments = n - 1;
+  hiov.iov_base = &spMsg;
+  hiov.iov_len = sizeof(spMsg);
+
+  msg.msg_name = NULL;
+  msg.msg_namelen = 0;
+  msg.msg_flags = 0;
+  msg.msg_iov = &hiov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ccmsg;
+  msg.msg_controllen = sizeof(ccmsg);
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  *(int *) CMSG_DATA(cmsg) = shmfd;
+
+  rc = sendmsg(*to, &msg, 0);
+  close(shmfd);
+  if (rc < 0)
+    _SFCB_RETURN(spHandleError(to, "spSendShm sending to"));
+
+  _SFCB_TRACE(1, ("--- Sent %lu bytes to %d in shared memory", size, *to));
+  _SFCB_RETURN(0);
+#else
+  return 1;
+#endif
+}
+
 int
 spSendResult2(int *to, int *from,
               void *d1, unsigned long s1, void *d2, unsigned long s2)
@@ -545,7 +684,8 @@ spSendResult2(int *to, int *from,
   } else
     n = 2;
 
-  rc = spSendMsg(to, from, n, iov, s1 + s2);
+  if ((rc = spSendShm(to, from, n, iov, s1 + s2)) == 1)
+    rc = spSendMsg(to, from, n, iov, s1 + s2);
   _SFCB_RETURN(rc);
 }
 
@@ -665,13 +805,125 @@ getInode(int fd)
   return st.st_ino;
 }
 
+/*
+ *              socket pair pool
+ *
+ * Socket pairs used for a single request/response exchange are kept on a
+ * per-process free list by releaseSocketPair() and handed out again by
+ * getSocketPair(). The provider keeps a copy of the send end as long as
+ * it works on a request, so only a pair whose exchange finished cleanly,
+ * its last response received in full, may be released; callers close any
+ * other pair, and must not send the next request over it either. Anything
+ * still readable on reuse means a stray message, in which case the pair
+ * is discarded as well. The pool is dropped in a forked child, which must
+ * not share pairs with its parent.
+ */
+
+static ComSockets *spPool = NULL;
+static long     spPoolMax = -1;
+static int      spPoolCount = 0;
+static pid_t    spPoolPid = 0;
+static unsigned long spPoolHits = 0,
+                spPoolMisses = 0,
+                spPoolDiscards = 0;
+static pthread_mutex_t spPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+closeSocketPair(ComSockets * sp)
+{
+  close(sp->receive);
+  close(sp->send);
+}
+
+static int
+socketPairHealthy(ComSockets * sp)
+{
+  char            buf[256];
+  ssize_t         n;
+
+  if (fcntl(sp->receive, F_GETFD) < 0 || fcntl(sp->send, F_GETFD) < 0)
+    return 0;
+  /* drain both ends, anything left over means the pair can't be trusted */
+  n = recv(sp->receive, buf, sizeof(buf), MSG_DONTWAIT);
+  if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+    return 0;
+  n = recv(sp->send, buf, sizeof(buf), MSG_DONTWAIT);
+  if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+    return 0;
+  return 1;
+}
+
+static int
+getPooledSocketPair(ComSockets * sp)
+{
+  int             found = 0;
+
+  pthread_mutex_lock(&spPoolMutex);
+  if (spPoolMax < 0) {
+    if (getControlNum("socketPairPoolSize", &spPoolMax) || spPoolMax < 0)
+      spPoolMax = 0;
+    if (spPoolMax)
+      spPool = malloc(sizeof(ComSockets) * spPoolMax);
+    spPoolPid = getpid();
+  }
+  if (spPoolPid != getpid()) {
+    /* inherited from the parent, close our copies and start over */
+    while (spPoolCount)
+      closeSocketPair(&spPool[--spPoolCount]);
+    spPoolHits = spPoolMisses = spPoolDiscards = 0;
+    spPoolPid = getpid();
+  }
+  while (spPoolCount && !found) {
+    *sp = spPool[--spPoolCount];
+    if (socketPairHealthy(sp)) {
+      found = 1;
+      spPoolHits++;
+    } else {
+      closeSocketPair(sp);
+      spPoolDiscards++;
+    }
+  }
+  if (!found && spPoolMax)
+    spPoolMisses++;
+  pthread_mutex_unlock(&spPoolMutex);
+  return found;
+}
+
+void
+releaseSocketPair(ComSockets * sp, char *by)
+{
+  int             pooled = 0;
+  _SFCB_ENTER(TRACE_MSGQUEUE | TRACE_SOCKETS, "releaseSocketPair");
+
+  pthread_mutex_lock(&spPoolMutex);
+  if (spPoolMax > 0 && spPoolPid == getpid() && spPoolCount < spPoolMax &&
+      sp->receive > 0 && sp->send > 0) {
+    spPool[spPoolCount++] = *sp;
+    pooled = 1;
+  }
+  pthread_mutex_unlock(&spPoolMutex);
+
+  if (pooled) {
+    _SFCB_TRACE(1,
+                ("--- %s pooled: %d %d (%d pooled, %lu hits %lu misses %lu discards)",
+                 by, sp->receive, sp->send, spPoolCount, spPoolHits,
+                 spPoolMisses, spPoolDiscards));
+    sp->receive = sp->send = 0;
+  } else
+    closeSocket(sp, cAll, by);
+  _SFCB_EXIT();
+}
+
 ComSockets
 getSocketPair(char *by)
 {
   ComSockets      sp;
   _SFCB_ENTER(TRACE_MSGQUEUE | TRACE_SOCKETS, "getSocketPair");
 
-  socketpair(PF_LOCAL, SOCK_STREAM, 0, &sp.receive);
+  if (getPooledSocketPair(&sp)) {
+    _SFCB_TRACE(1, ("--- %s reusing pooled pair", by));
+  } else
+    socketpair(PF_LOCAL, SOCK_STREAM, 0, &sp.receive);
   _SFCB_TRACE(1,
               ("--- %s rcv: %d - %d %d", by, sp.receive,
                getInode(sp.receive), currentProc));
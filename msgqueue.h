@@ -33,6 +33,7 @@
 
 #define MSG_DATA 1
 #define MSG_CTL 2
+#define MSG_SHM 3
 
 #define MSG_X_HTTP_STOPPING      1
 #define MSG_X_NOT_SUPPORTED      2
@@ -121,9 +122,11 @@ extern ComSockets sfcbSockets;
 extern ComSockets providerSockets;
 extern ComSockets resultSockets;
 extern int      localMode;
+extern int      classRelativeResults;
 
 extern ComSockets getSocketPair(char *by);
 extern void     closeSocket(ComSockets * sp, ComCloseOpt o, char *by);
+extern void     releaseSocketPair(ComSockets * sp, char *by);
 
 extern int      spRecvCtlResult(int *s, int *from, void **data,
                                 unsigned long *length);
@@ -150,6 +153,7 @@ extern int      semMultiRelease(int semid, int semnum, int n);
 extern int      semGetValue(int semid, int semnum);
 extern int      semSetValue(int semid, int semnum, int value);
 extern int      initSem(int provs);
+extern void     bumpProvGeneration();
 
 extern int      provProcSem;
 extern int      provWorkSem;
@@ -170,13 +174,18 @@ extern char    *httpPauseStr;
 
 #define INIT_CLASS_PROV_ID 0
 #define INIT_PROV_MGR_ID 1
+/*
+ * provider routing generation, bumped whenever provider routing cached
+ * by request processes may be stale 
+ */
+#define PROV_GEN_ID 2
 
 
 /*
  * PROV_PROC_BASE_ID must be updated if the number of id's in the above
  * block changes. 
  */
-#define PROV_PROC_BASE_ID 2
+#define PROV_PROC_BASE_ID 3
 
 /*
  * constants for calculating per process ids 
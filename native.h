@@ -117,8 +117,13 @@ extern CMPIBrokerMemFT *CMPI_BrokerMem_Ftab;
 
 MsgSegment      setObjectPathMsgSegment(const CMPIObjectPath * op);
 CMPIInstance   *relocateSerializedInstance(void *area);
+int             checkSerializedInstance(void *area);
 void            getSerializedInstance(const CMPIInstance *ci, void *area);
 unsigned long   getInstanceSerializedSize(const CMPIInstance *ci);
+unsigned long   getCompactInstanceSerializedSize(const CMPIInstance *ci,
+                                                 void **layout);
+void            getCompactSerializedInstance(const CMPIInstance *ci,
+                                             void *layout, void *area);
 void            getSerializedObjectPath(const CMPIObjectPath * op,
                                         void *area);
 unsigned long   getObjectPathSerializedSize(const CMPIObjectPath * op);
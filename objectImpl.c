@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
 #include <netinet/in.h>
 
 #include "objectImpl.h"
@@ -125,7 +126,8 @@ ClVerifyObjImplLevel(ClVersionRecord * vr)
   vr->options = ntohs(vr->options);
   vr->objImplLevel = ntohs(vr->objImplLevel);
 
-  return (vr->objImplLevel == ClCurrentObjImplLevel);
+  return (vr->objImplLevel >= ClMinObjImplLevel &&
+          vr->objImplLevel <= ClCurrentObjImplLevel);
 }
 
 static void
@@ -134,6 +136,24 @@ clearClSection(ClSection * s)
   memset(s, 0, sizeof(*s));
 }
 
+/*
+ * name of the property at position slot of the class a class relative
+ * instance was encoded against
+ */
+static const char *
+getLayoutName(ClObjectHdr * hdr, long slot)
+{
+  ClClass        *cls = NULL;
+  ClProperty     *p;
+
+  if (hdr->type == HDR_Instance && (hdr->flags & HDR_ClassRelative))
+    cls = ((ClInstance *) hdr)->layout;
+  if (cls == NULL || slot >= cls->properties.used)
+    return "";
+  p = (ClProperty *) getSectionPtr(&cls->hdr, &cls->properties);
+  return ClObjectGetClString(&cls->hdr, &(p + slot)->id);
+}
+
 const char     *
 ClObjectGetClString(ClObjectHdr * hdr, ClString * id)
 {
@@ -141,6 +161,8 @@ ClObjectGetClString(ClObjectHdr * hdr, ClString * id)
 
   if (id->id == 0)
     return NULL;
+  if (id->id < 0)
+    return getLayoutName(hdr, -id->id - 1);
   buf = getStrBufPtr(hdr);
   return &(buf->buf[buf->indexPtr[id->id - 1]]);
 }
@@ -1441,13 +1463,143 @@ ClClassGetMethParamQualifierAt(ClClass * cls, ClParameter * parm, int id,
 // -----
 // -------------------------------------------------------
 
+/*
+ * Rebuilt classes and instances with at least PROP_INDEX_MIN properties
+ * carry a hash table over the case folded property names. It sits at the
+ * very end of the block, so it travels with the object and readers not
+ * knowing HDR_PropIndex just skip it:
+ *
+ *   ... | pad | unsigned short slot[slots] | ClPropIndex | hdr.size
+ *
+ * A slot holds the property position + 1, 0 marks it free. Once the
+ * properties are changed in place the object is flagged HDR_Rebuild and
+ * the index is ignored until the next rebuild.
+ */
+
+#define PROP_INDEX_MIN 8
+#define PROP_INDEX_MAX 0x3fff   /* keeps slots within an unsigned short */
+
+typedef struct {
+  unsigned int    sectionOffset;        /* properties section indexed */
+  unsigned short  slots,        /* power of 2 */
+                  count;        /* properties indexed */
+} ClPropIndex;
+
+static unsigned int
+propNameHash(const char *id)
+{
+  unsigned int    h = 2166136261U;
+
+  for (; *id; id++)
+    h = (h ^ tolower((unsigned char) *id)) * 16777619U;
+  return h;
+}
+
+static int
+wantPropIndex(ClSection * s)
+{
+  return s->used >= PROP_INDEX_MIN && s->used <= PROP_INDEX_MAX;
+}
+
+static unsigned short
+propIndexSlots(int used)
+{
+  unsigned short  n = 16;
+
+  while (n < used * 2)
+    n <<= 1;
+  return n;
+}
+
+static long
+sizePropIndex(ClSection * s)
+{
+  if (!wantPropIndex(s))
+    return 0;
+  return ALIGN(propIndexSlots(s->used) * sizeof(unsigned short) +
+               sizeof(ClPropIndex), CLALIGN);
+}
+
+/*
+ * builds the index into the last bytes of a rebuilt object whose string
+ * buffer and properties are already in place
+ */
+static void
+buildPropIndex(ClObjectHdr * hdr, ClSection * s)
+{
+  ClPropIndex    *pi;
+  ClProperty     *p;
+  unsigned short *slot;
+  unsigned int    h;
+  int             i;
+
+  hdr->flags &= ~HDR_PropIndex;
+  if (!wantPropIndex(s))
+    return;
+
+  pi = (ClPropIndex *) ((char *) hdr + hdr->size - sizeof(ClPropIndex));
+  pi->sectionOffset = s->sectionOffset;
+  pi->slots = propIndexSlots(s->used);
+  pi->count = s->used;
+  slot = (unsigned short *) pi - pi->slots;
+  memset(slot, 0, pi->slots * sizeof(unsigned short));
+
+  p = (ClProperty *) getSectionPtr(hdr, s);
+  for (i = 0; i < s->used; i++) {
+    h = propNameHash(ClObjectGetClString(hdr, &(p + i)->id));
+    while (slot[h & (pi->slots - 1)])
+      h++;
+    slot[h & (pi->slots - 1)] = i + 1;
+  }
+  hdr->flags |= HDR_PropIndex;
+}
+
+static ClPropIndex *
+getPropIndex(ClObjectHdr * hdr, ClSection * s)
+{
+  ClPropIndex    *pi;
+
+  if ((hdr->flags & (HDR_PropIndex | HDR_Rebuild)) != HDR_PropIndex ||
+      isMallocedSection(s))
+    return NULL;
+  pi = (ClPropIndex *) ((char *) hdr + hdr->size - sizeof(ClPropIndex));
+  if ((long) pi->sectionOffset != s->sectionOffset || pi->count != s->used)
+    return NULL;
+  return pi;
+}
+
 int
 ClObjectLocateProperty(ClObjectHdr * hdr, ClSection * prps, const char *id)
 {
   int             i;
   ClProperty     *p;
+  ClPropIndex    *pi;
+  unsigned short *slot;
+  unsigned int    h;
 
   p = (ClProperty *) getSectionPtr(hdr, prps);
+
+  /* class relative names are looked up in the class */
+  if ((hdr->flags & HDR_ClassRelative) && hdr->type == HDR_Instance &&
+      ((ClInstance *) hdr)->layout) {
+    ClClass        *cls = ((ClInstance *) hdr)->layout;
+    long            s = ClObjectLocateProperty(&cls->hdr, &cls->properties,
+                                               id);
+    for (i = 0; s && i < prps->used; i++) {
+      if ((p + i)->id.id == -s)
+        return i + 1;
+    }
+  }
+
+  if ((pi = getPropIndex(hdr, prps))) {
+    slot = (unsigned short *) pi - pi->slots;
+    for (h = propNameHash(id); (i = slot[h & (pi->slots - 1)]); h++) {
+      if (strcasecmp(id, ClObjectGetClString(hdr, &(p + i - 1)->id)) == 0)
+        return i;
+    }
+    return 0;
+  }
+
   for (i = 0; i < prps->used; i++) {
     if (strcasecmp(id, ClObjectGetClString(hdr, &(p + i)->id)) == 0)
       return i + 1;
@@ -1860,6 +2012,7 @@ sizeClassH(ClObjectHdr * hdr, ClClass * cls)
   sz += sizeMethods(hdr, &cls->methods);
   sz += sizeStringBuf(hdr);
   sz += sizeArrayBuf(hdr);
+  sz += sizePropIndex(&cls->properties);
 
   return ALIGN(sz, CLALIGN);
 }
@@ -1893,6 +2046,7 @@ rebuildClassH(ClObjectHdr * hdr, ClClass * cls, void *area)
   ofs += copyArrayBuf(ofs, &nc->hdr, hdr);
 
   nc->hdr.size = ALIGN(sz, CLALIGN);
+  buildPropIndex(&nc->hdr, &nc->properties);
 
   if (CLEXTRA)
     memcpy(((char *) nc) + sz - 4, "%%%%", 4);
@@ -2252,6 +2406,268 @@ ClInstanceNewFromMof(const char *ns, const char *cn)
   return inst;
 }
 
+/*
+ * Class relative instances (ClCurrentObjImplLevel 4)
+ *
+ * Instances returned by providers are usually complete instances of a
+ * class the receiver knows as well, so their property names need not
+ * travel with every one of them. ClInstanceRebuildCompact() cuts the
+ * names in the string buffer down to empty strings and sets each property id to
+ * -(position + 1) within the class properties; inst->layoutId holds the
+ * layout id of that class, a hash of its property names and types. The
+ * receiver checks the id and points inst->layout at its own copy of the
+ * class, whose names ClObjectGetClString() then returns.
+ *
+ * Rebuilding a class relative instance puts the names back, so clones
+ * and anything stored are in the full form again.
+ */
+
+typedef struct {
+  int             ofs,
+                  len;
+} NameRange;
+
+static int
+cmpNameRange(const void *a, const void *b)
+{
+  return ((NameRange *) a)->ofs - ((NameRange *) b)->ofs;
+}
+
+unsigned int
+ClClassLayoutId(ClClass * cls)
+{
+  ClProperty     *p =
+      (ClProperty *) getSectionPtr(&cls->hdr, &cls->properties);
+  unsigned int    h = 2166136261U ^ cls->properties.used;
+  const char     *n;
+  int             i;
+
+  for (i = 0; i < cls->properties.used; i++) {
+    for (n = ClObjectGetClString(&cls->hdr, &(p + i)->id); *n; n++)
+      h = (h ^ tolower((unsigned char) *n)) * 16777619U;
+    h = (h ^ (p + i)->data.type) * 16777619U;
+  }
+  return h;
+}
+
+int
+ClInstanceIsClassRelative(ClInstance * inst)
+{
+  return (inst->hdr.flags & HDR_ClassRelative) != 0;
+}
+
+/*
+ * valid until ClInstanceSetLayout() is called
+ */
+unsigned int
+ClInstanceLayoutId(ClInstance * inst)
+{
+  return inst->layoutId;
+}
+
+/*
+ * returns -1, leaving the names empty, if layout is not the class inst
+ * was encoded against
+ */
+int
+ClInstanceSetLayout(ClInstance * inst, ClClass * layout,
+                    unsigned int layoutId)
+{
+  if (layout == NULL || inst->layoutId != layoutId) {
+    inst->layout = NULL;
+    return -1;
+  }
+  inst->layout = layout;
+  return 0;
+}
+
+static long
+sizeLayoutNames(ClObjectHdr * hdr, ClSection * s)
+{
+  ClProperty     *p = (ClProperty *) getSectionPtr(hdr, s);
+  long            sz = 0;
+  int             i;
+
+  for (i = 0; i < s->used; i++) {
+    if ((p + i)->id.id < 0)
+      sz += strlen(ClObjectGetClString(hdr, &(p + i)->id)) + 1 +
+          sizeof(int);
+  }
+  return ALIGN(sz, CLALIGN);
+}
+
+/*
+ * copies the string buffer of class relative fh, adding the names of
+ * the properties in ts and giving them their ids
+ */
+static long
+copyLayoutNames(int ofs, ClObjectHdr * th, ClSection * ts,
+                ClObjectHdr * fh)
+{
+  ClStrBuf       *fb = getStrBufPtr(fh),
+      *tb = (ClStrBuf *) (((char *) th) + ofs);
+  ClProperty     *p = (ClProperty *) getSectionPtr(th, ts);
+  const char     *n;
+  long            l = 0,
+      bl;
+  int             i,
+                  nl;
+
+  for (i = 0; i < ts->used; i++) {
+    if ((p + i)->id.id < 0)
+      l += strlen(ClObjectGetClString(fh, &(p + i)->id)) + 1;
+  }
+
+  memcpy(tb, fb, sizeof(*fb) + fb->bUsed);
+  setStrBufOffset(th, ofs);
+  bl = ALIGN(sizeof(*fb) + fb->bUsed + l, 4);
+  memcpy(((char *) th) + ofs + bl, fb->indexPtr,
+         fb->iUsed * sizeof(*fb->indexPtr));
+  setStrIndexOffset(th, tb, ofs + bl);
+
+  for (i = 0; i < ts->used; i++) {
+    if ((p + i)->id.id < 0) {
+      n = ClObjectGetClString(fh, &(p + i)->id);
+      nl = strlen(n) + 1;
+      memcpy(tb->buf + tb->bUsed, n, nl);
+      tb->indexPtr[tb->iUsed++] = tb->bUsed;
+      tb->bUsed += nl;
+      (p + i)->id.id = tb->iUsed;
+    }
+  }
+  tb->bMax = tb->bUsed;
+  tb->iMax = tb->iUsed;
+
+  return ALIGN(bl + tb->iUsed * sizeof(*tb->indexPtr), CLALIGN);
+}
+
+/*
+ * copies the string buffer of fh with the names of the properties in ts
+ * cut down to empty strings, and makes their ids their positions in
+ * layout; the empty strings keep the index entries distinct for
+ * replaceClStringN()
+ */
+static long
+copyCompactStringBuf(int ofs, ClObjectHdr * th, ClSection * ts,
+                     ClObjectHdr * fh, ClClass * layout)
+{
+  ClStrBuf       *fb = getStrBufPtr(fh),
+      *tb = (ClStrBuf *) (((char *) th) + ofs);
+  ClProperty     *p = (ClProperty *) getSectionPtr(th, ts);
+  NameRange      *r = malloc(ts->used * sizeof(*r));
+  int            *idx;
+  long            l = 0,
+      bl;
+  int             i,
+                  lo,
+                  hi,
+                  from = 0,
+      n = ts->used;
+
+  for (i = 0; i < n; i++) {
+    r[i].ofs = fb->indexPtr[(p + i)->id.id - 1];
+    r[i].len = strlen(fb->buf + r[i].ofs);
+    (p + i)->id.id = -ClObjectLocateProperty(&layout->hdr,
+                                             &layout->properties,
+                                             fb->buf + r[i].ofs);
+  }
+  qsort(r, n, sizeof(*r), cmpNameRange);
+
+  memcpy(tb, fb, sizeof(*fb));
+  for (i = 0; i < n; i++) {
+    memcpy(tb->buf + l, fb->buf + from, r[i].ofs - from);
+    l += r[i].ofs - from;
+    from = r[i].ofs + r[i].len;
+    /* from now on the bytes left out up to here */
+    r[i].len = from - l;
+  }
+  memcpy(tb->buf + l, fb->buf + from, fb->bUsed - from);
+  l += fb->bUsed - from;
+  tb->bUsed = tb->bMax = l;
+  setStrBufOffset(th, ofs);
+
+  bl = ALIGN(sizeof(*fb) + l, 4);
+  idx = (int *) (((char *) th) + ofs + bl);
+  for (i = 0; i < fb->iUsed; i++) {
+    /* count the names in front of this string */
+    for (lo = 0, hi = n; lo < hi;) {
+      if (r[(lo + hi) / 2].ofs < fb->indexPtr[i])
+        lo = (lo + hi) / 2 + 1;
+      else
+        hi = (lo + hi) / 2;
+    }
+    idx[i] = fb->indexPtr[i] - (lo ? r[lo - 1].len : 0);
+  }
+  tb->iMax = tb->iUsed;
+  setStrIndexOffset(th, tb, ofs + bl);
+  free(r);
+
+  return ALIGN(bl + tb->iUsed * sizeof(*tb->indexPtr), CLALIGN);
+}
+
+/*
+ * returns 0 if inst has properties layout does not know
+ */
+unsigned long
+ClSizeInstanceCompact(ClInstance * inst, ClClass * layout)
+{
+  ClObjectHdr    *hdr = &inst->hdr;
+  ClProperty     *p = (ClProperty *) getSectionPtr(hdr, &inst->properties);
+  ClStrBuf       *buf;
+  const char     *n;
+  long            sz = sizeof(*inst),
+      names = 0;
+  int             i;
+
+  if ((hdr->flags & HDR_ClassRelative) || inst->properties.used == 0)
+    return 0;
+  for (i = 0; i < inst->properties.used; i++) {
+    n = ClObjectGetClString(hdr, &(p + i)->id);
+    if (ClObjectLocateProperty(&layout->hdr, &layout->properties, n) == 0)
+      return 0;
+    names += strlen(n);
+  }
+
+  buf = getStrBufPtr(hdr);
+  sz += sizeQualifiers(&inst->qualifiers);
+  sz += sizeProperties(hdr, &inst->properties);
+  sz += ALIGN(sizeof(*buf) + ALIGN(buf->bUsed - names, 4) +
+              buf->iUsed * sizeof(*buf->indexPtr), CLALIGN);
+  sz += sizeArrayBuf(hdr);
+
+  return ALIGN(sz, CLALIGN);
+}
+
+/*
+ * inst must have passed ClSizeInstanceCompact(); layoutId is
+ * ClClassLayoutId(layout)
+ */
+ClInstance     *
+ClInstanceRebuildCompact(ClInstance * inst, ClClass * layout,
+                         unsigned int layoutId, void *area)
+{
+  ClObjectHdr    *hdr = &inst->hdr;
+  int             ofs = sizeof(ClInstance);
+  int             sz = ClSizeInstanceCompact(inst, layout);
+  ClInstance     *ni = area ? (ClInstance *) area : malloc(sz);
+
+  *ni = *inst;
+  ni->hdr.flags &= ~(HDR_Rebuild | HDR_PropIndex);
+  ni->hdr.flags |= HDR_ClassRelative;
+  ni->layout = NULL;
+  ni->layoutId = layoutId;
+  ofs += copyQualifiers(ofs, (char *) ni, &ni->qualifiers, hdr,
+                        &inst->qualifiers);
+  ofs += copyProperties(ofs, (char *) ni, &ni->properties, hdr,
+                        &inst->properties);
+  ofs += copyCompactStringBuf(ofs, &ni->hdr, &ni->properties, hdr, layout);
+  ofs += copyArrayBuf(ofs, &ni->hdr, hdr);
+
+  ni->hdr.size = ALIGN(sz, CLALIGN);
+
+  return ni;
+}
+
 static long
 sizeInstanceH(ClObjectHdr * hdr, ClInstance * inst)
 {
@@ -2260,7 +2676,10 @@ sizeInstanceH(ClObjectHdr * hdr, ClInstance * inst)
   sz += sizeQualifiers(&inst->qualifiers);
   sz += sizeProperties(hdr, &inst->properties);
   sz += sizeStringBuf(hdr);
+  if (hdr->flags & HDR_ClassRelative)
+    sz += sizeLayoutNames(hdr, &inst->properties);
   sz += sizeArrayBuf(hdr);
+  sz += sizePropIndex(&inst->properties);
 
   return ALIGN(sz, CLALIGN);
 }
@@ -2284,10 +2703,16 @@ rebuildInstanceH(ClObjectHdr * hdr, ClInstance * inst, void *area)
                         &inst->qualifiers);
   ofs += copyProperties(ofs, (char *) ni, &ni->properties, hdr,
                         &inst->properties);
-  ofs += copyStringBuf(ofs, &ni->hdr, hdr);
+  if (hdr->flags & HDR_ClassRelative) {
+    ofs += copyLayoutNames(ofs, &ni->hdr, &ni->properties, hdr);
+    ni->hdr.flags &= ~HDR_ClassRelative;
+    ni->path = NULL;
+  } else
+    ofs += copyStringBuf(ofs, &ni->hdr, hdr);
   ofs += copyArrayBuf(ofs, &ni->hdr, hdr);
 
   ni->hdr.size = ALIGN(sz, CLALIGN);
+  buildPropIndex(&ni->hdr, &ni->properties);
 
   return ni;
 }
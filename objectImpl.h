@@ -46,7 +46,12 @@
 #define ClTypeClassRep 1
 #define ClTypeClassReducedRep 2
 
-#define ClCurrentObjImplLevel 3
+#define ClCurrentObjImplLevel 4
+/*
+ * level 4 added class relative instances (HDR_ClassRelative), which are
+ * only exchanged between processes; level 3 repositories read as before
+ */
+#define ClMinObjImplLevel 3
 
 #define GetLo15b(x) (x&0x7fff)
 #define GetHi1b(x)  (x&0x8000)
@@ -158,6 +163,8 @@ typedef struct {
 #define HDR_ArrayBufferMalloced 32
 #define HDR_FromMof 64
 #define HDR_HasFilteredProps 128
+#define HDR_PropIndex 256        // rebuilt block ends with a property index
+#define HDR_ClassRelative 512    // property names come from inst->layout
 #endif
   unsigned short  type;
 #ifndef SETCLPFX
@@ -230,7 +237,11 @@ typedef struct {
                   PFX(CLPFX, ClString) nameSpace;
                   PFX(CLPFX, ClSection) qualifiers;
                   PFX(CLPFX, ClSection) properties;
-                  PFX(CLPFX, ClObjectPath) * path;
+  union {
+    PFX(CLPFX, ClObjectPath) * path;
+    PFX(CLPFX, ClClass) * layout;       // HDR_ClassRelative only
+    unsigned int    layoutId;   // HDR_ClassRelative, until relocated
+  };
 } PFX           (CLPFX, ClInstance);
 
 typedef struct {
@@ -529,6 +540,17 @@ extern ClInstance *ClInstanceNewFromMof(const char *ns, const char *cn);
 extern unsigned long ClSizeInstance(ClInstance * inst);
 extern ClInstance *ClInstanceRebuild(ClInstance * inst, void *area);
 extern void     ClInstanceRelocateInstance(ClInstance * inst);
+extern unsigned int ClClassLayoutId(ClClass * cls);
+extern unsigned long ClSizeInstanceCompact(ClInstance * inst,
+                                           ClClass * layout);
+extern ClInstance *ClInstanceRebuildCompact(ClInstance * inst,
+                                            ClClass * layout,
+                                            unsigned int layoutId,
+                                            void *area);
+extern int      ClInstanceIsClassRelative(ClInstance * inst);
+extern unsigned int ClInstanceLayoutId(ClInstance * inst);
+extern int      ClInstanceSetLayout(ClInstance * inst, ClClass * layout,
+                                    unsigned int layoutId);
 extern void     ClInstanceFree(ClInstance * inst);
 extern char    *ClInstanceToString(ClInstance * inst);
 extern int      ClInstanceGetPropertyCount(ClInstance * inst);
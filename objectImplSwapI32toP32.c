@@ -519,7 +519,7 @@ swapI32toP32Class(ClClass * cls, unsigned int *size)
   CLP32_ClClass  *nc = calloc(1, sz);
 
   nc->hdr.size = bswap_32(sz);
-  nc->hdr.flags = bswap_16(hdr->flags);
+  nc->hdr.flags = bswap_16(hdr->flags & ~HDR_PropIndex);
   nc->hdr.type = bswap_16(hdr->type);
 
   nc->quals = cls->quals;
@@ -560,7 +560,7 @@ swapI32toP32Instance(ClInstance * inst, int *size)
   CLP32_ClInstance *ni = calloc(1, sz);
 
   ni->hdr.size = bswap_32(sz);
-  ni->hdr.flags = bswap_16(hdr->flags);
+  ni->hdr.flags = bswap_16(hdr->flags & ~HDR_PropIndex);
   ni->hdr.type = bswap_16(hdr->type);
 
   ni->quals = inst->quals;
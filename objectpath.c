@@ -69,7 +69,7 @@ __oft_release(CMPIObjectPath * cop)
     ClObjectPathFree((ClObjectPath *) cop->hdl);
     memUnlinkEncObj(o->mem_state);
     o->mem_state = MEM_RELEASED;
-    free(cop);
+    memFree(cop);
     CMReturn(CMPI_RC_OK);
   }
 
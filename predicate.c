@@ -45,7 +45,7 @@ __eft_release(CMPIPredicate *pred)
   if (p->mem_state && p->mem_state != MEM_RELEASED) {
     memUnlinkEncObj(p->mem_state);
     p->mem_state = MEM_RELEASED;
-    free(p);
+    memFree(p);
     CMReturn(CMPI_RC_OK);
   }
   CMReturn(CMPI_RC_ERR_FAILED);
@@ -122,7 +122,7 @@ extern unsigned long exFlags;
 extern ProviderRegister *pReg;
 extern ProviderInfo *classProvInfoPtr;
 
-extern void     processProviderInvocationRequests(char *);
+extern void     processProviderInvocationRequests(ProviderInfo *);
 extern CMPIObjectPath *relocateSerializedObjectPath(void *area);
 extern MsgSegment setInstanceMsgSegment(CMPIInstance *op);
 extern MsgSegment setArgsMsgSegment(CMPIArgs * args);
@@ -139,6 +139,8 @@ extern void     showClHdr(void *ihdr);
 extern ProvIds  getProvIds(ProviderInfo * info);
 extern int      xferLastResultBuffer(CMPIResult *result, int to, int rc);
 extern void     setResultQueryFilter(CMPIResult *result, QLStatement * qs);
+extern void     setResultClassRelative(CMPIResult *result,
+                                       int classRelative);
 extern CMPIArray *getKeyListAndVerifyPropertyList(CMPIObjectPath *,
                                                   char **props, int *ok,
                                                   CMPIStatus *rc);
@@ -152,6 +154,8 @@ extern CMPISelectExp *NewCMPISelectExp(const char *queryString,
                                        CMPIArray **projection,
                                        CMPIStatus *rc);
 NativeSelectExp *activFilters = NULL;
+unsigned long   activFiltersGen = 0;   /* bumped on every change of
+                                        * activFilters */
 extern void     setStatus(CMPIStatus *st, CMPIrc rc, char *msg);
 
 static ProviderProcess *provProc = NULL,
@@ -179,12 +183,44 @@ typedef struct parms {
   int             requestor;
   BinRequestHdr  *req;
   ProviderInfo   *pInfo;
+  struct timeval  queued;
   struct parms   *next,
                  *prev;
 } Parms;
 static Parms   *activeThreadsFirst = NULL,
     *activeThreadsLast = NULL;
 
+/*
+ * requests waiting for a worker thread of the provider process
+ */
+typedef struct workQueue {
+  pthread_mutex_t mtx;
+  pthread_cond_t  cnd;
+  Parms          *first,
+                 *last;
+  long            depth,
+                  maxDepth,
+                  threads,
+                  maxThreads,
+                  idle,
+                  blocked;      /* workers in an upcall, not counted
+                                 * against maxThreads */
+  unsigned long   served,
+                  rejected;
+  double          waitTotal,
+                  waitMax;
+} WorkQueue;
+static WorkQueue workQueue = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+  NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0.0, 0.0
+};
+static pthread_key_t workerKey;
+static pthread_once_t workerKeyOnce = PTHREAD_ONCE_INIT;
+static long     queuedProviderRequests();
+
+#define CIM_ERR_SERVER_LIMITS_EXCEEDED 27
+static void     dumpWorkQueueStats();
+
 /*
  * old version support 
  */
@@ -323,6 +359,7 @@ testStartedProc(int pid, int *left)
     if ((pp + i)->pid == pid) {
       stopped = 1;
       (pp + i)->pid = 0;
+      bumpProvGeneration();
       if (pReg)
          pReg->ft->resetProvider(pReg, pid);
     }
@@ -450,6 +487,7 @@ stopProc()
       cleanedProvs[cpli].types |= IND;
     }
   }
+  dumpWorkQueueStats();
   mlogf(M_INFO, M_SHOW, "---  stopped %s %d\n", processName, getpid());
   ctx->ft->release(ctx);
 
@@ -484,6 +522,9 @@ handleSigSegv(int __attribute__ ((unused)) sig)
     spSendResult(&threads->requestor, &dmy, err_crash_resp, ecr_len);
     threads=threads->next;
   }
+  /* requests still waiting for a worker get the same answer */
+  for (threads = workQueue.first; threads; threads = threads->next)
+    spSendResult(&threads->requestor, &dmy, err_crash_resp, ecr_len);
   abort(); /* force cord dump */
 }
 
@@ -569,7 +610,9 @@ providerIdleThread()
                   proc->id, strerror(errno));
             _SFCB_ABORT();
           }
-          if ((val=semGetValue(sfcbSem,PROV_INUSE(proc->id)))==0) {            
+          /* requests still waiting for a worker keep us too */
+          if ((val=semGetValue(sfcbSem,PROV_INUSE(proc->id)))==0 &&
+              queuedProviderRequests() == 0) {
 	    /* providerTimeoutInterval reached? */
             if ((unsigned long)(now - proc->lastActivity) > provTimeoutInterval) { 
               ctx = native_new_CMPIContext(MEM_TRACKED, NULL);
@@ -650,6 +693,7 @@ providerIdleThread()
 	      /* exit unless prov asks us not to, or returned bad cleanup rc */
               if (doNotExit == 0) {
                 dumpTiming(currentProc);
+                dumpWorkQueueStats();
                 _SFCB_TRACE(1,
                             ("--- Exiting %s-%d", processName,
                              currentProc));
@@ -876,6 +920,8 @@ getProcess(ProviderInfo * info, ProviderProcess ** proc)
       info->proc = *proc;
       info->next = NULL;
 
+      /* before the new process becomes alive for cached routings */
+      bumpProvGeneration();
       (*proc)->pid = info->pid = fork();
 
       if (info->pid < 0) {
@@ -965,7 +1011,7 @@ getProcess(ProviderInfo * info, ProviderProcess ** proc)
         ecr_len = makeSafeResponse(buf, &err_crash_resp);
 	free(buf);
 
-        processProviderInvocationRequests(info->providerName);
+        processProviderInvocationRequests(info);
         _SFCB_RETURN(0);
       }
 
@@ -2138,6 +2184,8 @@ enumInstances(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
   CMPIFlags       flgs = 0;
   char          **props = NULL;
 
+  setResultClassRelative(result, hdr->options & BRH_ClassRelative);
+
 #ifndef HAVE_OPTIMIZED_ENUMERATION
   REPLACE_CN(info,path);
 #endif
@@ -2313,6 +2361,8 @@ execQuery(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
   CMPIFlags       flgs = 0;
   int             irc;
 
+  setResultClassRelative(result, hdr->options & BRH_ClassRelative);
+
   ctx->ft->addEntry(ctx, CMPIInvocationFlags, (CMPIValue *) & flgs,
                     CMPI_uint32);
   ctx->ft->addEntry(ctx, CMPIPrincipal, (CMPIValue *) req->principal.data,
@@ -2714,6 +2764,7 @@ activateFilter(BinRequestHdr * hdr, ProviderInfo * info, int __attribute__ ((unu
     se->filterId = req->filterId;
     prev = se->next = activFilters;
     activFilters = se;
+    activFiltersGen++;
     _SFCB_TRACE(1, ("--- new selExp:  %p", se));
   }
 
@@ -2783,6 +2834,7 @@ activateFilter(BinRequestHdr * hdr, ProviderInfo * info, int __attribute__ ((unu
 
   if (rci.rc != CMPI_RC_OK) {
     activFilters = prev;
+    activFiltersGen++;
     resp = errorResp(&rci);
     _SFCB_TRACE(1, ("--- Not OK rc: %d", rci.rc));
   } else {
@@ -2869,6 +2921,7 @@ deactivateFilter(BinRequestHdr * hdr, ProviderInfo * info, int __attribute__ ((u
         else {
            prev->next = se->next;
         }
+        activFiltersGen++;
         _SFCB_TRACE(1, ("---- pid:%d, freeing: %p", currentProc, se));
         CMRelease((CMPISelectExp *)se);
         _SFCB_RETURN(resp);
@@ -3557,14 +3610,199 @@ pauseProvider(char *name)
   return 0;
 }
 
+static void
+dumpWorkQueueStats()
+{
+  WorkQueue      *wq = &workQueue;
+
+  pthread_mutex_lock(&wq->mtx);
+  if (wq->served || wq->rejected)
+    mlogf(M_INFO, M_SHOW,
+          "--- %s-%d: %lu requests, %lu rejected, %ld threads, "
+          "queue wait avg %f max %f\n", processName, currentProc,
+          wq->served, wq->rejected, wq->threads,
+          wq->served ? wq->waitTotal / wq->served : 0.0, wq->waitMax);
+  pthread_mutex_unlock(&wq->mtx);
+}
+
+static void
+makeWorkerKey()
+{
+  pthread_key_create(&workerKey, NULL);
+}
+
+/*
+ * number of requests waiting for a worker
+ */
+static long
+queuedProviderRequests()
+{
+  long            depth;
+
+  pthread_mutex_lock(&workQueue.mtx);
+  depth = workQueue.depth;
+  pthread_mutex_unlock(&workQueue.mtx);
+  return depth;
+}
+
+static void    *providerWorkerThread(void *arg);
+
+/*
+ * starts another worker if requests are waiting for one and the pool is
+ * not at its size yet; wq->mtx is held
+ */
+static void
+addProviderWorker(WorkQueue * wq)
+{
+  pthread_t       t;
+  pthread_attr_t  tattr;
+
+  if (wq->depth <= wq->idle || wq->threads - wq->blocked >= wq->maxThreads)
+    return;
+  pthread_attr_init(&tattr);
+  pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&t, &tattr, providerWorkerThread, NULL) == 0)
+    wq->threads++;
+  else if (wq->threads == 0)
+    mlogf(M_ERROR, M_SHOW,
+          "pthread_create() failed for provider worker thread\n");
+  pthread_attr_destroy(&tattr);
+}
+
+/*
+ * called around upcalls and around waits for the requestor's ack of a
+ * result chunk; a worker making an upcall may wait for a request queued
+ * behind it in this very process, and an ack may be held back as long as
+ * an enumeration context stays open, so while it waits, another worker
+ * may take its place in the pool
+ */
+void
+upcallBlocking(int blocking)
+{
+  WorkQueue      *wq = &workQueue;
+
+  pthread_once(&workerKeyOnce, makeWorkerKey);
+  if (pthread_getspecific(workerKey) == NULL)
+    return;
+
+  pthread_mutex_lock(&wq->mtx);
+  if (blocking) {
+    wq->blocked++;
+    addProviderWorker(wq);
+  } else
+    wq->blocked--;
+  pthread_mutex_unlock(&wq->mtx);
+}
+
+static void    *
+providerWorkerThread(void __attribute__ ((unused)) *arg)
+{
+  WorkQueue      *wq = &workQueue;
+  Parms          *parms;
+  struct timeval  now;
+  double          wait;
+
+  _SFCB_ENTER(TRACE_PROVIDERDRV, "providerWorkerThread");
+
+  pthread_once(&workerKeyOnce, makeWorkerKey);
+  pthread_setspecific(workerKey, wq);
+
+  for (;;) {
+    pthread_mutex_lock(&wq->mtx);
+    /* workers added for blocked ones leave once those are back */
+    if (wq->threads - wq->blocked > wq->maxThreads) {
+      wq->threads--;
+      pthread_mutex_unlock(&wq->mtx);
+      break;
+    }
+    wq->idle++;
+    while (wq->first == NULL)
+      pthread_cond_wait(&wq->cnd, &wq->mtx);
+    wq->idle--;
+    parms = wq->first;
+    DEQ_FROM_LIST(parms, wq->first, wq->last, next, prev);
+    wq->depth--;
+
+    gettimeofday(&now, NULL);
+    wait = timevalDiff(&parms->queued, &now);
+    wq->served++;
+    wq->waitTotal += wait;
+    if (wait > wq->waitMax)
+      wq->waitMax = wait;
+    pthread_mutex_unlock(&wq->mtx);
+
+    _SFCB_TRACE(1, ("--- op:%d waited %f, %ld still queued",
+                    parms->req->operation, wait, wq->depth));
+    processProviderInvocationRequestsThread(parms);
+  }
+  _SFCB_RETURN(NULL);
+}
+
+/*
+ * hand a request to the worker pool, starting another worker if none is
+ * idle and the pool is not at its size yet; returns 0 if the queue is full
+ */
+static int
+queueProviderRequest(Parms * parms)
+{
+  WorkQueue      *wq = &workQueue;
+  int             rc = 1;
+
+  _SFCB_ENTER(TRACE_PROVIDERDRV, "queueProviderRequest");
+
+  pthread_mutex_lock(&wq->mtx);
+  if (wq->depth >= wq->idle + wq->maxDepth) {
+    wq->rejected++;
+    rc = 0;
+  } else {
+    gettimeofday(&parms->queued, NULL);
+    ENQ_BOT_LIST(parms, wq->first, wq->last, next, prev);
+    wq->depth++;
+    addProviderWorker(wq);
+    pthread_cond_signal(&wq->cnd);
+  }
+  pthread_mutex_unlock(&wq->mtx);
+  _SFCB_RETURN(rc);
+}
+
+/*
+ * tell the requester that the provider process can not take any more
+ * requests right now
+ */
+static void
+rejectProviderRequest(Parms * parms)
+{
+  BinRequestHdr  *req = parms->req;
+  BinResponseHdr *resp;
+  char            msg[256];
+
+  mlogf(M_ERROR, M_SHOW,
+        "-#- %s-%d request queue full, rejecting request (%d)\n",
+        processName, currentProc, req->operation);
+  if ((req->options & BRH_NoResp) == 0) {
+    snprintf(msg, sizeof(msg), "*** Provider %s(%d) busy, %ld requests queued",
+             processName, currentProc, workQueue.depth);
+    resp = errorCharsResp(CIM_ERR_SERVER_LIMITS_EXCEEDED, msg);
+    sendResponse(abs(parms->requestor), resp);
+    free(resp);
+  }
+  if ((req->options & BRH_Internal) == 0)
+    close(abs(parms->requestor));
+  free(req);
+  free(parms);
+}
+
 void
-processProviderInvocationRequests(char *name)
+processProviderInvocationRequests(ProviderInfo * info)
 {
   unsigned long   rl;
   Parms          *parms;
   int             rc,
                   debugMode = 0,
       once = 1;
+  long            threads,
+                  queueDepth;
+  char           *name = info->providerName;
   pthread_t       t;
   pthread_attr_t  tattr;
   MqgStat         mqg;
@@ -3574,6 +3812,19 @@ processProviderInvocationRequests(char *name)
   pthread_attr_init(&tattr);
   pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
 
+  if (info->threads >= 0)
+    threads = info->threads;
+  else if (getControlNum("providerThreads", &threads))
+    threads = 16;
+  if (info->queueDepth >= 0)
+    queueDepth = info->queueDepth;
+  else if (getControlNum("providerQueueDepth", &queueDepth))
+    queueDepth = 256;
+  workQueue.maxThreads = threads;
+  workQueue.maxDepth = queueDepth;
+  _SFCB_TRACE(1, ("--- %s: %ld worker threads, queue depth %ld", name,
+                  threads, queueDepth));
+
   debugMode = pauseProvider(name);
   for (;;) {
     _SFCB_TRACE(1, ("--- Waiting for provider request to R%d-%lu",
@@ -3609,6 +3860,9 @@ processProviderInvocationRequests(char *name)
 
       if (parms->req->operation == OPS_LoadProvider || debugMode) {
         processProviderInvocationRequestsThread(parms);
+      } else if (workQueue.maxThreads > 0) {
+        if (queueProviderRequest(parms) == 0)
+          rejectProviderRequest(parms);
       } else {
 	int pcrc = pthread_create(&t, &tattr, (void *(*)(void *))
 				  processProviderInvocationRequestsThread,
@@ -24,6 +24,8 @@
 #include <time.h>
 #include <pthread.h>
 #include <sys/resource.h>
+#include <poll.h>
+#include <errno.h>
 
 #include "cmpi/cmpidt.h"
 #include "providerRegister.h"
@@ -31,6 +33,7 @@
 #include <sfcCommon/utilft.h>
 #include "msgqueue.h"
 #include "constClass.h"
+#include "classTree.h"
 #include "cimXmlParser.h"
 #include "support.h"
 #include "native.h"
@@ -93,6 +96,8 @@ extern MsgSegment setArgsMsgSegment(CMPIArgs * args);
 extern void     dump(char *msg, void *a, int l);
 extern void     showClHdr(void *ihdr);
 extern int      forkProvider(ProviderInfo * info, char **msg);
+extern int      getControlNum(char *id, long *val);
+extern int      getControlChars(char *id, char **val);
 
 static int      startUpProvider(const char *ns, const char *name, int noResp);
 
@@ -1153,6 +1158,155 @@ setInuseSem(void *id)
   _SFCB_EXIT();
 }
 
+/*
+ * Provider routing cached by request processes, keyed by namespace,
+ * class and operation type. Entries own duplicates of the provider
+ * sockets. The cache is dropped as a whole once the provider
+ * generation (PROV_GEN_ID) moves on.
+ */
+typedef struct provRoute {
+  unsigned long   count;
+  ProvAddr        as[1];
+} ProvRoute;
+
+static UtilHashTable *provRouteHt = NULL;
+static int      provRouteGen = -1;
+static long     provRouteMax = -1;
+
+static void
+releaseProvRoute(ProvRoute * r)
+{
+  unsigned long   i;
+
+  for (i = 0; i < r->count; i++)
+    close(r->as[i].socket);
+  free(r);
+}
+
+static void
+flushProvRoutes()
+{
+  HashTableIterator *it;
+  char           *key = NULL;
+  ProvRoute      *r = NULL;
+
+  if (provRouteHt == NULL)
+    return;
+
+  for (it = provRouteHt->ft->getFirst(provRouteHt, (void **) &key,
+                                      (void **) &r);
+       key && it && r;
+       it = provRouteHt->ft->getNext(provRouteHt, it, (void **) &key,
+                                     (void **) &r)) {
+    releaseProvRoute(r);
+    free(key);
+  }
+  free(it);
+  provRouteHt->ft->release(provRouteHt);
+  provRouteHt = NULL;
+}
+
+/*
+ * Same as setInuseSem(), but only if the provider process is still
+ * alive and no routing change happened since the route was cached.
+ */
+static int
+claimCachedProvider(ProvIds ids)
+{
+  int             ok;
+
+  if (semAcquireUnDo(sfcbSem, PROV_GUARD(ids.procId))) {
+    mlogf(M_ERROR,M_SHOW,"-#- Fatal error acquiring semaphore for %d, reason: %s\n",
+          ids.procId, strerror(errno));
+    _SFCB_ABORT();
+  }
+  ok = semGetValue(sfcbSem, PROV_ALIVE(ids.procId)) > 0 &&
+      semGetValue(sfcbSem, PROV_GEN_ID) == provRouteGen;
+  if (ok && semReleaseUnDo(sfcbSem, PROV_INUSE(ids.procId))) {
+    mlogf(M_ERROR,M_SHOW,"-#- Fatal error increasing inuse semaphore for %d, reason: %s\n",
+          ids.procId, strerror(errno));
+    _SFCB_ABORT();
+  }
+  if (semReleaseUnDo(sfcbSem, PROV_GUARD(ids.procId))) {
+    mlogf(M_ERROR,M_SHOW,"-#- Fatal error releasing semaphore for %d, reason: %s\n",
+          ids.procId, strerror(errno));
+    _SFCB_ABORT();
+  }
+  return ok;
+}
+
+static int
+getCachedProvRoute(BinRequestContext * ctx, char *key)
+{
+  ProvRoute      *r;
+  unsigned long   i;
+  int             gen;
+
+  _SFCB_ENTER(TRACE_PROVIDERMGR, "getCachedProvRoute");
+
+  gen = semGetValue(sfcbSem, PROV_GEN_ID);
+  if (gen != provRouteGen) {
+    _SFCB_TRACE(1, ("--- Provider generation %d -> %d, dropping routes",
+                    provRouteGen, gen));
+    flushProvRoutes();
+    provRouteGen = gen;
+    _SFCB_RETURN(0);
+  }
+  if (provRouteHt == NULL ||
+      (r = provRouteHt->ft->get(provRouteHt, key)) == NULL)
+    _SFCB_RETURN(0);
+
+  ctx->pAs = malloc(sizeof(ProvAddr) * r->count);
+  for (ctx->pCount = 0; ctx->pCount < r->count; ctx->pCount++) {
+    if (!claimCachedProvider(r->as[ctx->pCount].ids))
+      break;
+    ctx->pAs[ctx->pCount].ids = r->as[ctx->pCount].ids;
+    ctx->pAs[ctx->pCount].socket = -1;
+  }
+
+  if (ctx->pCount < r->count) {
+    /*
+     * provider went away - release what was claimed, ask providerMgr 
+     */
+    _SFCB_TRACE(1, ("--- Cached route %s is stale", key));
+    closeProviderContext(ctx);
+    ctx->pAs = NULL;
+    ctx->pCount = 0;
+    flushProvRoutes();
+    _SFCB_RETURN(0);
+  }
+
+  for (i = 0; i < r->count; i++)
+    ctx->pAs[i].socket = dup(r->as[i].socket);
+  ctx->provA = ctx->pAs[0];
+  ctx->rc = MSG_X_PROVIDER;
+  _SFCB_TRACE(1, ("--- Using cached route %s, %lu provider(s)", key,
+                  r->count));
+  _SFCB_RETURN(1);
+}
+
+static void
+putCachedProvRoute(BinRequestContext * ctx, char *key)
+{
+  ProvRoute      *r;
+  unsigned long   i;
+
+  if (provRouteHt && provRouteHt->ft->size(provRouteHt) >= provRouteMax)
+    flushProvRoutes();
+  if (provRouteHt == NULL)
+    provRouteHt = UtilFactory->newHashTable(61, UtilHashTable_charKey);
+
+  r = malloc(sizeof(*r) + sizeof(ProvAddr) * (ctx->pCount - 1));
+  for (r->count = 0; r->count < ctx->pCount; r->count++) {
+    r->as[r->count].ids = ctx->pAs[r->count].ids;
+    if ((r->as[r->count].socket = dup(ctx->pAs[r->count].socket)) < 0) {
+      releaseProvRoute(r);
+      return;
+    }
+  }
+  provRouteHt->ft->put(provRouteHt, strdup(key), r);
+}
+
 /*
  ctx is passed in to receive response information (provider id, etc)
  ohdr is passed in to build the request to providerMgr proc
@@ -1163,14 +1317,32 @@ getProviderContext(BinRequestContext * ctx)
 {
   unsigned long int l;
   int             rc = 0,
-    i;
+    i,
+    sockOk = 1;
   char           *buf;
   ProvAddr       *as;
   ComSockets      sockets;
   OperationHdr   *ohdr = ctx->oHdr;
+  char           *routeKey = NULL;
 
   _SFCB_ENTER(TRACE_PROVIDERMGR, "getProviderContext");
 
+  if (provRouteMax < 0 &&
+      getControlNum("providerRoutingCacheSize", &provRouteMax))
+    provRouteMax = 0;
+  if (provRouteMax > 0 && !localMode && sfcbSem >= 0 &&
+      ohdr->type <= OPS_InvokeMethod) {
+    char           *cn = ohdr->className.length ?
+        (char *) ohdr->className.data : "";
+    routeKey = malloc(ohdr->nameSpace.length + strlen(cn) + 16);
+    sprintf(routeKey, "%s:%s:%d", (char *) ohdr->nameSpace.data, cn,
+            ohdr->type);
+    if (getCachedProvRoute(ctx, routeKey)) {
+      free(routeKey);
+      _SFCB_RETURN(ctx->rc);
+    }
+  }
+
   l = sizeof(*ohdr) + ohdr->nameSpace.length + ohdr->className.length;
   buf = malloc(l + 8);
 
@@ -1210,6 +1382,8 @@ getProviderContext(BinRequestContext * ctx)
     } else {
       pthread_mutex_unlock(&resultsocketMutex);
     }
+    if (routeKey)
+      free(routeKey);
     _SFCB_RETURN(rc);
 
   }
@@ -1219,6 +1393,8 @@ getProviderContext(BinRequestContext * ctx)
   ctx->rc =
       spRecvCtlResult(&sockets.receive, &ctx->provA.socket,
                       &ctx->provA.ids.ids, &l);
+  if (ctx->rc < 0)
+    sockOk = 0;
   _SFCB_TRACE(1,
               ("--- Provider socket: %d - %lu %d", ctx->provA.socket,
                getInode(ctx->provA.socket), currentProc));
@@ -1239,6 +1415,9 @@ getProviderContext(BinRequestContext * ctx)
                            &l);
       if (rc != MSG_X_PROVIDER) {
         ctx->rc = rc;
+        as[i].socket = -1;
+        if (rc < 0)
+          sockOk = 0;
         _SFCB_TRACE(1,
                     ("--- Provider at index %d not loadable (perhaps out of processes) ",
                      i));
@@ -1256,17 +1435,45 @@ getProviderContext(BinRequestContext * ctx)
   }
 
   if (!localMode) {
-    closeSocket(&sockets, COM_ALL, "getProviderContext");
+    if (sockOk)
+      releaseSocketPair(&sockets, "getProviderContext");
+    else
+      closeSocket(&sockets, COM_ALL, "getProviderContext");
   } else {
     pthread_mutex_unlock(&resultsocketMutex);
   }
+
+  if (routeKey) {
+    if (ctx->rc == MSG_X_PROVIDER)
+      putCachedProvRoute(ctx, routeKey);
+    free(routeKey);
+  }
   _SFCB_RETURN(ctx->rc);
 }
 
-static BinResponseHdr *
-intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
+/*
+ * take an additional inuse hold on the providers of ctx, used by processes
+ * that keep a provider context beyond the request that obtained it
+ */
+void
+holdProviderContext(BinRequestContext * ctx)
 {
-  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "intInvokeProvider");
+  unsigned long   i;
+
+  _SFCB_ENTER(TRACE_PROVIDERMGR, "holdProviderContext");
+  for (i = 0; i < ctx->pCount; i++)
+    setInuseSem(ctx->pAs[i].ids.ids);
+  _SFCB_EXIT();
+}
+
+/*
+ * serialize the request in ctx->bHdr and send it to provider ctx->provA,
+ * passing sockets.send along for the provider to respond on
+ */
+void
+sendProviderRequest(BinRequestContext * ctx, ComSockets sockets)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "sendProviderRequest");
   _SFCB_TRACE(1, ("--- localMode: %d", localMode));
   int             ol,
                   rc;
@@ -1275,20 +1482,6 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
                   i;
   char           *buf;
   BinRequestHdr  *hdr = ctx->bHdr;
-  BinResponseHdr *resp = NULL;
-  int             fromS;
-  void           *heapCtl = markHeap();
-#ifdef SFCB_DEBUG
-  struct rusage   us,
-                  ue;
-  struct timeval  sv,
-                  ev;
-
-  if (*_ptr_sfcb_trace_mask & TRACE_RESPONSETIMING) {
-    gettimeofday(&sv, NULL);
-    getrusage(RUSAGE_SELF, &us);
-  }
-#endif
 
   /* If we can store the provId in the binRequestHdr,
      why don't we do that in the first place? */
@@ -1311,6 +1504,8 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
   }
   if (localMode)
     hdr->options |= BRH_Internal;
+  if (classRelativeResults)
+    hdr->options |= BRH_ClassRelative;
 
   memcpy(buf, hdr, size);
   for (l = size, i = 0; i < hdr->count; i++) {
@@ -1374,10 +1569,96 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
   }
 
   free(buf);
+  _SFCB_EXIT();
+}
+
+/*
+ * a class relative instance whose class changed while it was sent cannot
+ * get its property names back; fail the request instead of returning it
+ * without them, and drop the connection so no more chunks are read
+ */
+static BinResponseHdr *
+checkResponseLayouts(BinResponseHdr * resp, int *ok)
+{
+  static const char msg[] = "Class changed while its instances were sent";
+  BinResponseHdr *err;
+  unsigned long   i;
+
+  if (!classRelativeResults)
+    return resp;
+  for (i = 0; i < resp->count; i++)
+    if (resp->object[i].type == MSG_SEG_INSTANCE &&
+        checkSerializedInstance(resp->object[i].data))
+      break;
+  if (i == resp->count)
+    return resp;
+
+  mlogf(M_ERROR, M_SHOW, "--- %s, request failed\n", msg);
+  err = calloc(1, sizeof(BinResponseHdr) + sizeof(msg));
+  err->rc = CMPI_RC_ERR_FAILED + 1;
+  err->count = 1;
+  err->object[0].type = MSG_SEG_CHARS;
+  err->object[0].length = sizeof(msg);
+  err->object[0].data = strcpy((char *) (err + 1), msg);
+  free(resp);
+  *ok = 0;
+  return err;
+}
+
+/*
+ * receive one chunk of a chunked provider response, the provider waits
+ * for spSendAck() on sockets.receive before it sends the next one if
+ * moreChunks is set
+ */
+BinResponseHdr *
+recvProviderChunk(ComSockets sockets, int *ok)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "recvProviderChunk");
+  unsigned long   size,
+                  i;
+  BinResponseHdr *resp = NULL;
+  int             fromS;
+
+  if (spRecvResult(&sockets.receive, &fromS, (void **) &resp, &size) < 0) {
+    size = 0;                   /* force failure handling */
+    *ok = 0;
+  }
+
+  /*
+   * nothing received -- construct a failure response; the provider may
+   * still answer, so the pair can't be reused
+   */
+  if (resp == NULL || size == 0) {
+    if (resp)
+      free(resp);
+    resp = calloc(sizeof(BinResponseHdr), 1);
+    resp->rc = CMPI_RC_ERR_FAILED + 1;
+    *ok = 0;
+  }
+  for (i = 0; i < resp->count; i++) {
+    resp->object[i].data =
+        (void *) ((long) resp->object[i].data + (char *) resp);
+  }
+  resp = checkResponseLayouts(resp, ok);
+  _SFCB_RETURN(resp);
+}
+
+/*
+ * collect the response to a request sent by sendProviderRequest(),
+ * *ok is cleared if the socket pair must not be reused afterwards
+ */
+static BinResponseHdr *
+recvProviderResponse(BinRequestContext * ctx, ComSockets sockets, int *ok)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "recvProviderResponse");
+  unsigned long   size,
+                  i;
+  BinResponseHdr *resp = NULL;
+  int             fromS;
 
   _SFCB_TRACE(1,
               ("--- Waiting for Provider response - from %d",
-               resultSockets.receive));
+               sockets.receive));
 
   if (ctx->chunkedMode) {
     _SFCB_TRACE(1, ("--- chunked mode"));
@@ -1387,23 +1668,7 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
 
       if (resp)
         free(resp);
-      resp = NULL;
-
-      if (spRecvResult(&sockets.receive, &fromS, (void**) &resp, &size) < 0) {
-        size = 0; /* force failure handling */
-      }
-
-      /*
-       * nothing received -- construct a failure response 
-       */
-      if (resp == NULL || size == 0) {
-        resp = calloc(sizeof(BinResponseHdr), 1);
-        resp->rc = CMPI_RC_ERR_FAILED + 1;
-      }
-      for (i = 0; i < resp->count; i++) {
-        resp->object[i].data =
-            (void *) ((long) resp->object[i].data + (char *) resp);
-      }
+      resp = recvProviderChunk(sockets, ok);
 
       ctx->rCount = 1;
       _SFCB_TRACE(1, ("--- writing chunk"));
@@ -1423,6 +1688,7 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
 
     if (spRecvResult(&sockets.receive, &fromS, (void **) &resp, &size) < 0) {
       size = 0; /* force failure case */
+      *ok = 0;
     }
 
     /*
@@ -1431,6 +1697,7 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
     if (resp == NULL || size == 0) {
       resp = calloc(sizeof(BinResponseHdr), 1);
       resp->rc = CMPI_RC_ERR_FAILED + 1;
+      *ok = 0;
     }
 
     ctx->rCount = ctx->pCount;
@@ -1439,12 +1706,39 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
       resp->object[i].data =
           (void *) ((long) resp->object[i].data + (char *) resp);
     }
+    resp = checkResponseLayouts(resp, ok);
   } else {
     _SFCB_TRACE(1, ("--- waiting for response skipped"));
+    *ok = 0;
     free(resp);
     resp = NULL;
   }
 
+  _SFCB_RETURN(resp);
+}
+
+static BinResponseHdr *
+intInvokeProvider(BinRequestContext * ctx, ComSockets sockets, int *ok)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "intInvokeProvider");
+  BinResponseHdr *resp;
+  void           *heapCtl = markHeap();
+#ifdef SFCB_DEBUG
+  BinRequestHdr  *hdr = ctx->bHdr;
+  struct rusage   us,
+                  ue;
+  struct timeval  sv,
+                  ev;
+
+  if (*_ptr_sfcb_trace_mask & TRACE_RESPONSETIMING) {
+    gettimeofday(&sv, NULL);
+    getrusage(RUSAGE_SELF, &us);
+  }
+#endif
+
+  sendProviderRequest(ctx, sockets);
+  resp = recvProviderResponse(ctx, sockets, ok);
+
   releaseHeap(heapCtl);
 
 #ifdef SFCB_DEBUG
@@ -1475,10 +1769,14 @@ invokeProvider(BinRequestContext * ctx)
   } else
     sockets = getSocketPair("invokeProvider");
 
-  BinResponseHdr *resp = intInvokeProvider(ctx, sockets);
+  int             ok = 1;
+  BinResponseHdr *resp = intInvokeProvider(ctx, sockets, &ok);
 
   if (!localMode) {
-    closeSocket(&sockets, COM_ALL, "invokeProvider");
+    if (ok)
+      releaseSocketPair(&sockets, "invokeProvider");
+    else
+      closeSocket(&sockets, COM_ALL, "invokeProvider");
   } else {
     pthread_mutex_unlock(&resultsocketMutex);
   }
@@ -1486,6 +1784,109 @@ invokeProvider(BinRequestContext * ctx)
   _SFCB_RETURN(resp);
 }
 
+static long     fanOutMax = -1;
+static int      fanOutArrival = 0;
+
+static void
+getFanOutControls()
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR, "getFanOutControls");
+  char           *order;
+
+  if (getControlNum("providerFanOut", &fanOutMax) || fanOutMax < 1)
+    fanOutMax = 1;
+  if (getControlChars("providerFanOutOrder", &order) == 0 &&
+      strcasecmp(order, "arrival") == 0)
+    fanOutArrival = 1;
+  _SFCB_TRACE(1, ("--- providerFanOut: %ld order: %s", fanOutMax,
+                  fanOutArrival ? "arrival" : "provider"));
+  _SFCB_EXIT();
+}
+
+/*
+ * Send the request to up to fanOutMax providers at once, each on its own
+ * socket pair, and collect the responses as they become ready. The total
+ * latency is that of the slowest provider rather than the sum of all of
+ * them. Responses are stored in provider order unless providerFanOutOrder
+ * is "arrival"; *err always refers to the first failing entry of resp.
+ */
+static void
+fanOutProviders(BinRequestContext * binCtx, BinResponseHdr ** resp,
+                int *err, int *count)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "fanOutProviders");
+  unsigned long   next = 0,
+                  done = 0,
+                  slot;
+  int             inFlight = 0,
+                  ok,
+                  j;
+  struct pollfd  *pfd = malloc(sizeof(struct pollfd) * fanOutMax);
+  ComSockets     *sp = malloc(sizeof(ComSockets) * fanOutMax);
+  unsigned long  *pIdx = malloc(sizeof(unsigned long) * fanOutMax);
+  BinResponseHdr *r;
+  void           *heapCtl = markHeap();
+
+  while (done < binCtx->pCount) {
+    while (inFlight < fanOutMax && next < binCtx->pCount) {
+      binCtx->provA = binCtx->pAs[next];
+      _SFCB_TRACE(1, ("--- Sending to provider id: %d (%lu of %lu)",
+                      binCtx->provA.ids.provId, next + 1, binCtx->pCount));
+      sp[inFlight] = getSocketPair("invokeProviders");
+      sendProviderRequest(binCtx, sp[inFlight]);
+      pfd[inFlight].fd = sp[inFlight].receive;
+      pfd[inFlight].events = POLLIN;
+      pfd[inFlight].revents = 0;
+      pIdx[inFlight++] = next++;
+    }
+
+    if (poll(pfd, inFlight, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      mlogf(M_ERROR, M_SHOW, "--- invokeProviders poll failed: %s\n",
+            strerror(errno));
+      /* fall back to blocking receives */
+      for (j = 0; j < inFlight; j++)
+        pfd[j].revents = POLLIN;
+    }
+
+    /* walk downwards so the compaction below only moves examined entries */
+    for (j = inFlight - 1; j >= 0; j--) {
+      if (pfd[j].revents == 0)
+        continue;
+      binCtx->provA = binCtx->pAs[pIdx[j]];
+      ok = 1;
+      r = recvProviderResponse(binCtx, sp[j], &ok);
+      _SFCB_TRACE(1, ("--- back from provider id: %d",
+                      binCtx->provA.ids.provId));
+      if (ok)
+        releaseSocketPair(&sp[j], "invokeProviders");
+      else
+        closeSocket(&sp[j], cAll, "invokeProviders");
+
+      slot = fanOutArrival ? done : pIdx[j];
+      resp[slot] = r;
+      *count += r->count;
+      r->rc--;
+      if (r->rc != 0 && (*err == 0 || slot + 1 < (unsigned long) *err))
+        *err = slot + 1;
+
+      done++;
+      binCtx->pDone++;
+      inFlight--;
+      pfd[j] = pfd[inFlight];
+      sp[j] = sp[inFlight];
+      pIdx[j] = pIdx[inFlight];
+    }
+  }
+
+  releaseHeap(heapCtl);
+  free(pfd);
+  free(sp);
+  free(pIdx);
+  _SFCB_EXIT();
+}
+
 BinResponseHdr **
 invokeProviders(BinRequestContext * binCtx, int *err, int *count)
 {
@@ -1493,18 +1894,35 @@ invokeProviders(BinRequestContext * binCtx, int *err, int *count)
   BinResponseHdr **resp;
   ComSockets      sockets;
   unsigned long   i;
+  int             ok = 1;
 
-  if (localMode) {
-    pthread_mutex_lock(&resultsocketMutex);
-    sockets = resultSockets;
-  } else
-    sockets = getSocketPair("invokeProvider");
+  if (fanOutMax < 0)
+    getFanOutControls();
 
   resp = malloc(sizeof(BinResponseHdr *) * (binCtx->pCount));
   *err = 0;
   *count = 0;
   binCtx->pDone = 1;
 
+  /*
+   * chunked responses are written to the client as they arrive and must
+   * not interleave, and local clients share one result socket pair, so
+   * those keep going through the providers one after the other
+   */
+  if (fanOutMax > 1 && binCtx->pCount > 1 && !localMode &&
+      !binCtx->chunkedMode && (binCtx->noResp & 1) == 0) {
+    _SFCB_TRACE(1, ("--- %d providers, fan-out %ld", binCtx->pCount,
+                    fanOutMax));
+    fanOutProviders(binCtx, resp, err, count);
+    _SFCB_RETURN(resp);
+  }
+
+  if (localMode) {
+    pthread_mutex_lock(&resultsocketMutex);
+    sockets = resultSockets;
+  } else
+    sockets = getSocketPair("invokeProvider");
+
   _SFCB_TRACE(1, ("--- %d providers", binCtx->pCount));
   for (i = 0; i < binCtx->pCount; i++, binCtx->pDone++) {
     binCtx->provA = binCtx->pAs[i];
@@ -1516,8 +1934,14 @@ invokeProviders(BinRequestContext * binCtx, int *err, int *count)
     } else {
       _SFCB_TRACE(1, ("--- Calling provider id: %d", binCtx->provA.ids.provId));
     }
-    resp[i] = intInvokeProvider(binCtx, sockets);
+    resp[i] = intInvokeProvider(binCtx, sockets, &ok);
     _SFCB_TRACE(1, ("--- back from calling provider id: %d", binCtx->provA.ids.provId));
+    if (!ok && !localMode && i + 1 < binCtx->pCount) {
+      /* a late answer must not be taken for the next provider's */
+      closeSocket(&sockets, COM_ALL, "invokeProvider");
+      sockets = getSocketPair("invokeProvider");
+      ok = 1;
+    }
     *count += resp[i]->count;
     resp[i]->rc--;
     if (*err == 0 && resp[i]->rc != 0)
@@ -1525,7 +1949,10 @@ invokeProviders(BinRequestContext * binCtx, int *err, int *count)
   }
 
   if (!localMode) {
-    closeSocket(&sockets, COM_ALL, "invokeProvider");
+    if (ok)
+      releaseSocketPair(&sockets, "invokeProvider");
+    else
+      closeSocket(&sockets, COM_ALL, "invokeProvider");
   } else {
     pthread_mutex_unlock(&resultsocketMutex);
   }
@@ -1743,6 +2170,10 @@ isChild(const char *ns, const char *parent, const char *child)
 
   _SFCB_ENTER(TRACE_PROVIDERMGR, "isChild");
 
+  irc = classTreeIsA(ns, child, parent);
+  if (irc >= 0)
+    _SFCB_RETURN(irc && strcasecmp(child, parent) != 0);
+
   path = TrackedCMPIObjectPath(ns, parent, &rc);
   sreq.principal = setCharsMsgSegment("$$");
   sreq.objectPath = setObjectPathMsgSegment(path);
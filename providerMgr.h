@@ -102,6 +102,8 @@ typedef struct binRequestHdr {
   unsigned short  options;
 #define BRH_NoResp 1
 #define BRH_Internal 2
+#define BRH_ClassRelative 4     /* requestor reads class relative
+                                 * instances */
   void           *provId;
   unsigned int    sessionId;
   unsigned int    flags;
@@ -164,6 +166,9 @@ typedef struct binRequestContext {
 #define XML_asClassName 2
 #define XML_asClass 4
 #define XML_asObjectPath 8
+#define XML_asInstPath 16       /* pull operations: INSTANCEPATH */
+#define XML_asInstWithPath 32   /* pull operations: VALUE.INSTANCEWITHPATH */
+#define XML_asInst 64           /* pull operations: INSTANCE */
 
 typedef struct chunkFunctions {
   void            (*writeChunk) (BinRequestContext *, BinResponseHdr *);
@@ -396,6 +401,10 @@ int             getProviderContext(BinRequestContext * ctx);
 BinResponseHdr **invokeProviders(BinRequestContext * binCtx, int *err,
                                  int *count);
 BinResponseHdr *invokeProvider(BinRequestContext * ctx);
+void            holdProviderContext(BinRequestContext * ctx);
+void            sendProviderRequest(BinRequestContext * ctx,
+                                    ComSockets sockets);
+BinResponseHdr *recvProviderChunk(ComSockets sockets, int *ok);
 void            freeResponseHeaders(BinResponseHdr ** resp,
                                     BinRequestContext * ctx);
 sigset_t mask, old_mask;
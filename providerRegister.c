@@ -37,6 +37,7 @@ extern char    *configfile;
 extern int      setupControl(char *fn);
 extern int      getControlChars(char *id, char **val);
 extern int      getControlBool(char *id, int *val);
+extern void     bumpProvGeneration();
 
 ProviderInfo   *qualiProvInfoPtr = NULL;
 ProviderInfo   *classProvInfoPtr = NULL;
@@ -245,6 +246,7 @@ newProviderRegister()
         info->id = ++id;
         // Set the default provider uid
         info->uid = provuid;
+        info->threads = info->queueDepth = -1;
         if (!provSFCB)
           info->user = provuser ? strdup(provuser) : NULL;
         break;
@@ -287,6 +289,20 @@ newProviderRegister()
               err = 1;
             }
           }
+        } else if (strcmp(rv.id, "threads") == 0 ||
+                   strcmp(rv.id, "queuedepth") == 0) {
+          char           *v = cntlGetVal(&rv),
+                         *e = NULL;
+          long            l = v ? strtol(v, &e, 10) : -1;
+          if (l < 0 || e == v || *e) {
+            mlogf(M_ERROR, M_SHOW,
+                  "--- invalid %s specification: \n\t%d: %s\n", rv.id, n,
+                  stmt);
+            err = 1;
+          } else if (*rv.id == 't')
+            info->threads = l;
+          else
+            info->queueDepth = l;
         } else if (strcmp(rv.id, "type") == 0) {
           char           *t;
           info->type = 0;
@@ -390,6 +406,7 @@ putProvider(ProviderRegister * br, const char *clsName,
             ProviderInfo * info)
 {
   ProviderBase   *bb = (ProviderBase *) br->hdl;
+  bumpProvGeneration();
   return bb->ht->ft->put(bb->ht, clsName, info);
 }
 
@@ -459,6 +476,7 @@ static void
 removeProvider(ProviderRegister * br, const char *clsName)
 {
   ProviderBase   *bb = (ProviderBase *) br->hdl;
+  bumpProvGeneration();
   bb->ht->ft->remove(bb->ht, clsName);
 }
 
@@ -62,6 +62,8 @@ extern          "C" {
     time_t          lastActivity;
     int             startSeq;
     int             indicationEnabled;
+    int             threads,    /* worker pool, -1 if not registered */
+                    queueDepth;
     struct _ProviderInfo *next;
     struct _ProviderInfo *nextInRegister;       /* not actually next in
                                                  * Register,but pointer to 
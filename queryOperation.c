@@ -1100,6 +1100,76 @@ newIsNotNullOperation(QLStatement * qs, QLOperand * lo)
   return op;
 }
 
+static int
+countPredicates(QLOperation * op)
+{
+  if (op->ft == &qlAndOperationFt || op->ft == &qlOrOperationFt)
+    return countPredicates(op->lhon) +
+        (op->rhon ? countPredicates(op->rhon) : 0);
+  if (op->ft == &qlNotOperationFt || op->ft == &qlBinOperationFt)
+    return countPredicates(op->lhon);
+  return 1;
+}
+
+/*
+ * emits op so that it continues with onTrue or onFalse, and returns
+ * its first step; built back to front, so every target exists already 
+ */
+static int
+compileStep(QLProgram * prog, QLOperation * op, int onTrue, int onFalse)
+{
+  int             and;
+
+  if (op->ft == &qlNotOperationFt || op->ft == &qlBinOperationFt)
+    return compileStep(prog, op->lhon, onTrue, onFalse);
+
+  if (op->ft == &qlAndOperationFt || op->ft == &qlOrOperationFt) {
+    /* eliminateNots() turned an inverted AND into an OR and vice versa */
+    and = (op->ft == &qlAndOperationFt) != op->flag.invert;
+    if (op->rhon == NULL) {
+      /* a missing right operand counts as true, like in _andEvaluate() */
+      if (!and)
+        return onTrue;
+      return compileStep(prog, op->lhon, onTrue, onFalse);
+    }
+    if (and)
+      return compileStep(prog, op->lhon,
+                         compileStep(prog, op->rhon, onTrue, onFalse),
+                         onFalse);
+    return compileStep(prog, op->lhon, onTrue,
+                       compileStep(prog, op->rhon, onTrue, onFalse));
+  }
+
+  prog->steps[prog->count].op = op;
+  prog->steps[prog->count].onTrue = onTrue;
+  prog->steps[prog->count].onFalse = onFalse;
+  return prog->count++;
+}
+
+QLProgram      *
+compileQLOperation(QLStatement * qs, QLOperation * op)
+{
+  QLProgram      *prog = qsAllocNew(qs, QLProgram);
+
+  prog->count = 0;
+  prog->steps = qsAlloc(qs, countPredicates(op) * sizeof(QLStep));
+  prog->entry = compileStep(prog, op, QL_PROG_TRUE, QL_PROG_FALSE);
+  return prog;
+}
+
+int
+runQLProgram(QLProgram * prog, QLPropertySource * source)
+{
+  QLStep         *s;
+  int             pc = prog->entry;
+
+  while (pc >= 0) {
+    s = prog->steps + pc;
+    pc = s->op->ft->evaluate(s->op, source) ? s->onTrue : s->onFalse;
+  }
+  return pc == QL_PROG_TRUE;
+}
+
 static int
 _ltEvaluate(QLOperation * op, QLPropertySource * source)
 {
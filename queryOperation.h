@@ -219,6 +219,30 @@ QLOperation    *newBinaryOperation(QLStatement *, QLOperation * lo);
 QLOperation    *newIsNullOperation(QLStatement *, QLOperand * lo);
 QLOperation    *newIsNotNullOperation(QLStatement *, QLOperand * lo);
 
+/*
+ * a where condition flattened into its predicates; each step evaluates
+ * one predicate and continues with the step for its outcome, or ends
+ * with QL_PROG_TRUE or QL_PROG_FALSE. AND, OR and NOT nodes are gone,
+ * and with them the recursion through the operation tree.
+ */
+#define QL_PROG_TRUE  -1
+#define QL_PROG_FALSE -2
+
+typedef struct qlStep {
+  QLOperation    *op;
+  int             onTrue,
+                  onFalse;
+} QLStep;
+
+typedef struct qlProgram {
+  int             entry,
+                  count;
+  QLStep         *steps;
+} QLProgram;
+
+extern QLProgram *compileQLOperation(QLStatement * qs, QLOperation * op);
+extern int      runQLProgram(QLProgram * prog, QLPropertySource * source);
+
 struct qlPropertySource {
   void           *data;
   char           *sns;
@@ -35,6 +35,7 @@ extern MsgSegment setConstClassMsgSegment(CMPIConstClass * cl);
 extern int      sendResponse(int requestor, BinResponseHdr * hdr);
 extern int      spSendAck(int to);
 extern int      spRcvAck(int from);
+extern void     upcallBlocking(int blocking);
 extern int      getConstClassSerializedSize(CMPIConstClass *);
 extern void     getSerializedConstClass(CMPIConstClass * cl, void *area);
 extern int      getControlNum(char *id, long *val);
@@ -71,6 +72,8 @@ struct native_result {
   unsigned long   dNext;        /* the next available pos in *data */
 
   QLStatement    *qs;           /* used for execQuery */
+  int             classRelative;        /* requestor reads class relative
+                                         * instances */
 };
 typedef struct native_result NativeResult;
 
@@ -124,8 +127,12 @@ xferResultBuffer(NativeResult * nr, int to, int more, int rc, unsigned long leng
   nr->resp->count = nr->sNext;
 
   rc = spSendResult2(&to, &dmy, nr->resp, s1, nr->data, nr->dNext);
-  if (more)
+  if (more) {
+    /* the requestor may hold the ack back, e.g. for an open enumeration */
+    upcallBlocking(1);
     spRcvAck(to);
+    upcallBlocking(0);
+  }
 
   _SFCB_RETURN(rc);
 }
@@ -220,7 +227,7 @@ __rft_release(CMPIResult *result)
 
   if (nr->data) { free(nr->data); nr->data = NULL; }
   if (nr->resp) { free(nr->resp); nr->resp = NULL; }
-  if (result)   { free(result); result = NULL; }
+  if (result)   { memFree(result); result = NULL; }
 
   CMReturn(CMPI_RC_OK);
 }
@@ -292,7 +299,8 @@ __rft_returnInstance(const CMPIResult *result,
 {
   unsigned long   size,
                   isInst = isInstance(instance);
-  void           *ptr;
+  void           *ptr,
+                 *layout = NULL;
   NativeResult   *r = (NativeResult *) result;
   int             releaseInstance = 0;
   CMPIStatus      st = { CMPI_RC_OK, NULL };
@@ -340,7 +348,12 @@ __rft_returnInstance(const CMPIResult *result,
     _SFCB_RETURN(rc);
   }
 
-  if (isInst) {
+  if (isInst && r->classRelative) {
+    size = getCompactInstanceSerializedSize(instance, &layout);
+    ptr = nextResultBufferPos(r, MSG_SEG_INSTANCE, size);
+    _SFCB_TRACE(1, ("--- Moving instance %d", size));
+    getCompactSerializedInstance(instance, layout, ptr);
+  } else if (isInst) {
     size = getInstanceSerializedSize(instance);
     ptr = nextResultBufferPos(r, MSG_SEG_INSTANCE, size);
     _SFCB_TRACE(1, ("--- Moving instance %d", size));
@@ -432,6 +445,13 @@ setResultQueryFilter(CMPIResult *result, QLStatement * qs)
   r->qs = qs;
 }
 
+void
+setResultClassRelative(CMPIResult *result, int classRelative)
+{
+  NativeResult   *r = (NativeResult *) result;
+  r->classRelative = classRelative;
+}
+
 CMPIArray      *
 native_result2array(CMPIResult *result)
 {
@@ -48,7 +48,7 @@ __eft_release(CMPISelectCond *cond)
   if (c->mem_state && c->mem_state != MEM_RELEASED) {
     memUnlinkEncObj(c->mem_state);
     c->mem_state = MEM_RELEASED;
-    free(c);
+    memFree(c);
     CMReturn(CMPI_RC_OK);
   }
   CMReturn(CMPI_RC_ERR_FAILED);
@@ -51,7 +51,7 @@ __eft_release(CMPISelectExp *exp)
       free(e->sns);
     memUnlinkEncObj(e->mem_state);
     e->mem_state = MEM_RELEASED;
-    free(e);
+    memFree(e);
     CMReturn(CMPI_RC_OK);
   }
   CMReturn(CMPI_RC_ERR_FAILED);
@@ -82,7 +82,10 @@ __eft_evaluate(const CMPISelectExp *exp,
     return 1;
 
   src.sns = e->qs->sns;
-  irc = e->qs->where->ft->evaluate(e->qs->where, &src);
+  if (e->where)
+    irc = runQLProgram(e->where, &src);
+  else
+    irc = e->qs->where->ft->evaluate(e->qs->where, &src);
   return irc;
 }
 
@@ -169,6 +172,9 @@ __new_exp(int mode, const char *queryString,
     return NULL;
   }
 
+  if (exp.qs->where)
+    exp.where = compileQLOperation(exp.qs, exp.qs->where);
+
   exp.queryString = strdup(queryString);
   exp.language = strdup(language);
   if (sns)
@@ -36,6 +36,7 @@ struct native_selectexp {
   char           *sns;
   void           *filterId;
   QLStatement    *qs;
+  QLProgram      *where;        /* qs->where compiled, or NULL */
 };
 
 #endif
@@ -511,8 +511,7 @@ main(int argc, char *argv[])
         } else {
           return -1;
         }
-        if ((bi->next < bi->dSize)
-            && (inst = ipGetNext(bi, NULL, &kp, &ekl))) {
+        if ((inst = ipGetNext(bi, NULL, &kp, &ekl))) {
           continue;
         }
         break;
@@ -223,6 +223,7 @@ static int check_and_print_sfcbsem(char c, char * s)
       rc = -1;
     } else {
       printf("SFCB Process Semaphore Set\n");
+      printf("Provider generation: %d\n", localsems[PROV_GEN_ID].ls_val);
       printf("Id\tGuard\tInuse\tAlive\n");
       num = (num - PROV_PROC_BASE_ID) / PROV_PROC_NUM_SEMS;
       for (i=0; i<num;i++) {
@@ -0,0 +1,83 @@
+/*
+ * sfcbzip.c
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Compresses a classSchemas file into a block compressed
+ * classSchemas.gz, which the class providers can read without seeking
+ * through the whole gzip stream.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "classSchemaBlock.h"
+
+static void
+usage(const char *pgm)
+{
+  fprintf(stderr, "usage: %s [-b blocksize] classSchemas [output]\n", pgm);
+  fprintf(stderr, "\t-b uncompressed block size in bytes [%d]\n",
+          CL_BLOCK_SIZE);
+  fprintf(stderr, "\toutput defaults to classSchemas.gz\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned long   blockSize = CL_BLOCK_SIZE;
+  char           *out;
+  int             c;
+
+  while ((c = getopt(argc, argv, "hb:")) != -1) {
+    switch (c) {
+    case 'b':
+      blockSize = strtoul(optarg, NULL, 0);
+      if (blockSize == 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return c == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || argc - optind > 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (argc - optind == 2)
+    out = argv[optind + 1];
+  else {
+    out = malloc(strlen(argv[optind]) + 4);
+    strcpy(out, argv[optind]);
+    strcat(out, ".gz");
+  }
+
+  if (writeBlockFile(argv[optind], out, blockSize)) {
+    fprintf(stderr, "%s: unable to compress %s into %s\n", argv[0],
+            argv[optind], out);
+    return 1;
+  }
+  return 0;
+}
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
@@ -45,7 +45,7 @@ __sft_release(CMPIString *string)
       free(s->string.hdl);
     memUnlinkEncObj(s->mem_state);
     s->mem_state = MEM_RELEASED;
-    free(string);
+    memFree(string);
     CMReturn(CMPI_RC_OK);
   }
 
@@ -365,6 +365,93 @@ tool_mm_load_lib(const char *libname)
   return dlopen(filename, RTLD_LAZY);
 }
 
+/**
+ * Heap arenas.
+ *
+ * Blocks start at ARENA_BLOCK_MIN bytes and double up to ARENA_BLOCK_MAX;
+ * anything larger than ARENA_BLOCK_MIN gets a block of its own behind
+ * the current one, so it does not waste what is left there.
+ */
+
+#define ARENA_ALIGN 16
+#define ARENA_HDR ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_BLOCK_MIN (16 * 1024)
+#define ARENA_BLOCK_MAX (1024 * 1024)
+
+struct arenaBlock {
+  struct arenaBlock *next;
+  char           *free,
+                 *end;
+};
+
+static int      useHeapArena = -1;
+
+static void    *
+arenaAlloc(HeapControl * hc, size_t size)
+{
+  ArenaBlock     *b = hc->arena;
+  size_t          bs;
+  char           *p;
+
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (b == NULL || (size_t) (b->end - b->free) < size) {
+    if (size > ARENA_BLOCK_MIN)
+      bs = ARENA_HDR + size;
+    else if (b == NULL)
+      bs = ARENA_BLOCK_MIN;
+    else if ((bs = (b->end - (char *) b) * 2) > ARENA_BLOCK_MAX)
+      bs = ARENA_BLOCK_MAX;
+    b = malloc(bs);
+    __ALLOC_ERROR(!b);
+    b->free = (char *) b + ARENA_HDR;
+    b->end = (char *) b + bs;
+    if (size > ARENA_BLOCK_MIN && hc->arena) {
+      b->next = hc->arena->next;
+      hc->arena->next = b;
+    } else {
+      b->next = hc->arena;
+      hc->arena = b;
+    }
+    hc->arenaBlocks++;
+  }
+  p = b->free;
+  b->free += size;
+  hc->arenaBytes += size;
+  return p;
+}
+
+static void
+arenaRelease(HeapControl * hc)
+{
+  ArenaBlock     *b;
+
+  while ((b = hc->arena)) {
+    hc->arena = b->next;
+    free(b);
+  }
+  hc->arenaBlocks = 0;
+  hc->arenaBytes = 0;
+}
+
+/*
+ * returns 1 if ptr lies within the arena of the current heap or of one
+ * of the heaps it was marked within
+ */
+static int
+inArena(managed_thread * mt, void *ptr)
+{
+  HeapControl    *hc;
+  ArenaBlock     *b;
+
+  for (hc = &mt->hc; hc; hc = hc->outer) {
+    for (b = hc->arena; b; b = b->next) {
+      if ((char *) ptr >= (char *) b && (char *) ptr < b->end)
+        return 1;
+    }
+  }
+  return 0;
+}
+
 static void
 __flush_mt(managed_thread * mt)
 {
@@ -411,6 +498,7 @@ __cleanup_mt(void *ptr)
   if (mt && mt->cleanupDone == 0) {
     mt->cleanupDone = 1;
     __flush_mt(mt);
+    arenaRelease(&mt->hc);
 
     if (mt->hc.memObjs)
       { free(mt->hc.memObjs); mt->hc.memObjs = NULL; }
@@ -497,6 +585,27 @@ __memInit(int dontforce)
   return mt;
 }
 
+/**
+ * Frees an encapsulated object in its release function.
+ *
+ * Description:
+ *
+ *   Objects taken from a heap arena are left alone; their memory goes
+ *   away with the arena at releaseHeap().
+ */
+
+void
+memFree(void *ptr)
+{
+  managed_thread *mt;
+
+  if (ptr == NULL)
+    return;
+  if (!localClientMode && (mt = __memInit(1)) && inArena(mt, ptr))
+    return;
+  free(ptr);
+}
+
 /**
  * Allocates zeroed memory and eventually puts it under memory mangement.
  *
@@ -511,7 +620,18 @@ void           *
 memAlloc(int add, size_t size, int *memId)
 {
   _SFCB_ENTER(TRACE_MEMORYMGR, "mem_alloc");
-  void           *result = calloc(1, size);
+  void           *result;
+  managed_thread *mt;
+
+  if (add != MEM_TRACKED && !localClientMode &&
+      (mt = __memInit(0))->hc.useArena) {
+    result = arenaAlloc(&mt->hc, size);
+    memset(result, 0, size);
+    *memId = MEM_TRACKED;
+    _SFCB_RETURN(result);
+  }
+
+  result = calloc(1, size);
   if (!result) {
     __ALLOC_ERROR(!result);
     abort();
@@ -561,15 +681,19 @@ memAddEncObj(int mode, void *ptr, size_t size, int *memId)
 {
   _SFCB_ENTER(TRACE_MEMORYMGR, "memAddEncObj");
 
-  void           *object = malloc(size);
-  memcpy(object, ptr, size);
+  void           *object;
+  managed_thread *mt;
 
   if (localClientMode || mode != MEM_TRACKED) {
+    object = malloc(size);
+    memcpy(object, ptr, size);
     *memId = MEM_NOT_TRACKED;
     _SFCB_RETURN(object);
   }
 
-  managed_thread *mt = __memInit(0);
+  mt = __memInit(0);
+  object = mt->hc.useArena ? arenaAlloc(&mt->hc, size) : malloc(size);
+  memcpy(object, ptr, size);
 
   mt->hc.memEncObjs[mt->hc.memEncUsed++] = (Object *) object;
   *memId = mt->hc.memEncUsed;
@@ -694,6 +818,14 @@ markHeap()
   mt->hc.memObjs = malloc(MT_SIZE_STEP * sizeof(void *));
   mt->hc.memEncObjs = malloc(MT_SIZE_STEP * sizeof(void *));
 
+  if (useHeapArena < 0 && getControlBool("useHeapArena", &useHeapArena))
+    useHeapArena = 1;
+  mt->hc.useArena = useHeapArena;
+  mt->hc.arena = NULL;
+  mt->hc.arenaBlocks = 0;
+  mt->hc.arenaBytes = 0;
+  mt->hc.outer = hc;
+
   _SFCB_RETURN(hc);
 }
 
@@ -716,6 +848,13 @@ releaseHeap(void *hc)
   if (mt->hc.memEncObjs)
     { free(mt->hc.memEncObjs); mt->hc.memEncObjs = NULL; }
 
+  /* only now, the objects released above still had to be written to */
+  if (mt->hc.arena) {
+    _SFCB_TRACE(1, ("--- arena %lu bytes in %u blocks", mt->hc.arenaBytes,
+                    mt->hc.arenaBlocks));
+    arenaRelease(&mt->hc);
+  }
+
   if (hc) {
   memcpy(&mt->hc, hc, sizeof(HeapControl));
 
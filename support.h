@@ -141,6 +141,12 @@ CMPIQualifierDeclMI *loadQualifierDeclMI(const char *provider,
  *
  *  This struct is returned using a global pthread_key_t and stores all allocated
  *  objects that are going to be freed, once the thread is flushed or dies.
+ *
+ *  A heap opened by markHeap() with useHeapArena set hands out tracked
+ *  objects from a list of bump allocated blocks instead of calloc/malloc.
+ *  The objects are still released one by one, but their memory goes
+ *  away with the blocks at releaseHeap(). Untracked objects, and so any
+ *  clone, always come from malloc.
  */
 
 #define MEM_NOT_TRACKED -2
@@ -163,6 +169,8 @@ typedef struct {
 
 typedef struct _managed_thread managed_thread;
 
+typedef struct arenaBlock ArenaBlock;
+
 typedef struct heapControl {
   unsigned        memSize;           /**< current maximum number of tracked object pointers */
   unsigned        memUsed;           /**< number of currently tracked object pointers */
@@ -170,6 +178,11 @@ typedef struct heapControl {
   unsigned        memEncUsed;        /**< current maximum number of tracked encapsulated object pointers */
   unsigned        memEncSize;        /**< number of currently tracked encapsulated object pointers */
   Object        **memEncObjs;        /**< pointers to encapsulated object allocations */
+  int             useArena;          /**< tracked objects come from arena */
+  unsigned        arenaBlocks;       /**< number of blocks in arena */
+  unsigned long   arenaBytes;        /**< bytes handed out from arena */
+  ArenaBlock     *arena;             /**< bump allocation blocks, newest first */
+  struct heapControl *outer;         /**< heap that was current when this one was marked */
 } HeapControl;
 
 struct _managed_thread {
@@ -194,6 +207,7 @@ int             memAdd(void *ptr, int *memId);
 void           *memAlloc(int add, size_t size, int *memId);
 void           *memAddEncObj(int mode, void *ptr, size_t size, int *memId);
 void            memUnlinkEncObj(int memId);
+void            memFree(void *ptr);
 void            memLinkEncObj(void *ptr, int *memId);
 void            memLinkInstance(CMPIInstance *ci);
 void            memUnlinkInstance(CMPIInstance *ci);
@@ -0,0 +1,193 @@
+#!/bin/sh
+# ============================================================================
+# pullTest
+#
+# (C) Copyright IBM Corp. 2013
+#
+# THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+# ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+# CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+#
+# You can obtain a current copy of the Eclipse Public License from
+# http://www.opensource.org/licenses/eclipse-1.0.php
+#
+# Description:
+#    Enumerate TEST_PulledInstance with OpenEnumerateInstances,
+#    PullInstancesWithPath and CloseEnumeration, passing the enumeration
+#    context from one request to the next, and verify the instances
+#    returned and EndOfSequence.
+# ============================================================================
+
+
+sendxml () {
+      # Sends the xml file given as argument 1 to wbemcat with appropriate
+      # credentials and protocol. The output of wbemcat will be directed to
+      # argument 2
+      if [ -z $SFCB_TEST_PORT ]
+      then
+            SFCB_TEST_PORT=5988
+      fi
+      if [ -z $SFCB_TEST_PROTOCOL ]
+      then
+          SFCB_TEST_PROTOCOL="http"
+      fi
+      if [ "$SFCB_TEST_USER" != "" ] && [ "$SFCB_TEST_PASSWORD" != "" ]; then
+           wbemcat -u $SFCB_TEST_USER -pwd $SFCB_TEST_PASSWORD -p $SFCB_TEST_PORT -t $SFCB_TEST_PROTOCOL $1 2>&1 > $2
+       else
+           wbemcat -p $SFCB_TEST_PORT -t $SFCB_TEST_PROTOCOL $1 2>&1 > $2
+       fi
+       if [ $? -ne 0 ]; then
+          echo "FAILED to send CIM-XML request $1"
+          return 1
+       fi
+}
+
+request () {
+    # Sends the CIM-XML given as argument 1 to pullTest.result
+    echo "$1" > ./pullTest.xml
+    sendxml ./pullTest.xml ./pullTest.result
+}
+
+setcount () {
+    # Sets the number of instances TEST_PulledInstance returns
+    request '<?xml version="1.0" encoding="utf-8" ?>
+<CIM CIMVERSION="2.0" DTDVERSION="2.0">
+<MESSAGE ID="4711" PROTOCOLVERSION="1.0"><SIMPLEREQ><METHODCALL NAME="setCount"><LOCALCLASSPATH><LOCALNAMESPACEPATH><NAMESPACE NAME="root"/><NAMESPACE NAME="cimv2"/></LOCALNAMESPACEPATH><CLASSNAME NAME="TEST_PulledInstance"/></LOCALCLASSPATH><PARAMVALUE NAME="InstanceCount"><VALUE>'$1'</VALUE></PARAMVALUE></METHODCALL></SIMPLEREQ>
+</MESSAGE></CIM>'
+}
+
+open () {
+    # Opens an enumeration returning up to argument 1 instances
+    request "$PRE"'<IMETHODCALL NAME="OpenEnumerateInstances">'"$NS"'
+<IPARAMVALUE NAME="ClassName">
+  <CLASSNAME NAME="TEST_PulledInstance"/>
+</IPARAMVALUE>
+<IPARAMVALUE NAME="MaxObjectCount">
+  <VALUE>'$1'</VALUE>
+</IPARAMVALUE>
+</IMETHODCALL>'"$POST"
+    ctx=`sed -n '/NAME="EnumerationContext"/{n;s/.*<VALUE>\([0-9]*\)<\/VALUE>.*/\1/p;}' ./pullTest.result`
+}
+
+pull () {
+    # Pulls up to argument 1 instances from the context opened last
+    request "$PRE"'<IMETHODCALL NAME="PullInstancesWithPath">'"$NS"'
+<IPARAMVALUE NAME="MaxObjectCount">
+  <VALUE>'$1'</VALUE>
+</IPARAMVALUE>
+<IPARAMVALUE NAME="EnumerationContext">
+  <VALUE>'$ctx'</VALUE>
+</IPARAMVALUE>
+</IMETHODCALL>'"$POST"
+}
+
+close () {
+    request "$PRE"'<IMETHODCALL NAME="CloseEnumeration">'"$NS"'
+<IPARAMVALUE NAME="EnumerationContext">
+  <VALUE>'$ctx'</VALUE>
+</IPARAMVALUE>
+</IMETHODCALL>'"$POST"
+}
+
+check () {
+    # Checks the last response for the Identifier keys given as argument 2,
+    # and EndOfSequence given as argument 3; argument 1 names the step
+    n=`grep -c '<INSTANCE CLASSNAME="TEST_PulledInstance">' ./pullTest.result`
+    if [ $n -ne `echo $2 | wc -w` ]
+    then
+        echo " $1 returned $n instances. FAILED"
+        return 1
+    fi
+    for id in $2
+    do
+        if ! grep -F '<KEYVALUE VALUETYPE="numeric">'$id'</KEYVALUE>' ./pullTest.result >/dev/null 2>&1
+        then
+            echo " $1 did not return instance $id. FAILED"
+            return 1
+        fi
+    done
+    if ! sed -n '/NAME="EndOfSequence"/{n;p;}' ./pullTest.result | grep -F "<VALUE>$3</VALUE>" >/dev/null 2>&1
+    then
+        echo " $1 EndOfSequence not $3. FAILED"
+        return 1
+    fi
+    if [ $3 = "FALSE" ] && [ -z "$ctx" ]
+    then
+        echo " $1 returned no enumeration context. FAILED"
+        return 1
+    fi
+    echo -n "."
+}
+
+cleanup () {
+    setcount 16
+    rm -f ./pullTest.xml ./pullTest.result
+}
+
+# Start of main
+PRE='<?xml version="1.0" encoding="utf-8" ?>
+<CIM CIMVERSION="2.0" DTDVERSION="2.0">
+<MESSAGE ID="4711" PROTOCOLVERSION="1.0">
+<SIMPLEREQ>
+'
+NS='
+<LOCALNAMESPACEPATH>
+  <NAMESPACE NAME="root"></NAMESPACE>
+  <NAMESPACE NAME="cimv2"></NAMESPACE>
+</LOCALNAMESPACEPATH>'
+POST='
+</SIMPLEREQ>
+</MESSAGE>
+</CIM>'
+
+# Check for wbemcat utility
+if ! which wbemcat > /dev/null; then
+   echo "  Cannot find wbemcat. Please check your PATH"
+   exit 1
+fi
+if ! touch ./pullTest.xml > /dev/null; then
+   echo "  Cannot create files, check permissions"
+   exit 1
+fi
+
+echo -n "  Testing Open, Pull and Close "
+if ! setcount 3
+then
+    cleanup
+    exit 1
+fi
+
+# one at a time, then close before the end
+open 1
+check "Open" "1" "FALSE" || { cleanup; exit 1; }
+pull 1
+check "Pull" "2" "FALSE" || { cleanup; exit 1; }
+close
+if grep -F "<ERROR" ./pullTest.result >/dev/null 2>&1 ||
+   ! grep -F '<IMETHODRESPONSE NAME="CloseEnumeration">' ./pullTest.result >/dev/null 2>&1
+then
+    echo " Close FAILED"
+    cleanup
+    exit 1
+fi
+echo -n "."
+
+# the context is gone once closed
+pull 1
+if ! grep -F '<ERROR CODE="19"' ./pullTest.result >/dev/null 2>&1
+then
+    echo " Pull from a closed context did not fail. FAILED"
+    cleanup
+    exit 1
+fi
+echo -n "."
+
+# the rest in one pull ends the sequence
+open 1
+check "Open" "1" "FALSE" || { cleanup; exit 1; }
+pull 10
+check "Pull" "2 3" "TRUE" || { cleanup; exit 1; }
+echo " PASSED"
+
+cleanup
+exit 0
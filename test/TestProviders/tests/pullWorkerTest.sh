@@ -0,0 +1,162 @@
+#!/bin/sh
+# ============================================================================
+# pullWorkerTest
+#
+# (C) Copyright IBM Corp. 2013
+#
+# THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+# ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+# CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+#
+# You can obtain a current copy of the Eclipse Public License from
+# http://www.opensource.org/licenses/eclipse-1.0.php
+#
+# Description:
+#    Open more enumeration contexts on TEST_PulledInstance than a provider
+#    has worker threads (providerThreads), each of them leaving the
+#    provider waiting for the ack of a result chunk, and verify that the
+#    provider still serves another request.
+# ============================================================================
+
+
+sendxml () {
+      # Sends the xml file given as argument 1 to wbemcat with appropriate
+      # credentials and protocol. The output of wbemcat will be directed to
+      # argument 2
+      if [ -z $SFCB_TEST_PORT ]
+      then
+            SFCB_TEST_PORT=5988
+      fi
+      if [ -z $SFCB_TEST_PROTOCOL ]
+      then
+          SFCB_TEST_PROTOCOL="http"
+      fi
+      if [ "$SFCB_TEST_USER" != "" ] && [ "$SFCB_TEST_PASSWORD" != "" ]; then
+           wbemcat -u $SFCB_TEST_USER -pwd $SFCB_TEST_PASSWORD -p $SFCB_TEST_PORT -t $SFCB_TEST_PROTOCOL $1 2>&1 > $2
+       else
+           wbemcat -p $SFCB_TEST_PORT -t $SFCB_TEST_PROTOCOL $1 2>&1 > $2
+       fi
+       if [ $? -ne 0 ]; then
+          echo "FAILED to send CIM-XML request $1"
+          return 1
+       fi
+}
+
+setcount () {
+    # Sets the number of instances TEST_PulledInstance returns
+    XML='<?xml version="1.0" encoding="utf-8" ?>
+<CIM CIMVERSION="2.0" DTDVERSION="2.0">
+<MESSAGE ID="4711" PROTOCOLVERSION="1.0"><SIMPLEREQ><METHODCALL NAME="setCount"><LOCALCLASSPATH><LOCALNAMESPACEPATH><NAMESPACE NAME="root"/><NAMESPACE NAME="cimv2"/></LOCALNAMESPACEPATH><CLASSNAME NAME="TEST_PulledInstance"/></LOCALCLASSPATH><PARAMVALUE NAME="InstanceCount"><VALUE>'$1'</VALUE></PARAMVALUE></METHODCALL></SIMPLEREQ>
+</MESSAGE></CIM>'
+    echo "$XML" > ./pullWorkerTest.xml
+    sendxml ./pullWorkerTest.xml $2
+}
+
+cleanup () {
+    # Closes all contexts opened and restores the instance count
+    for ctx in $contexts
+    do
+        XML=$CLOSEPRE$ctx$CLOSEPOST
+        echo "$XML" > ./pullWorkerTest.xml
+        sendxml ./pullWorkerTest.xml /dev/null
+    done
+    setcount 16 /dev/null
+    rm -f ./pullWorkerTest.xml ./pullWorkerTest.result
+}
+
+# Start of main
+# more contexts than the default providerThreads of 16
+lim=20
+contexts=""
+
+# Check for wbemcat utility
+if ! which wbemcat > /dev/null; then
+   echo "  Cannot find wbemcat. Please check your PATH"
+   exit 1
+fi
+if ! touch ./pullWorkerTest.xml > /dev/null; then
+   echo "  Cannot create files, check permissions"
+   exit 1
+fi
+
+OPEN='<?xml version="1.0" encoding="utf-8" ?>
+<CIM CIMVERSION="2.0" DTDVERSION="2.0">
+<MESSAGE ID="4711" PROTOCOLVERSION="1.0">
+<SIMPLEREQ>
+<IMETHODCALL NAME="OpenEnumerateInstances">
+<LOCALNAMESPACEPATH>
+  <NAMESPACE NAME="root"></NAMESPACE>
+  <NAMESPACE NAME="cimv2"></NAMESPACE>
+</LOCALNAMESPACEPATH>
+<IPARAMVALUE NAME="ClassName">
+  <CLASSNAME NAME="TEST_PulledInstance"/>
+</IPARAMVALUE>
+<IPARAMVALUE NAME="MaxObjectCount">
+  <VALUE>1</VALUE>
+</IPARAMVALUE>
+</IMETHODCALL>
+</SIMPLEREQ>
+</MESSAGE>
+</CIM>'
+
+CLOSEPRE='<?xml version="1.0" encoding="utf-8" ?>
+<CIM CIMVERSION="2.0" DTDVERSION="2.0">
+<MESSAGE ID="4711" PROTOCOLVERSION="1.0">
+<SIMPLEREQ>
+<IMETHODCALL NAME="CloseEnumeration">
+<LOCALNAMESPACEPATH>
+  <NAMESPACE NAME="root"></NAMESPACE>
+  <NAMESPACE NAME="cimv2"></NAMESPACE>
+</LOCALNAMESPACEPATH>
+<IPARAMVALUE NAME="EnumerationContext">
+  <VALUE>'
+CLOSEPOST='</VALUE>
+</IPARAMVALUE>
+</IMETHODCALL>
+</SIMPLEREQ>
+</MESSAGE>
+</CIM>'
+
+# enough instances for many more chunks than a context reads ahead
+if ! setcount 50000 ./pullWorkerTest.result
+then
+    cleanup
+    exit 1
+fi
+
+j=1
+echo -n "  Testing provider workers with $lim open enumerations "
+while [ $j -le $lim ]
+do
+    echo "$OPEN" > ./pullWorkerTest.xml
+    sendxml ./pullWorkerTest.xml ./pullWorkerTest.result
+    if [ $? -ne 0 ]
+    then
+        echo " Open $j FAILED"
+        cleanup
+        exit 1;
+    fi
+    ctx=`sed -n '/NAME="EnumerationContext"/{n;s/.*<VALUE>\([0-9]*\)<\/VALUE>.*/\1/p;}' ./pullWorkerTest.result`
+    if [ -z "$ctx" ]
+    then
+        echo " Open $j returned no enumeration context. FAILED"
+        cleanup
+        exit 1;
+    fi
+    contexts="$contexts $ctx"
+    echo -n "."
+    j=$((j+1))
+done
+
+# all the contexts are still open, the provider must answer anyway
+setcount 16 ./pullWorkerTest.result
+if ! grep -F '<METHODRESPONSE NAME="setCount">' ./pullWorkerTest.result >/dev/null 2>&1
+then
+    echo " provider did not answer. FAILED"
+    cleanup
+    exit 1;
+fi
+echo " PASSED"
+
+cleanup
+exit 0
@@ -0,0 +1,246 @@
+/*
+ * findTagBench.c
+ *
+ * (C) Copyright IBM Corp. 2013
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Times the CIM-XML tag lookup of cimXmlParser.c, the linear scan of
+ * tags[] it used to do against the first character chains of findTag(),
+ * over every tag of the given files, and checks that both return the
+ * same entry. tags[], findTag() and buildTagIndex() are copies of the
+ * ones in cimXmlParser.c, where they are static; keep them in step.
+ *
+ * Not run by "make check"; build and run it with
+ *
+ *   make -C test/unittest findTagBench
+ *   find test/xmltest -name '*.xml' | xargs test/unittest/findTagBench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct tags {
+  const char     *tag;
+} Tags;
+
+static Tags     tags[] = {
+  {"CIM"},
+  {"MESSAGE"},
+  {"SIMPLEREQ"},
+  {"IMETHODCALL"},
+  {"METHODCALL"},
+  {"LOCALNAMESPACEPATH"},
+  {"LOCALINSTANCEPATH"},
+  {"LOCALCLASSPATH"},
+  {"NAMESPACEPATH"},
+  {"NAMESPACE"},
+  {"IPARAMVALUE"},
+  {"PARAMVALUE"},
+  {"CLASSNAME"},
+  {"VALUE.ARRAY"},
+  {"VALUE.NAMEDINSTANCE"},
+  {"VALUE.REFERENCE"},
+  {"VALUE.REFARRAY"},
+  {"VALUE"},
+  {"HOST"},
+  {"KEYVALUE"},
+  {"KEYBINDING"},
+  {"INSTANCEPATH"},
+  {"INSTANCENAME"},
+  {"INSTANCE"},
+  {"PROPERTY.REFERENCE"},
+  {"PROPERTY.ARRAY"},
+  {"PROPERTY"},
+  {"QUALIFIER.DECLARATION"},
+  {"QUALIFIER"},
+  {"SCOPE"},
+  {"PARAMETER.ARRAY"},
+  {"PARAMETER.REFERENCE"},
+  {"PARAMETER.REFARRAY"},
+  {"PARAMETER"},
+  {"METHOD"},
+  {"CLASS"},
+  {"?xml"},
+  {"![CDATA["},
+  {""},
+};
+
+/*
+ * the lookup as it was: the first tags[] entry next equals
+ */
+static int
+nextEquals(const char *n, const char *t)
+{
+  int             l = strlen(t);
+  if (strncmp(n, t, l) == 0) {
+    if (!isalnum(*(n + l))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static Tags    *
+linearTag(const char *next)
+{
+  int             i,
+                  m = sizeof(tags) / sizeof(Tags);
+
+  for (i = 0; i < m; i++)
+    if (nextEquals(next, tags[i].tag))
+      return tags + i;
+  return NULL;
+}
+
+/*
+ * the lookup as it is in cimXmlParser.c
+ */
+static signed char tagFirst[256];
+static signed char tagChain[sizeof(tags) / sizeof(Tags)];
+static unsigned char tagLen[sizeof(tags) / sizeof(Tags)];
+static Tags    *cdataTag;
+static pthread_once_t tagIndexOnce = PTHREAD_ONCE_INIT;
+
+static void
+buildTagIndex(void)
+{
+  int             i,
+                  m = sizeof(tags) / sizeof(Tags);
+  signed char    *last[256];
+
+  for (i = 0; i < 256; i++) {
+    tagFirst[i] = -1;
+    last[i] = tagFirst + i;
+  }
+  for (i = 0; i < m; i++) {
+    unsigned char   c = *tags[i].tag;
+    if (c == 0) {
+      cdataTag = tags + i;
+      continue;
+    }
+    tagLen[i] = strlen(tags[i].tag);
+    tagChain[i] = -1;
+    *last[c] = i;
+    last[c] = tagChain + i;
+  }
+}
+
+static Tags    *
+findTag(const char *next)
+{
+  int             i;
+
+  pthread_once(&tagIndexOnce, buildTagIndex);
+  for (i = tagFirst[(unsigned char) *next]; i >= 0; i = tagChain[i])
+    if (strncmp(next, tags[i].tag, tagLen[i]) == 0 &&
+        !isalnum(next[tagLen[i]]))
+      return tags + i;
+  return isalnum(*next) ? NULL : cdataTag;
+}
+
+static char    *
+readFile(const char *fn)
+{
+  FILE           *f = fopen(fn, "r");
+  char           *buf;
+  long            l;
+
+  if (f == NULL)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  l = ftell(f);
+  rewind(f);
+  buf = malloc(l + 1);
+  l = fread(buf, 1, l, f);
+  buf[l] = 0;
+  fclose(f);
+  return buf;
+}
+
+/*
+ * the name following each '<', or '</', of buf
+ */
+static const char *
+tagName(const char *p)
+{
+  return p[1] == '/' ? p + 2 : p + 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int             f,
+                  r,
+                  rounds = 5000,
+                  bad = 0;
+  long            n = 0,
+                  found = 0;
+  double          linear = 0,
+                  chained = 0;
+  clock_t         t0,
+                  t1,
+                  t2;
+  char           *buf,
+                 *p;
+
+  if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+    rounds = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc < 2) {
+    fprintf(stderr, "usage: findTagBench [-r rounds] file.xml ...\n");
+    return 1;
+  }
+
+  for (f = 1; f < argc; f++) {
+    if ((buf = readFile(argv[f])) == NULL) {
+      fprintf(stderr, "cannot read %s\n", argv[f]);
+      return 1;
+    }
+    for (p = buf; (p = strchr(p, '<')); p++) {
+      if (findTag(tagName(p)) != linearTag(tagName(p))) {
+        printf("%s: lookups differ at <%.20s\n", argv[f], tagName(p));
+        bad++;
+      }
+      n++;
+    }
+
+    t0 = clock();
+    for (r = 0; r < rounds; r++)
+      for (p = buf; (p = strchr(p, '<')); p++)
+        found += linearTag(tagName(p)) != NULL;
+    t1 = clock();
+    for (r = 0; r < rounds; r++)
+      for (p = buf; (p = strchr(p, '<')); p++)
+        found += findTag(tagName(p)) != NULL;
+    t2 = clock();
+
+    linear += t1 - t0;
+    chained += t2 - t1;
+    free(buf);
+  }
+
+  printf("%ld tags, %d rounds, %ld found: linear %.0f ms, chained %.0f ms\n",
+         n, rounds, found, linear * 1000 / CLOCKS_PER_SEC,
+         chained * 1000 / CLOCKS_PER_SEC);
+  printf("%d lookups differ\n", bad);
+  return bad != 0;
+}
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */